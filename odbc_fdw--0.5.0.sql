@@ -0,0 +1,141 @@
+/*-------------------------------------------------------------------------
+ *
+ *                foreign-data wrapper for ODBC
+ *
+ * Copyright (c) 2011, PostgreSQL Global Development Group
+ * Copyright (c) 2016, 2017, 2018, 2019 CARTO
+ *
+ * This software is released under the PostgreSQL Licence
+ *
+ * Original author: Zheng Yang <zhengyang4k@gmail.com>
+ *
+ * IDENTIFICATION
+ *                odbc_fdw/odbc_fdw--0.5.0.sql
+ *
+ *-------------------------------------------------------------------------
+ */
+
+CREATE FUNCTION odbc_fdw_handler()
+RETURNS fdw_handler
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT;
+
+CREATE FUNCTION odbc_fdw_validator(text[], oid)
+RETURNS void
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT;
+
+CREATE FOREIGN DATA WRAPPER odbc_fdw
+  HANDLER odbc_fdw_handler
+  VALIDATOR odbc_fdw_validator;
+
+CREATE TYPE __tabledata AS (schema text, name text);
+
+CREATE FUNCTION ODBCTablesList(text, integer DEFAULT 0) RETURNS SETOF __tabledata
+AS 'MODULE_PATHNAME', 'odbc_tables_list'
+LANGUAGE C STRICT;
+
+CREATE FUNCTION ODBCTableSize(text, text) RETURNS INTEGER
+AS 'MODULE_PATHNAME', 'odbc_table_size'
+LANGUAGE C STRICT;
+
+CREATE FUNCTION ODBCQuerySize(text, text) RETURNS INTEGER
+AS 'MODULE_PATHNAME', 'odbc_query_size'
+LANGUAGE C STRICT;
+
+CREATE FUNCTION odbc_fdw_export(server text, sql text, path text, format text DEFAULT 'csv',
+                                OUT rows bigint, OUT bytes bigint, OUT elapsed_ms double precision)
+RETURNS record
+AS 'MODULE_PATHNAME', 'odbc_fdw_export'
+LANGUAGE C STRICT;
+
+CREATE FUNCTION odbc_fdw_load(target regclass, server text, sql text, freeze boolean DEFAULT false)
+RETURNS bigint
+AS 'MODULE_PATHNAME', 'odbc_fdw_load'
+LANGUAGE C STRICT;
+
+CREATE FUNCTION ODBCTablesList(server text, row_limit integer, schema_pattern text,
+                               name_pattern text DEFAULT NULL, table_types text DEFAULT 'TABLE',
+                               with_estimates boolean DEFAULT false)
+RETURNS TABLE (catalog text, schema text, name text, type text, estimated_rows bigint)
+AS 'MODULE_PATHNAME', 'odbc_tables_list'
+LANGUAGE C;
+
+CREATE FUNCTION ODBCTableSize(server text, table_name text, mode text) RETURNS bigint
+AS 'MODULE_PATHNAME', 'odbc_table_size_estimate'
+LANGUAGE C STRICT;
+
+CREATE FUNCTION odbc_fdw_import_stats(foreign_table regclass) RETURNS integer
+AS 'MODULE_PATHNAME', 'odbc_fdw_import_stats'
+LANGUAGE C STRICT;
+
+CREATE FUNCTION odbc_query(server text, sql text) RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'odbc_query'
+LANGUAGE C STRICT;
+
+CREATE FUNCTION odbc_execute(server text, sql text[], transactional boolean DEFAULT true) RETURNS bigint[]
+AS 'MODULE_PATHNAME', 'odbc_execute'
+LANGUAGE C STRICT;
+
+CREATE FUNCTION odbc_fdw_handle_counts(OUT handle_type text, OUT live bigint,
+                                       OUT allocated bigint, OUT released bigint)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'odbc_fdw_handle_counts'
+LANGUAGE C STRICT;
+
+CREATE VIEW odbc_fdw_handles AS SELECT * FROM odbc_fdw_handle_counts();
+
+CREATE FUNCTION odbc_fdw_stats(OUT kind text, OUT dbid oid, OUT serverid oid, OUT relid oid,
+                               OUT queryid bigint, OUT query text,
+                               OUT connections bigint, OUT connections_reused bigint,
+                               OUT statements bigint, OUT rows bigint, OUT bytes bigint,
+                               OUT remote_time double precision, OUT errors bigint)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'odbc_fdw_stats'
+LANGUAGE C STRICT;
+
+CREATE FUNCTION odbc_fdw_stats_reset() RETURNS void
+AS 'MODULE_PATHNAME', 'odbc_fdw_stats_reset'
+LANGUAGE C;
+
+REVOKE ALL ON FUNCTION odbc_fdw_stats_reset() FROM PUBLIC;
+
+CREATE VIEW pg_stat_odbc_fdw AS
+  SELECT s.dbid, s.serverid, srv.srvname AS server_name,
+         s.connections, s.connections_reused, s.statements, s.rows, s.bytes,
+         s.remote_time, s.errors
+  FROM odbc_fdw_stats() s
+  LEFT JOIN pg_database d ON d.oid = s.dbid
+  LEFT JOIN pg_foreign_server srv ON srv.oid = s.serverid AND d.datname = current_database()
+  WHERE s.kind = 'server';
+
+CREATE VIEW pg_stat_odbc_fdw_tables AS
+  SELECT s.dbid, s.serverid, s.relid, n.nspname AS schemaname, c.relname,
+         s.statements, s.rows, s.bytes, s.remote_time
+  FROM odbc_fdw_stats() s
+  LEFT JOIN pg_database d ON d.oid = s.dbid
+  LEFT JOIN pg_class c ON c.oid = s.relid AND d.datname = current_database()
+  LEFT JOIN pg_namespace n ON n.oid = c.relnamespace
+  WHERE s.kind = 'table';
+
+CREATE VIEW pg_stat_odbc_fdw_statements AS
+  SELECT s.dbid, s.serverid, s.queryid, s.query,
+         s.statements AS calls, s.rows, s.bytes, s.remote_time
+  FROM odbc_fdw_stats() s
+  WHERE s.kind = 'statement';
+
+CREATE FUNCTION odbc_fdw_benchmark(server text, sql text, fetch_size integer DEFAULT 1000, mode text DEFAULT 'datum',
+                                   OUT phase text, OUT wall_ms double precision, OUT cpu_ms double precision,
+                                   OUT rows bigint, OUT bytes bigint,
+                                   OUT rows_per_sec double precision, OUT mb_per_sec double precision)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'odbc_fdw_benchmark'
+LANGUAGE C STRICT;
+
+CREATE FUNCTION odbc_fdw_calibrate(server text, sql text, store boolean DEFAULT true,
+                                   OUT latency_ms double precision, OUT rows bigint, OUT bytes bigint,
+                                   OUT mb_per_sec double precision, OUT fdw_startup_cost double precision,
+                                   OUT fdw_tuple_cost double precision, OUT fdw_byte_cost double precision)
+RETURNS record
+AS 'MODULE_PATHNAME', 'odbc_fdw_calibrate'
+LANGUAGE C STRICT;
@@ -22,6 +22,14 @@
 #include "postgres.h"
 #include <string.h>
 
+/*
+ * heap_open, ExecStoreTuple and the PostgreSQL 11 executor interfaces are
+ * used throughout; names such as DEFAULT_ROLE_WRITE_SERVER_FILES changed later
+ */
+#if PG_VERSION_NUM >= 120000
+#error "odbc_fdw supports PostgreSQL 9.5 to 11"
+#endif
+
 #include "funcapi.h"
 #include "access/reloptions.h"
 #include "catalog/pg_foreign_server.h"
@@ -45,27 +53,74 @@
 #include "utils/rel.h"
 #include "nodes/nodes.h"
 #include "nodes/makefuncs.h"
+#include "nodes/nodeFuncs.h"
 #include "nodes/pg_list.h"
 
 #include "optimizer/pathnode.h"
 #include "optimizer/restrictinfo.h"
 #include "optimizer/planmain.h"
+#include "optimizer/planner.h"
+#include "parser/parsetree.h"
 
 #include "access/tupdesc.h"
+#include "access/heapam.h"
+#include "access/htup_details.h"
+#include "access/sysattr.h"
+#include "access/transam.h"
+#include "access/xact.h"
+#include "catalog/pg_attribute.h"
+#include "catalog/pg_class.h"
+#include "catalog/pg_statistic.h"
+#include "catalog/indexing.h"
+#include "executor/executor.h"
+#include "catalog/pg_authid.h"
+#include "parser/parse_type.h"
+#include "rewrite/rewriteHandler.h"
+#include "parser/parse_oper.h"
+#include "portability/instr_time.h"
+#include "utils/pg_rusage.h"
+#include "utils/acl.h"
+#include "utils/lsyscache.h"
+#include "utils/numeric.h"
+#include "utils/guc.h"
+#include "utils/hsearch.h"
+#include "utils/tuplestore.h"
+#include "utils/rls.h"
+#include "utils/portal.h"
+#include "utils/snapmgr.h"
+#include "utils/resowner.h"
+#include "utils/syscache.h"
+#include "utils/fmgroids.h"
+#include "pgstat.h"
+#include "port/atomics.h"
+#include "storage/ipc.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
+#include "access/hash.h"
 
 /* TupleDescAttr was backported into 9.5.9 and 9.6.5 but we support any 9.5.X */
 #ifndef TupleDescAttr
 #define TupleDescAttr(tupdesc, i) ((tupdesc)->attrs[(i)])
 #endif
 
+/* ALLOCSET_DEFAULT_SIZES was introduced in 9.6 */
+#ifndef ALLOCSET_DEFAULT_SIZES
+#define ALLOCSET_DEFAULT_SIZES ALLOCSET_DEFAULT_MINSIZE, ALLOCSET_DEFAULT_INITSIZE, ALLOCSET_DEFAULT_MAXSIZE
+#endif
+
 #include "executor/spi.h"
 
 #include <stdio.h>
+#include <ctype.h>
+#include <math.h>
+#include <arpa/inet.h>
 #include <sql.h>
 #include <sqlext.h>
 
 PG_MODULE_MAGIC;
 
+void _PG_init(void);
+
 /* Macro to make conditional DEBUG more terse */
 #ifdef DEBUG
 #define elog_debug(...) elog(DEBUG1, __VA_ARGS__)
@@ -73,6 +128,21 @@ PG_MODULE_MAGIC;
 #define elog_debug(...) ((void) 0)
 #endif
 
+/*
+ * Static tracepoints (USDT) for perf, bpftrace or SystemTap, compiled in
+ * with "make USDT=1", which requires sys/sdt.h; no-ops otherwise
+ */
+#ifdef ODBC_FDW_USDT
+#include <sys/sdt.h>
+#define odbc_probe(name) DTRACE_PROBE(odbc_fdw, name)
+#define odbc_probe1(name, a) DTRACE_PROBE1(odbc_fdw, name, a)
+#define odbc_probe2(name, a, b) DTRACE_PROBE2(odbc_fdw, name, a, b)
+#else
+#define odbc_probe(name) ((void) 0)
+#define odbc_probe1(name, a) ((void) 0)
+#define odbc_probe2(name, a, b) ((void) 0)
+#endif
+
 #define PROCID_TEXTEQ 67
 #define PROCID_TEXTCONST 25
 
@@ -85,6 +155,17 @@ PG_MODULE_MAGIC;
 /* Maximum GetData buffer size */
 #define MAXIMUM_BUFFER_SIZE 8192
 
+/* Default number of rows per SQLFetch when fetching row arrays */
+#define DEFAULT_FETCH_SIZE 1000
+
+/* Maximum memory used by the buffers bound for a row array fetch */
+#define MAXIMUM_FETCH_BUFFER_SIZE (16 * 1024 * 1024)
+
+/* Default costs of a foreign scan (fdw_startup_cost, fdw_tuple_cost, fdw_byte_cost) */
+#define DEFAULT_FDW_STARTUP_COST 100.0
+#define DEFAULT_FDW_TUPLE_COST   0.01
+#define DEFAULT_FDW_BYTE_COST    0.0001
+
 /*
  * Numbers of the columns returned by SQLTables:
  * 1: TABLE_CAT (ODBC 3.0) TABLE_QUALIFIER (ODBC 2.0) -- database name
@@ -97,6 +178,36 @@ PG_MODULE_MAGIC;
 #define SQLTABLES_NAME_COLUMN 3
 
 #define ODBC_SQLSTATE_FRACTIONAL_TRUNCATION "01S07"
+
+/* Database dialects recognized by their SQL_DBMS_NAME */
+typedef enum
+{
+	ODBC_DIALECT_GENERIC,
+	ODBC_DIALECT_POSTGRESQL,
+	ODBC_DIALECT_SQLSERVER,
+	ODBC_DIALECT_MYSQL,
+	ODBC_DIALECT_HIVE
+} odbcDialect;
+
+/* Methods to obtain the number of rows of a table */
+typedef enum
+{
+	SIZE_ESTIMATE_AUTO,
+	SIZE_ESTIMATE_EXACT,
+	SIZE_ESTIMATE_QUICK,
+	SIZE_ESTIMATE_CATALOG
+} SizeEstimateMode;
+
+/* How result sets are read */
+typedef enum
+{
+	CURSOR_MODE_DEFAULT,        /* Cursor type chosen by the driver */
+	CURSOR_MODE_FORWARD_ONLY,   /* Forward-only, read-only cursors */
+	CURSOR_MODE_STREAMING       /* Forward-only, and driver attributes that avoid buffering the whole result */
+} CursorMode;
+
+/* Name of the junk attributes holding the key values of the rows to be modified */
+#define KEY_JUNK_ATTRIBUTE_NAME "odbc_fdw_key_%d"
 typedef struct odbcFdwOptions
 {
 	char  *schema;     /* Foreign schema name */
@@ -105,16 +216,62 @@ typedef struct odbcFdwOptions
 	char  *sql_query;  /* SQL query (overrides table) */
 	char  *sql_count;  /* SQL query for counting results */
 	char  *encoding;   /* Character encoding name */
+	int   batch_size;  /* Rows per INSERT execution */
+	int   commit_interval; /* Rows per remote transaction when modifying */
+	char  *size_estimate_mode; /* How the planner obtains the number of rows */
+	int   query_timeout;   /* Seconds before remote statements are cancelled */
+	int   connect_timeout; /* Seconds to wait for the connection */
+	char  *cursor_mode;    /* How result sets are read */
+	char  *read_only;      /* Session profile: read-only access mode */
+	int   packet_size;     /* Session profile: network packet size */
+	char  *isolation_level; /* Session profile: transaction isolation level */
+	char  *autocommit;     /* Session profile: autocommit mode */
+	char  *init_sql;       /* Session profile: statements executed on connection */
+	char  *fdw_startup_cost; /* Planner cost of starting a scan: connection and execution */
+	char  *fdw_tuple_cost;   /* Planner cost of each row received */
+	char  *fdw_byte_cost;    /* Planner cost of each byte received */
+	char  *use_remote_estimate; /* Planner estimates obtained from the remote database */
+
+	Oid   serverid;        /* Foreign server the options belong to */
 
 	List *connection_list; /* ODBC connection attributes */
 
 	List  *mapping_list; /* Column name mapping */
 } odbcFdwOptions;
 
+/* Metrics of a foreign scan shown by EXPLAIN ANALYZE and logged by log_min_remote_duration */
+typedef struct odbcScanMetrics
+{
+	bool    enabled;
+	double  connect_ms;
+	double  execute_ms;
+	double  first_row_ms;   /* From the execution to the first row fetched */
+	double  fetch_ms;       /* SQLFetch and SQLGetData */
+	double  convert_ms;     /* Conversion of the values to tuples */
+	int64   fetches;        /* Calls to SQLFetch: at most one round trip each */
+	int64   rows;
+	int64   bytes;          /* Size of the values fetched, as text */
+} odbcScanMetrics;
+
+/* Planner estimates of a foreign scan, kept in the fdw_private of its RelOptInfo */
+typedef struct odbcFdwRelationInfo
+{
+	double  remote_rows;    /* Rows returned by the remote query */
+	int     remote_width;   /* Average bytes per row returned */
+	Cost    startup_cost;   /* Cost options of the server */
+	Cost    tuple_cost;
+	Cost    byte_cost;
+	bool    has_remote_costs; /* Costs of the remote query, from use_remote_estimate */
+	Cost    remote_startup_cost;
+	Cost    remote_total_cost;
+} odbcFdwRelationInfo;
+
 typedef struct odbcFdwExecutionState
 {
 	AttInMetadata   *attinmeta;
 	odbcFdwOptions  options;
+	SQLHENV         env;
+	SQLHDBC         dbc;
 	SQLHSTMT        stmt;
 	int             num_of_result_cols;
 	int             num_of_table_cols;
@@ -125,8 +282,44 @@ typedef struct odbcFdwExecutionState
 	List            *col_conversion_array;
 	char            *sql_count;
 	int             encoding;
+	Oid             relid;
+	char            *query;         /* Remote query */
+	odbcScanMetrics metrics;
 } odbcFdwExecutionState;
 
+typedef enum { TEXT_CONVERSION, HEX_CONVERSION, BIN_CONVERSION, BOOL_CONVERSION } ColumnConversion;
+
+typedef struct odbcFdwModifyState
+{
+	Relation          rel;
+	odbcFdwOptions    options;
+	SQLHENV           env;
+	SQLHDBC           dbc;
+	SQLHSTMT          stmt;
+	char              *query;          /* Prepared statement */
+	CmdType           operation;
+	List              *target_attrs;   /* Attribute numbers of the parameters */
+	List              *key_attrs;      /* Attribute numbers of the key columns (UPDATE, DELETE) */
+	AttrNumber        *key_junk_attnos; /* Junk attributes holding the key values */
+	int               num_keys;
+	int               num_params;      /* Target columns followed by key columns */
+	FmgrInfo          *out_functions;
+	ColumnConversion  *conversions;
+	SQLSMALLINT       *param_types;    /* Remote SQL types of the parameters */
+	SQLULEN           *param_sizes;
+	SQLSMALLINT       *param_digits;
+	bool              param_arrays;    /* Driver supports arrays of parameters */
+	int               encoding;
+	int               batch_size;      /* Rows per execution of the statement */
+	int               num_rows;        /* Rows in the current batch */
+	char              **values;        /* Parameter values: num_params arrays of batch_size */
+	SQLLEN            *lengths;        /* Lengths of the values or SQL_NULL_DATA */
+	MemoryContext     batch_context;
+	uint64            affected_rows;   /* Remote rows affected so far */
+	int               commit_interval; /* Rows per remote transaction, 0 for autocommit */
+	uint64            uncommitted_rows;
+} odbcFdwModifyState;
+
 struct odbcFdwOption
 {
 	const char   *optname;
@@ -148,6 +341,21 @@ static struct odbcFdwOption valid_options[] =
 	{ "dsn",        ForeignServerRelationId },
 	{ "driver",     ForeignServerRelationId },
 	{ "encoding",   ForeignServerRelationId },
+	{ "batch_size", ForeignServerRelationId },
+	{ "commit_interval", ForeignServerRelationId },
+	{ "size_estimate_mode", ForeignServerRelationId },
+	{ "query_timeout", ForeignServerRelationId },
+	{ "cursor_mode", ForeignServerRelationId },
+	{ "read_only", ForeignServerRelationId },
+	{ "packet_size", ForeignServerRelationId },
+	{ "isolation_level", ForeignServerRelationId },
+	{ "autocommit", ForeignServerRelationId },
+	{ "init_sql", ForeignServerRelationId },
+	{ "connect_timeout", ForeignServerRelationId },
+	{ "fdw_startup_cost", ForeignServerRelationId },
+	{ "fdw_tuple_cost", ForeignServerRelationId },
+	{ "fdw_byte_cost", ForeignServerRelationId },
+	{ "use_remote_estimate", ForeignServerRelationId },
 
 	/* Foreign table options */
 	{ "schema",     ForeignTableRelationId },
@@ -155,13 +363,27 @@ static struct odbcFdwOption valid_options[] =
 	{ "prefix",     ForeignTableRelationId },
 	{ "sql_query",  ForeignTableRelationId },
 	{ "sql_count",  ForeignTableRelationId },
+	{ "batch_size", ForeignTableRelationId },
+	{ "commit_interval", ForeignTableRelationId },
+	{ "size_estimate_mode", ForeignTableRelationId },
+	{ "query_timeout", ForeignTableRelationId },
+	{ "cursor_mode", ForeignTableRelationId },
+	{ "use_remote_estimate", ForeignTableRelationId },
+
+	/* User mapping options */
+	{ "read_only", UserMappingRelationId },
+	{ "packet_size", UserMappingRelationId },
+	{ "isolation_level", UserMappingRelationId },
+	{ "autocommit", UserMappingRelationId },
+	{ "init_sql", UserMappingRelationId },
+
+	/* Foreign table column options */
+	{ "key",        AttributeRelationId },
 
 	/* Sentinel */
 	{ NULL,       InvalidOid}
 };
 
-typedef enum { TEXT_CONVERSION, HEX_CONVERSION, BIN_CONVERSION, BOOL_CONVERSION } ColumnConversion;
-
 /*
  * SQL functions
  */
@@ -169,18 +391,41 @@ extern Datum odbc_fdw_handler(PG_FUNCTION_ARGS);
 extern Datum odbc_fdw_validator(PG_FUNCTION_ARGS);
 extern Datum odbc_tables_list(PG_FUNCTION_ARGS);
 extern Datum odbc_table_size(PG_FUNCTION_ARGS);
+extern Datum odbc_table_size_estimate(PG_FUNCTION_ARGS);
 extern Datum odbc_query_size(PG_FUNCTION_ARGS);
+extern Datum odbc_fdw_export(PG_FUNCTION_ARGS);
+extern Datum odbc_fdw_load(PG_FUNCTION_ARGS);
+extern Datum odbc_fdw_import_stats(PG_FUNCTION_ARGS);
+extern Datum odbc_query(PG_FUNCTION_ARGS);
+extern Datum odbc_execute(PG_FUNCTION_ARGS);
+extern Datum odbc_fdw_handle_counts(PG_FUNCTION_ARGS);
+extern Datum odbc_fdw_stats(PG_FUNCTION_ARGS);
+extern Datum odbc_fdw_stats_reset(PG_FUNCTION_ARGS);
+extern Datum odbc_fdw_benchmark(PG_FUNCTION_ARGS);
+extern Datum odbc_fdw_calibrate(PG_FUNCTION_ARGS);
 
 PG_FUNCTION_INFO_V1(odbc_fdw_handler);
 PG_FUNCTION_INFO_V1(odbc_fdw_validator);
 PG_FUNCTION_INFO_V1(odbc_tables_list);
 PG_FUNCTION_INFO_V1(odbc_table_size);
+PG_FUNCTION_INFO_V1(odbc_table_size_estimate);
 PG_FUNCTION_INFO_V1(odbc_query_size);
+PG_FUNCTION_INFO_V1(odbc_fdw_export);
+PG_FUNCTION_INFO_V1(odbc_fdw_load);
+PG_FUNCTION_INFO_V1(odbc_fdw_import_stats);
+PG_FUNCTION_INFO_V1(odbc_query);
+PG_FUNCTION_INFO_V1(odbc_execute);
+PG_FUNCTION_INFO_V1(odbc_fdw_handle_counts);
+PG_FUNCTION_INFO_V1(odbc_fdw_stats);
+PG_FUNCTION_INFO_V1(odbc_fdw_stats_reset);
+PG_FUNCTION_INFO_V1(odbc_fdw_benchmark);
+PG_FUNCTION_INFO_V1(odbc_fdw_calibrate);
 
 /*
  * FDW callback routines
  */
 static void odbcExplainForeignScan(ForeignScanState *node, ExplainState *es);
+static void odbcExplainMilliseconds(const char *label, double value, ExplainState *es);
 static void odbcBeginForeignScan(ForeignScanState *node, int eflags);
 static TupleTableSlot *odbcIterateForeignScan(ForeignScanState *node);
 static void odbcReScanForeignScan(ForeignScanState *node);
@@ -191,6 +436,25 @@ static void odbcGetForeignPaths(PlannerInfo *root, RelOptInfo *baserel, Oid fore
 static bool odbcAnalyzeForeignTable(Relation relation, AcquireSampleRowsFunc *func, BlockNumber *totalpages);
 static ForeignScan* odbcGetForeignPlan(PlannerInfo *root, RelOptInfo *baserel, Oid foreigntableid, ForeignPath *best_path, List *tlist, List *scan_clauses, Plan *outer_plan);
 List* odbcImportForeignSchema(ImportForeignSchemaStmt *stmt, Oid serverOid);
+static int odbcIsForeignRelUpdatable(Relation rel);
+static List *odbcPlanForeignModify(PlannerInfo *root, ModifyTable *plan, Index resultRelation, int subplan_index);
+static void odbcBeginForeignModify(ModifyTableState *mtstate, ResultRelInfo *rinfo, List *fdw_private, int subplan_index, int eflags);
+static TupleTableSlot *odbcExecForeignInsert(EState *estate, ResultRelInfo *rinfo, TupleTableSlot *slot, TupleTableSlot *planSlot);
+static TupleTableSlot *odbcExecForeignUpdate(EState *estate, ResultRelInfo *rinfo, TupleTableSlot *slot, TupleTableSlot *planSlot);
+static TupleTableSlot *odbcExecForeignDelete(EState *estate, ResultRelInfo *rinfo, TupleTableSlot *slot, TupleTableSlot *planSlot);
+static void odbcAddForeignUpdateTargets(Query *parsetree, RangeTblEntry *target_rte, Relation target_relation);
+#if PG_VERSION_NUM >= 90600
+static bool odbcPlanDirectModify(PlannerInfo *root, ModifyTable *plan, Index resultRelation, int subplan_index);
+static void odbcBeginDirectModify(ForeignScanState *node, int eflags);
+static TupleTableSlot *odbcIterateDirectModify(ForeignScanState *node);
+static void odbcEndDirectModify(ForeignScanState *node);
+static void odbcExplainDirectModify(ForeignScanState *node, ExplainState *es);
+#endif
+static void odbcEndForeignModify(EState *estate, ResultRelInfo *rinfo);
+#if PG_VERSION_NUM >= 110000
+static void odbcBeginForeignInsert(ModifyTableState *mtstate, ResultRelInfo *rinfo);
+static void odbcEndForeignInsert(EState *estate, ResultRelInfo *rinfo);
+#endif
 
 /*
  * helper functions
@@ -202,15 +466,43 @@ static void extract_odbcFdwOptions(List *options_list, odbcFdwOptions *extracted
 static void init_odbcFdwOptions(odbcFdwOptions* options);
 static void copy_odbcFdwOptions(odbcFdwOptions* to, odbcFdwOptions* from);
 static void odbc_connection(odbcFdwOptions* options, SQLHENV *env, SQLHDBC *dbc);
+static void odbcXactCallback(XactEvent event, void *arg);
+static void odbcUnregisterActiveStatement(SQLHSTMT stmt);
+static void odbcResetRemoteEstimates(void);
+static void odbcStatsShmemRequest(void);
+static void odbcStatsShmemStartup(void);
+static void odbcResourceRelease(ResourceReleasePhase phase, bool isCommit, bool isTopLevel, void *arg);
+static void odbcSubXactCallback(SubXactEvent event, SubTransactionId mySubid, SubTransactionId parentSubid, void *arg);
 static void sql_data_type(SQLSMALLINT odbc_data_type, SQLULEN column_size, SQLSMALLINT decimal_digits, SQLSMALLINT nullable, StringInfo sql_type);
 static void odbcGetOptions(Oid server_oid, List *add_options, odbcFdwOptions *extracted_options);
 static void odbcGetTableOptions(Oid foreigntableid, odbcFdwOptions *extracted_options);
-static void odbcGetTableSize(odbcFdwOptions* options, unsigned int *size);
+static bool odbcGetTableSize(odbcFdwOptions* options, SizeEstimateMode mode, int64 *size);
+static bool odbcGetTableSizeOnConnection(SQLHDBC dbc, odbcFdwOptions* options, SizeEstimateMode mode, int64 *size);
+static int64 odbcTableRowEstimate(SQLHDBC dbc, const char *catalog, const char *schema, const char *table);
+static SizeEstimateMode size_estimate_mode_from_name(const char *name);
+static CursorMode cursor_mode_from_name(const char *name);
+static SQLULEN isolation_level_from_name(const char *name);
+static void odbcApplySessionProfile(SQLHDBC dbc, odbcFdwOptions *options);
+static bool odbc_autocommit(odbcFdwOptions *options);
+static bool option_bool_value(const char *value, bool default_value);
+static odbcDialect odbcDriverDialect(odbcFdwOptions *options);
+static CursorMode get_cursor_mode(odbcFdwOptions *options);
+static const char *odbcConnAttribute(odbcFdwOptions *options, const char *name);
 static void check_return(SQLRETURN ret, char *msg, SQLHANDLE handle, SQLSMALLINT type);
 static void odbcConnStr(StringInfoData *conn_str, odbcFdwOptions* options);
 static char* get_schema_name(odbcFdwOptions *options);
 static inline bool is_blank_string(const char *s);
 static Oid oid_from_server_name(char *serverName);
+static int option_int_value(DefElem *def);
+static void odbcBindModifyParam(odbcFdwModifyState *fmstate, int p, char *buffer, SQLLEN width, SQLLEN *lengths);
+static void odbcCommitModify(odbcFdwModifyState *fmstate);
+static void odbcCountAffectedRows(odbcFdwModifyState *fmstate, SQLRETURN ret, SQLULEN rows);
+static List *odbcGetKeyAttrs(Relation rel);
+static bool odbcGetPrimaryKeyColumns(SQLHDBC dbc, const char *schema_name, const char *table_name, HTAB *imported_tables);
+static List *odbcGetTablesColumns(SQLHDBC dbc, const char *schema_name, List *tables);
+static void appendQuotedString(StringInfo str, const char *s);
+static void appendSQLServerName(StringInfo str, const char *schema_name, const char *name);
+static const char *remote_column_name(odbcFdwOptions *options, const char *column_name);
 
 /*
  * Check if string pointer is NULL or points to empty string
@@ -220,6 +512,57 @@ static inline bool is_blank_string(const char *s)
 	return s == NULL || s[0] == '\0';
 }
 
+/* Minimum remote time of the foreign scans logged, in milliseconds, or -1 */
+static int odbc_log_min_remote_duration = -1;
+
+/* Size of the shared statistics, and hooks to allocate them */
+static int odbc_stats_max = 1000;
+static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
+
+/*
+ * Module initialization
+ */
+void
+_PG_init(void)
+{
+	RegisterXactCallback(odbcXactCallback, NULL);
+	RegisterSubXactCallback(odbcSubXactCallback, NULL);
+	RegisterResourceReleaseCallback(odbcResourceRelease, NULL);
+
+	DefineCustomIntVariable("odbc_fdw.log_min_remote_duration",
+	                        "Sets the minimum remote time above which foreign scans are logged.",
+	                        "Zero logs all foreign scans; -1 disables logging.",
+	                        &odbc_log_min_remote_duration,
+	                        -1,
+	                        -1,
+	                        INT_MAX,
+	                        PGC_SUSET,
+	                        GUC_UNIT_MS,
+	                        NULL,
+	                        NULL,
+	                        NULL);
+
+	DefineCustomIntVariable("odbc_fdw.max_stats",
+	                        "Maximum number of servers, foreign tables and statements tracked by pg_stat_odbc_fdw.",
+	                        NULL,
+	                        &odbc_stats_max,
+	                        1000,
+	                        100,
+	                        INT_MAX / 2,
+	                        PGC_POSTMASTER,
+	                        0,
+	                        NULL,
+	                        NULL,
+	                        NULL);
+
+	/* Statistics are kept in shared memory, which must be reserved at server start */
+	if (!process_shared_preload_libraries_in_progress)
+		return;
+	odbcStatsShmemRequest();
+	prev_shmem_startup_hook = shmem_startup_hook;
+	shmem_startup_hook = odbcStatsShmemStartup;
+}
+
 Datum
 odbc_fdw_handler(PG_FUNCTION_ARGS)
 {
@@ -235,6 +578,25 @@ odbc_fdw_handler(PG_FUNCTION_ARGS)
 	fdwroutine->ReScanForeignScan = odbcReScanForeignScan;
 	fdwroutine->EndForeignScan = odbcEndForeignScan;
 	fdwroutine->ImportForeignSchema = odbcImportForeignSchema;
+	fdwroutine->IsForeignRelUpdatable = odbcIsForeignRelUpdatable;
+	fdwroutine->PlanForeignModify = odbcPlanForeignModify;
+	fdwroutine->BeginForeignModify = odbcBeginForeignModify;
+	fdwroutine->ExecForeignInsert = odbcExecForeignInsert;
+	fdwroutine->ExecForeignUpdate = odbcExecForeignUpdate;
+	fdwroutine->ExecForeignDelete = odbcExecForeignDelete;
+	fdwroutine->AddForeignUpdateTargets = odbcAddForeignUpdateTargets;
+#if PG_VERSION_NUM >= 90600
+	fdwroutine->PlanDirectModify = odbcPlanDirectModify;
+	fdwroutine->BeginDirectModify = odbcBeginDirectModify;
+	fdwroutine->IterateDirectModify = odbcIterateDirectModify;
+	fdwroutine->EndDirectModify = odbcEndDirectModify;
+	fdwroutine->ExplainDirectModify = odbcExplainDirectModify;
+#endif
+	fdwroutine->EndForeignModify = odbcEndForeignModify;
+#if PG_VERSION_NUM >= 110000
+	fdwroutine->BeginForeignInsert = odbcBeginForeignInsert;
+	fdwroutine->EndForeignInsert = odbcEndForeignInsert;
+#endif
 	PG_RETURN_POINTER(fdwroutine);
 }
 
@@ -295,6 +657,54 @@ get_odbc_attribute_name(const char* defname)
 	return normalized_attribute(defname + offset);
 }
 
+/*
+ * Value of an option that must be a positive integer
+ */
+static int
+option_int_value(DefElem *def)
+{
+	char *value = defGetString(def);
+	char *end;
+	long  number;
+
+	errno = 0;
+	number = strtol(value, &end, 10);
+	if (errno != 0 || end == value || *end != '\0' || number <= 0 || number > INT_MAX)
+	{
+		ereport(ERROR,
+		        (errcode(ERRCODE_FDW_INVALID_ATTRIBUTE_VALUE),
+		         errmsg("invalid value for option \"%s\": \"%s\"", def->defname, value),
+		         errhint("The value must be a positive integer.")
+		        ));
+	}
+	return (int) number;
+}
+
+/*
+ * Value of a cost option, or default_value if it isn't defined
+ */
+static double
+option_cost_value(const char *name, const char *value, double default_value)
+{
+	char   *end;
+	double  number;
+
+	if (value == NULL)
+		return default_value;
+
+	errno = 0;
+	number = strtod(value, &end);
+	if (errno != 0 || end == value || *end != '\0' || number < 0 || isinf(number))
+	{
+		ereport(ERROR,
+		        (errcode(ERRCODE_FDW_INVALID_ATTRIBUTE_VALUE),
+		         errmsg("invalid value for option \"%s\": \"%s\"", name, value),
+		         errhint("The value must be a non-negative number.")
+		        ));
+	}
+	return number;
+}
+
 static void
 extract_odbcFdwOptions(List *options_list, odbcFdwOptions *extracted_options)
 {
@@ -357,6 +767,104 @@ extract_odbcFdwOptions(List *options_list, odbcFdwOptions *extracted_options)
 			continue;
 		}
 
+		if (strcmp(def->defname, "batch_size") == 0)
+		{
+			/* Table options take precedence over server options */
+			if (extracted_options->batch_size == 0)
+				extracted_options->batch_size = option_int_value(def);
+			continue;
+		}
+
+		if (strcmp(def->defname, "commit_interval") == 0)
+		{
+			if (extracted_options->commit_interval == 0)
+				extracted_options->commit_interval = option_int_value(def);
+			continue;
+		}
+
+		if (strcmp(def->defname, "size_estimate_mode") == 0)
+		{
+			if (extracted_options->size_estimate_mode == NULL)
+				extracted_options->size_estimate_mode = defGetString(def);
+			continue;
+		}
+
+		if (strcmp(def->defname, "query_timeout") == 0)
+		{
+			if (extracted_options->query_timeout == 0)
+				extracted_options->query_timeout = option_int_value(def);
+			continue;
+		}
+
+		if (strcmp(def->defname, "cursor_mode") == 0)
+		{
+			if (extracted_options->cursor_mode == NULL)
+				extracted_options->cursor_mode = defGetString(def);
+			continue;
+		}
+
+		/* The session profile of the user mapping overrides that of the server */
+		if (strcmp(def->defname, "read_only") == 0)
+		{
+			extracted_options->read_only = defGetString(def);
+			continue;
+		}
+
+		if (strcmp(def->defname, "packet_size") == 0)
+		{
+			extracted_options->packet_size = option_int_value(def);
+			continue;
+		}
+
+		if (strcmp(def->defname, "isolation_level") == 0)
+		{
+			extracted_options->isolation_level = defGetString(def);
+			continue;
+		}
+
+		if (strcmp(def->defname, "autocommit") == 0)
+		{
+			extracted_options->autocommit = defGetString(def);
+			continue;
+		}
+
+		if (strcmp(def->defname, "init_sql") == 0)
+		{
+			extracted_options->init_sql = defGetString(def);
+			continue;
+		}
+
+		if (strcmp(def->defname, "connect_timeout") == 0)
+		{
+			extracted_options->connect_timeout = option_int_value(def);
+			continue;
+		}
+
+		if (strcmp(def->defname, "fdw_startup_cost") == 0)
+		{
+			extracted_options->fdw_startup_cost = defGetString(def);
+			continue;
+		}
+
+		if (strcmp(def->defname, "fdw_tuple_cost") == 0)
+		{
+			extracted_options->fdw_tuple_cost = defGetString(def);
+			continue;
+		}
+
+		if (strcmp(def->defname, "fdw_byte_cost") == 0)
+		{
+			extracted_options->fdw_byte_cost = defGetString(def);
+			continue;
+		}
+
+		if (strcmp(def->defname, "use_remote_estimate") == 0)
+		{
+			if (extracted_options->use_remote_estimate == NULL)
+				extracted_options->use_remote_estimate = defGetString(def);
+			continue;
+		}
+
 		if (is_odbc_attribute(def->defname))
 		{
 			extracted_options->connection_list = lappend(extracted_options->connection_list, def);
@@ -379,1449 +887,7038 @@ static char* get_schema_name(odbcFdwOptions *options)
 }
 
 /*
- * Establish ODBC connection
+ * ODBC handles
+ *
+ * Every handle is allocated with odbcAllocHandle, which records it with
+ * the current resource owner, and freed with odbcFreeHandle. Handles
+ * still allocated when their resource owner is released (normally
+ * because of an error) are freed then, so that neither the memory of
+ * the driver nor remote sessions are leaked. Handles kept for the rest
+ * of the session (cached connections) are detached with odbcKeepHandle.
  */
-static void
-odbc_connection(odbcFdwOptions* options, SQLHENV *env, SQLHDBC *dbc)
+typedef struct odbcTrackedHandle
 {
-	StringInfoData  conn_str;
-	SQLCHAR OutConnStr[1024];
-	SQLSMALLINT OutConnStrLen;
-	SQLRETURN ret;
+	SQLSMALLINT type;
+	SQLHANDLE handle;
+	SQLHANDLE parent;       /* Connection of a statement */
+	ResourceOwner owner;    /* NULL if kept for the session */
+	struct odbcTrackedHandle *next;
+} odbcTrackedHandle;
+
+static odbcTrackedHandle *TrackedHandles = NULL;
+
+/* Counters shown by odbc_fdw_handles(), by type: environment, connection, statement */
+#define NUM_HANDLE_TYPES 3
+static const char *const handle_type_names[NUM_HANDLE_TYPES] = { "environment", "connection", "statement" };
+static int64 handles_live[NUM_HANDLE_TYPES];
+static int64 handles_allocated[NUM_HANDLE_TYPES];
+static int64 handles_released[NUM_HANDLE_TYPES];    /* Freed by the resource owner */
+
+static int
+handle_type_index(SQLSMALLINT type)
+{
+	switch (type)
+	{
+		case SQL_HANDLE_ENV:
+			return 0;
+		case SQL_HANDLE_DBC:
+			return 1;
+		default:
+			return 2;
+	}
+}
 
-	odbcConnStr(&conn_str, options);
+static SQLRETURN
+odbcAllocHandle(SQLSMALLINT type, SQLHANDLE input, SQLHANDLE *output)
+{
+	odbcTrackedHandle *tracked;
+	SQLRETURN ret;
 
-	/* Allocate an environment handle */
-	SQLAllocHandle(SQL_HANDLE_ENV, SQL_NULL_HANDLE, env);
-	/* We want ODBC 3 support */
-	SQLSetEnvAttr(*env, SQL_ATTR_ODBC_VERSION, (void *) SQL_OV_ODBC3, 0);
+	/* Allocate the entry first, so that it can't fail after the handle */
+	tracked = (odbcTrackedHandle *) MemoryContextAlloc(TopMemoryContext, sizeof(odbcTrackedHandle));
+	ret = SQLAllocHandle(type, input, output);
+	if (!SQL_SUCCEEDED(ret))
+	{
+		pfree(tracked);
+		return ret;
+	}
 
-	/* Allocate a connection handle */
-	SQLAllocHandle(SQL_HANDLE_DBC, *env, dbc);
-	/* Connect to the DSN */
-	ret = SQLDriverConnect(*dbc, NULL, (SQLCHAR *) conn_str.data, SQL_NTS,
-	                       OutConnStr, 1024, &OutConnStrLen, SQL_DRIVER_COMPLETE);
-	check_return(ret, "Connecting to driver", dbc, SQL_HANDLE_DBC);
+	tracked->type = type;
+	tracked->handle = *output;
+	tracked->parent = type == SQL_HANDLE_STMT ? input : SQL_NULL_HANDLE;
+	tracked->owner = CurrentResourceOwner;
+	tracked->next = TrackedHandles;
+	TrackedHandles = tracked;
+	handles_live[handle_type_index(type)]++;
+	handles_allocated[handle_type_index(type)]++;
+	return ret;
 }
 
-/*
- * Validate function
- */
-Datum
-odbc_fdw_validator(PG_FUNCTION_ARGS)
+static odbcTrackedHandle *
+odbcUntrackHandle(SQLHANDLE handle)
 {
-	List  *options_list = untransformRelOptions(PG_GETARG_DATUM(0));
-	Oid   catalog = PG_GETARG_OID(1);
-	char  *svr_schema   = NULL;
-	char  *svr_table    = NULL;
-	char  *svr_prefix   = NULL;
-	char  *sql_query    = NULL;
-	char  *sql_count    = NULL;
-	ListCell *cell;
-
-	elog_debug("%s", __func__);
+	odbcTrackedHandle **prev;
 
-	/*
-	 * Check that the necessary options: address, port, database
-	 */
-	foreach(cell, options_list)
+	for (prev = &TrackedHandles; *prev; prev = &(*prev)->next)
 	{
-		DefElem    *def = (DefElem *) lfirst(cell);
+		odbcTrackedHandle *tracked = *prev;
 
-		/* Complain invalid options */
-		if (!odbcIsValidOption(def->defname, catalog))
+		if (tracked->handle == handle)
 		{
-			struct odbcFdwOption *opt;
-			StringInfoData buf;
-
-			/*
-			 * Unknown option specified, complain about it. Provide a hint
-			 * with list of valid options for the object.
-			 */
-			initStringInfo(&buf);
-			for (opt = valid_options; opt->optname; opt++)
-			{
-				if (catalog == opt->optcontext)
-					appendStringInfo(&buf, "%s%s", (buf.len > 0) ? ", " : "",
-					                 opt->optname);
-			}
-
-			ereport(ERROR,
-			        (errcode(ERRCODE_FDW_INVALID_OPTION_NAME),
-			         errmsg("invalid option \"%s\"", def->defname),
-			         errhint("Valid options in this context are: %s", buf.len ? buf.data : "<none>")
-			        ));
+			*prev = tracked->next;
+			handles_live[handle_type_index(tracked->type)]--;
+			return tracked;
 		}
+	}
+	return NULL;
+}
 
-		/* TODO: detect redundant connection attributes and missing required attributs (dsn or driver)
-		 * Complain about redundent options
-		 */
-		if (strcmp(def->defname, "schema") == 0)
-		{
-			if (!is_blank_string(svr_schema))
-				ereport(ERROR,
-				        (errcode(ERRCODE_SYNTAX_ERROR),
-				         errmsg("conflicting or redundant options: schema (%s)", defGetString(def))
-				        ));
-
-			svr_schema = defGetString(def);
-		}
-		else if (strcmp(def->defname, "table") == 0)
-		{
-			if (!is_blank_string(svr_table))
-				ereport(ERROR,
-				        (errcode(ERRCODE_SYNTAX_ERROR),
-				         errmsg("conflicting or redundant options: table (%s)", defGetString(def))
-				        ));
+/*
+ * Free the statements still allocated on a connection about to be
+ * disconnected; SQLDisconnect would free them behind our back, leaving
+ * dangling entries for the resource owner to free again
+ */
+static void
+odbcFreeChildHandles(SQLHANDLE dbc)
+{
+	odbcTrackedHandle **prev = &TrackedHandles;
 
-			svr_table = defGetString(def);
-		}
-		else if (strcmp(def->defname, "prefix") == 0)
-		{
-			if (!is_blank_string(svr_prefix))
-				ereport(ERROR,
-				        (errcode(ERRCODE_SYNTAX_ERROR),
-				         errmsg("conflicting or redundant options: prefix (%s)", defGetString(def))
-				        ));
+	while (*prev)
+	{
+		odbcTrackedHandle *tracked = *prev;
 
-			svr_prefix = defGetString(def);
-		}
-		else if (strcmp(def->defname, "sql_query") == 0)
+		if (tracked->type != SQL_HANDLE_STMT || tracked->parent != dbc)
 		{
-			if (sql_query)
-				ereport(ERROR,
-				        (errcode(ERRCODE_SYNTAX_ERROR),
-				         errmsg("conflicting or redundant options: sql_query (%s)", defGetString(def))
-				        ));
-
-			sql_query = defGetString(def);
+			prev = &tracked->next;
+			continue;
 		}
-		else if (strcmp(def->defname, "sql_count") == 0)
-		{
-			if (!is_blank_string(sql_count))
-				ereport(ERROR,
-				        (errcode(ERRCODE_SYNTAX_ERROR),
-				         errmsg("conflicting or redundant options: sql_count (%s)", defGetString(def))
-				        ));
 
-			sql_count = defGetString(def);
-		}
+		*prev = tracked->next;
+		handles_live[handle_type_index(tracked->type)]--;
+		odbcUnregisterActiveStatement(tracked->handle);
+		SQLFreeHandle(SQL_HANDLE_STMT, tracked->handle);
+		pfree(tracked);
 	}
-
-	PG_RETURN_VOID();
 }
 
 /*
- * Map ODBC data types to PostgreSQL
+ * Disconnect a connection. SQLDisconnect fails (25000) while a transaction
+ * is open, leaving the remote session and its locks behind, so what was
+ * not committed by a connection in manual-commit mode (commit_interval,
+ * autocommit off) is rolled back first.
  */
 static void
-sql_data_type(
-    SQLSMALLINT odbc_data_type,
-    SQLULEN     column_size,
-    SQLSMALLINT decimal_digits,
-    SQLSMALLINT nullable,
-    StringInfo sql_type
-)
+odbcDisconnect(SQLHDBC dbc)
 {
-	initStringInfo(sql_type);
-	switch(odbc_data_type)
-	{
-	case SQL_CHAR:
-	case SQL_WCHAR :
-		appendStringInfo(sql_type, "char(%u)", (unsigned)column_size);
-		break;
-	case SQL_VARCHAR :
-	case SQL_WVARCHAR :
-		if (column_size <= 255)
-		{
-			appendStringInfo(sql_type, "varchar(%u)", (unsigned)column_size);
-		}
-		else
-		{
-			appendStringInfo(sql_type, "text");
-		}
-		break;
-	case SQL_LONGVARCHAR :
-	case SQL_WLONGVARCHAR :
-		appendStringInfo(sql_type, "text");
-		break;
-	case SQL_DECIMAL :
-		appendStringInfo(sql_type, "decimal(%u,%d)", (unsigned)column_size, decimal_digits);
-		break;
-	case SQL_NUMERIC :
-		appendStringInfo(sql_type, "numeric(%u,%d)", (unsigned)column_size, decimal_digits);
-		break;
-	case SQL_INTEGER :
-		appendStringInfo(sql_type, "integer");
-		break;
-	case SQL_REAL :
-		appendStringInfo(sql_type, "real");
-		break;
-	case SQL_FLOAT :
-		appendStringInfo(sql_type, "real");
-		break;
-	case SQL_DOUBLE :
-		appendStringInfo(sql_type, "float8");
-		break;
-	case SQL_BIT :
-		/* Use boolean instead of bit(1) because:
-		 * * binary types are not yet fully supported
-		 * * boolean is more commonly used in PG
-		 * * With options BoolsAsChar=0 this allows
-		 *   preserving boolean columns from pSQL ODBC.
-		 */
-		appendStringInfo(sql_type, "boolean");
-		break;
-	case SQL_SMALLINT :
-	case SQL_TINYINT :
-		appendStringInfo(sql_type, "smallint");
-		break;
-	case SQL_BIGINT :
-		appendStringInfo(sql_type, "bigint");
-		break;
-	/*
-	 * TODO: Implement these cases properly. See #23
-	 *
-	case SQL_BINARY :
-		appendStringInfo(sql_type, "bit(%u)", (unsigned)column_size);
-		break;
-	case SQL_VARBINARY :
-		appendStringInfo(sql_type, "varbit(%u)", (unsigned)column_size);
-		break;
-	*/
-	case SQL_LONGVARBINARY :
-		appendStringInfo(sql_type, "bytea");
-		break;
-	case SQL_TYPE_DATE :
-	case SQL_DATE :
-		appendStringInfo(sql_type, "date");
-		break;
-	case SQL_TYPE_TIME :
-	case SQL_TIME :
-		appendStringInfo(sql_type, "time");
-		break;
-	case SQL_TYPE_TIMESTAMP :
-	case SQL_TIMESTAMP :
-		appendStringInfo(sql_type, "timestamp");
-		break;
-	case SQL_GUID :
-		appendStringInfo(sql_type, "uuid");
-		break;
-	};
-}
+	SQLULEN autocommit = SQL_AUTOCOMMIT_ON;
 
-static SQLULEN
-minimum_buffer_size(SQLSMALLINT odbc_data_type)
-{
-	switch(odbc_data_type)
-	{
-	case SQL_DECIMAL :
-	case SQL_NUMERIC :
-		return 32;
-	case SQL_INTEGER :
-		return 12;
-	case SQL_REAL :
-	case SQL_FLOAT :
-		return 18;
-	case SQL_DOUBLE :
-		return 26;
-	case SQL_SMALLINT :
-	case SQL_TINYINT :
-		return 6;
-	case SQL_BIGINT :
-		return 21;
-	case SQL_TYPE_DATE :
-	case SQL_DATE :
-		return 10;
-	case SQL_TYPE_TIME :
-	case SQL_TIME :
-		return 8;
-	case SQL_TYPE_TIMESTAMP :
-	case SQL_TIMESTAMP :
-		return 20;
-	default :
-		return 0;
-	};
+	if (SQL_SUCCEEDED(SQLGetConnectAttr(dbc, SQL_ATTR_AUTOCOMMIT, &autocommit, 0, NULL)) &&
+	    autocommit == SQL_AUTOCOMMIT_OFF)
+		SQLEndTran(SQL_HANDLE_DBC, dbc, SQL_ROLLBACK);
+	SQLDisconnect(dbc);
 }
 
 /*
- * Fetch the options for a server and options list
+ * Free a handle; connections are disconnected first
  */
 static void
-odbcGetOptions(Oid server_oid, List *add_options, odbcFdwOptions *extracted_options)
+odbcFreeHandle(SQLSMALLINT type, SQLHANDLE handle)
 {
-	ForeignServer   *server;
-	UserMapping     *mapping;
-	List            *options;
-
-	elog_debug("%s", __func__);
-
-	server  = GetForeignServer(server_oid);
-	mapping = GetUserMapping(GetUserId(), server_oid);
+	odbcTrackedHandle *tracked;
 
-	options = NIL;
-	options = list_concat(options, add_options);
-	options = list_concat(options, server->options);
-	options = list_concat(options, mapping->options);
-
-	extract_odbcFdwOptions(options, extracted_options);
+	if (handle == NULL)
+		return;
+	if ((tracked = odbcUntrackHandle(handle)) != NULL)
+		pfree(tracked);
+	if (type == SQL_HANDLE_STMT)
+		odbcUnregisterActiveStatement(handle);
+	if (type == SQL_HANDLE_DBC)
+	{
+		odbcFreeChildHandles(handle);
+		odbcDisconnect(handle);
+	}
+	SQLFreeHandle(type, handle);
 }
 
 /*
- * Fetch the options for a odbc_fdw foreign table.
+ * Keep a handle beyond the current resource owner
  */
 static void
-odbcGetTableOptions(Oid foreigntableid, odbcFdwOptions *extracted_options)
+odbcKeepHandle(SQLHANDLE handle)
 {
-	ForeignTable    *table;
+	odbcTrackedHandle *tracked;
 
-	elog_debug("%s", __func__);
-
-	table = GetForeignTable(foreigntableid);
-	odbcGetOptions(table->serverid, table->options, extracted_options);
+	for (tracked = TrackedHandles; tracked; tracked = tracked->next)
+	{
+		if (tracked->handle == handle)
+			tracked->owner = NULL;
+	}
 }
 
+/*
+ * Free the handles of a resource owner being released; those of
+ * a committed subtransaction are passed on to its parent
+ */
 static void
-check_return(SQLRETURN ret, char *msg, SQLHANDLE handle, SQLSMALLINT type)
+odbcResourceRelease(ResourceReleasePhase phase, bool isCommit, bool isTopLevel, void *arg)
 {
-	int err_code = ERRCODE_SYSTEM_ERROR;
+	ResourceOwner owner = CurrentResourceOwner;
+	odbcTrackedHandle *tracked;
+	int pass;
 
-#ifdef DEBUG
-	SQLINTEGER   i = 0;
-	SQLINTEGER   native;
-	SQLCHAR  state[ 7 ];
-	SQLCHAR  text[256];
-	SQLSMALLINT  len;
-	SQLRETURN    diag_ret;
-	if (SQL_SUCCEEDED(ret))
-		elog(DEBUG1, "Successful result: %s", msg);
-#endif
+	if (phase != RESOURCE_RELEASE_AFTER_LOCKS || owner == NULL)
+		return;
 
-	if (!SQL_SUCCEEDED(ret))
+	if (isCommit && !isTopLevel && ResourceOwnerGetParent(owner) != NULL)
 	{
-#ifdef DEBUG
-		elog(DEBUG1, "Error result (%d): %s", ret, msg);
-		if (handle)
+		for (tracked = TrackedHandles; tracked; tracked = tracked->next)
 		{
-			do
+			if (tracked->owner == owner)
+				tracked->owner = ResourceOwnerGetParent(owner);
+		}
+		return;
+	}
+
+	/* Statements, then connections, then environments */
+	for (pass = NUM_HANDLE_TYPES - 1; pass >= 0; pass--)
+	{
+		odbcTrackedHandle **prev = &TrackedHandles;
+
+		while (*prev)
+		{
+			tracked = *prev;
+			if (tracked->owner != owner || handle_type_index(tracked->type) != pass)
 			{
-				diag_ret = SQLGetDiagRec(type, handle, ++i, state, &native, text,
-				                         sizeof(text), &len );
-				if (SQL_SUCCEEDED(diag_ret))
-					elog(DEBUG1, " %s:%ld:%ld:%s\n", state, (long int) i, (long int) native, text);
+				prev = &tracked->next;
+				continue;
 			}
-			while( diag_ret == SQL_SUCCESS );
+
+			if (isCommit)
+				elog(DEBUG1, "odbc_fdw: releasing leaked %s handle", handle_type_names[pass]);
+			*prev = tracked->next;
+			handles_live[pass]--;
+			handles_released[pass]++;
+			if (tracked->type == SQL_HANDLE_STMT)
+			{
+				odbcUnregisterActiveStatement(tracked->handle);
+				SQLCancel(tracked->handle);
+			}
+			if (tracked->type == SQL_HANDLE_DBC)
+			{
+				SQLHANDLE dbc = tracked->handle;
+
+				pfree(tracked);
+				/* May unlink entries before prev; start over */
+				odbcFreeChildHandles(dbc);
+				odbcDisconnect(dbc);
+				SQLFreeHandle(SQL_HANDLE_DBC, dbc);
+				prev = &TrackedHandles;
+				continue;
+			}
+			SQLFreeHandle(tracked->type, tracked->handle);
+			pfree(tracked);
 		}
-#endif
-		ereport(ERROR, (errcode(err_code), errmsg("%s", msg)));
 	}
 }
 
 /*
- * Get name qualifier char
+ * Counters of the ODBC handles of the session
  */
-static void
-getNameQualifierChar(SQLHDBC dbc, StringInfoData *nq_char)
+Datum
+odbc_fdw_handle_counts(PG_FUNCTION_ARGS)
 {
-	SQLCHAR name_qualifier_char[2];
-
-	elog_debug("%s", __func__);
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext old_context;
+	int i;
 
-	SQLGetInfo(dbc,
-	           SQL_CATALOG_NAME_SEPARATOR,
-	           (SQLPOINTER)&name_qualifier_char,
-	           2,
-	           NULL);
-	name_qualifier_char[1] = 0; // some drivers fail to copy the trailing zero
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+		        (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+		         errmsg("set-valued function called in context that cannot accept a set")));
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+		        (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+		         errmsg("materialize mode required, but it is not allowed in this context")));
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		ereport(ERROR,
+		        (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+		         errmsg("function returning record called in context "
+		                "that cannot accept type record")));
+
+	old_context = MemoryContextSwitchTo(rsinfo->econtext->ecxt_per_query_memory);
+	tupdesc = CreateTupleDescCopy(tupdesc);
+	tupstore = tuplestore_begin_heap(rsinfo->allowedModes & SFRM_Materialize_Random, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+	MemoryContextSwitchTo(old_context);
+
+	for (i = 0; i < NUM_HANDLE_TYPES; i++)
+	{
+		Datum values[4];
+		bool nulls[4] = { false, false, false, false };
+
+		values[0] = CStringGetTextDatum(handle_type_names[i]);
+		values[1] = Int64GetDatum(handles_live[i]);
+		values[2] = Int64GetDatum(handles_allocated[i]);
+		values[3] = Int64GetDatum(handles_released[i]);
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
 
-	initStringInfo(nq_char);
-	appendStringInfo(nq_char, "%s", (char *) name_qualifier_char);
+	return (Datum) 0;
 }
 
 /*
- * Get quote cahr
+ * Wait events reported while the backend is blocked in the driver,
+ * so that pg_stat_activity tells remote waits from local work.
+ * They are all reported as the generic Extension event, which
+ * appeared in PostgreSQL 10.
  */
-static void
-getQuoteChar(SQLHDBC dbc, StringInfoData *q_char)
+typedef enum
 {
-	SQLCHAR quote_char[2];
-
-	elog_debug("%s", __func__);
-
-	SQLGetInfo(dbc,
-	           SQL_IDENTIFIER_QUOTE_CHAR,
-	           (SQLPOINTER)&quote_char,
-	           2,
-	           NULL);
-	quote_char[1] = 0; // some drivers fail to copy the trailing zero
-
-	initStringInfo(q_char);
-	appendStringInfo(q_char, "%s", (char *) quote_char);
-}
-
-static bool appendConnAttribute(bool sep, StringInfoData *conn_str, const char* name, const char* value)
+	ODBC_WAIT_CONNECT,
+	ODBC_WAIT_EXECUTE,
+	ODBC_WAIT_FETCH,
+	ODBC_WAIT_GETDATA,
+	NUM_ODBC_WAIT_EVENTS
+} OdbcWaitEvent;
+
+static inline void
+odbcWaitStart(OdbcWaitEvent event)
 {
-	static const char *sep_str = ";";
-	if (!is_blank_string(value))
-	{
-		if (sep)
-			appendStringInfoString(conn_str, sep_str);
-		appendStringInfo(conn_str, "%s=%s", name, value);
-		sep = true;
-	}
-	return sep;
+#if PG_VERSION_NUM >= 100000
+	pgstat_report_wait_start(PG_WAIT_EXTENSION);
+#endif
 }
 
-static void odbcConnStr(StringInfoData *conn_str, odbcFdwOptions* options)
+static inline void
+odbcWaitEnd(void)
 {
-	bool sep = false;
-	ListCell *lc;
-
-	initStringInfo(conn_str);
-
-	foreach(lc, options->connection_list)
-	{
-		DefElem *def = (DefElem *) lfirst(lc);
-		sep = appendConnAttribute(sep, conn_str, get_odbc_attribute_name(def->defname), defGetString(def));
-	}
-	elog_debug("CONN STR: %s", conn_str->data);
+#if PG_VERSION_NUM >= 100000
+	pgstat_report_wait_end();
+#endif
 }
 
 /*
- * get table size of a table
+ * Blocking driver calls, reporting their wait events
  */
-static void
-odbcGetTableSize(odbcFdwOptions* options, unsigned int *size)
+static SQLRETURN
+odbcExecDirect(SQLHSTMT stmt, SQLCHAR *text, SQLINTEGER length)
 {
-	SQLHENV env;
-	SQLHDBC dbc;
-	SQLHSTMT stmt;
 	SQLRETURN ret;
 
-	StringInfoData  sql_str;
+	odbcWaitStart(ODBC_WAIT_EXECUTE);
+	ret = SQLExecDirect(stmt, text, length);
+	odbcWaitEnd();
+	return ret;
+}
 
-	SQLUBIGINT table_size;
-	SQLLEN indicator;
+static SQLRETURN
+odbcExecute(SQLHSTMT stmt)
+{
+	SQLRETURN ret;
 
-	StringInfoData name_qualifier_char;
-	StringInfoData quote_char;
+	odbcWaitStart(ODBC_WAIT_EXECUTE);
+	ret = SQLExecute(stmt);
+	odbcWaitEnd();
+	return ret;
+}
 
-	const char* schema_name;
+static SQLRETURN
+odbcMoreResults(SQLHSTMT stmt)
+{
+	SQLRETURN ret;
 
-	schema_name = get_schema_name(options);
+	odbcWaitStart(ODBC_WAIT_EXECUTE);
+	ret = SQLMoreResults(stmt);
+	odbcWaitEnd();
+	return ret;
+}
 
-	odbc_connection(options, &env, &dbc);
+static SQLRETURN
+odbcFetch(SQLHSTMT stmt)
+{
+	SQLRETURN ret;
 
-	/* Allocate a statement handle */
-	SQLAllocHandle(SQL_HANDLE_STMT, dbc, &stmt);
+	odbcWaitStart(ODBC_WAIT_FETCH);
+	ret = SQLFetch(stmt);
+	odbcWaitEnd();
+	return ret;
+}
 
-	if (is_blank_string(options->sql_count))
-	{
-		/* Get quote char */
-		getQuoteChar(dbc, &quote_char);
+static SQLRETURN
+odbcGetData(SQLHSTMT stmt, SQLUSMALLINT column, SQLSMALLINT target_type,
+            SQLPOINTER target, SQLLEN length, SQLLEN *indicator)
+{
+	SQLRETURN ret;
 
-		/* Get name qualifier char */
-		getNameQualifierChar(dbc, &name_qualifier_char);
+	odbcWaitStart(ODBC_WAIT_GETDATA);
+	ret = SQLGetData(stmt, column, target_type, target, length, indicator);
+	odbcWaitEnd();
+	return ret;
+}
 
-		initStringInfo(&sql_str);
-		if (is_blank_string(options->sql_query))
-		{
-			if (is_blank_string(schema_name))
-			{
-				appendStringInfo(&sql_str, "SELECT COUNT(*) FROM %s%s%s",
-				                 quote_char.data, options->table, quote_char.data);
-			}
-			else
-			{
-				appendStringInfo(&sql_str, "SELECT COUNT(*) FROM %s%s%s%s%s%s%s",
-				                 quote_char.data, schema_name, quote_char.data,
-				                 name_qualifier_char.data,
-				                 quote_char.data, options->table, quote_char.data);
-			}
-		}
-		else
-		{
-			if (options->sql_query[strlen(options->sql_query)-1] == ';')
-			{
-				/* Remove trailing semicolon if present */
-				options->sql_query[strlen(options->sql_query)-1] = 0;
-			}
-			appendStringInfo(&sql_str, "SELECT COUNT(*) FROM (%s) AS _odbc_fwd_count_wrapped", options->sql_query);
-		}
-	}
-	else
-	{
-		initStringInfo(&sql_str);
-		appendStringInfo(&sql_str, "%s", options->sql_count);
-	}
+/*
+ * Statistics of the remote activity, kept in shared memory when the
+ * library is loaded with shared_preload_libraries
+ *
+ * There is an entry for each foreign server, each foreign table and
+ * each distinct remote statement, identified as in pg_stat_statements
+ * by a hash of its text. Entries are never removed (a reset zeroes the
+ * counters), so each backend caches pointers to the entries it uses
+ * and only takes the lock the first time; the counters are updated
+ * with atomic operations.
+ */
+#define ODBC_STATS_QUERY_LEN 1024
 
-	elog_debug("Count query: %s", sql_str.data);
+typedef struct odbcStatsKey
+{
+	Oid     dbid;
+	Oid     serverid;
+	Oid     relid;      /* Foreign table, or InvalidOid */
+	uint64  queryid;    /* Hash of the statement, or 0 */
+} odbcStatsKey;
 
-	ret = SQLExecDirect(stmt, (SQLCHAR *) sql_str.data, SQL_NTS);
-	check_return(ret, "Executing ODBC query", stmt, SQL_HANDLE_STMT);
-	if (SQL_SUCCEEDED(ret))
-	{
-		SQLFetch(stmt);
-		/* retrieve column data as a big int */
-		ret = SQLGetData(stmt, 1, SQL_C_UBIGINT, &table_size, 0, &indicator);
-		if (SQL_SUCCEEDED(ret))
-		{
-			*size = (unsigned int) table_size;
-			elog_debug("Count query result: %lu", table_size);
-		}
-	}
-	else
-	{
-		elog(WARNING, "Error getting the table %s size", options->table);
-	}
+typedef struct odbcStatsEntry
+{
+	odbcStatsKey     key;
+	pg_atomic_uint64 connections;
+	pg_atomic_uint64 connections_reused;
+	pg_atomic_uint64 statements;
+	pg_atomic_uint64 rows;
+	pg_atomic_uint64 bytes;
+	pg_atomic_uint64 remote_time_us;
+	pg_atomic_uint64 errors;
+	char             query[ODBC_STATS_QUERY_LEN];
+} odbcStatsEntry;
+
+typedef struct odbcStatsShared
+{
+	LWLock *lock;       /* Protects the insertion of entries */
+} odbcStatsShared;
 
-	/* Free handles, and disconnect */
-	if (stmt)
-	{
-		SQLFreeHandle(SQL_HANDLE_STMT, stmt);
-		stmt = NULL;
-	}
-	if (dbc)
-	{
-		SQLFreeHandle(SQL_HANDLE_DBC, dbc);
-		dbc = NULL;
-	}
-	if (env)
-	{
-		SQLFreeHandle(SQL_HANDLE_ENV, env);
-		env = NULL;
-	}
-	if (dbc)
-		SQLDisconnect(dbc);
-}
+typedef struct odbcStatsLocalEntry
+{
+	odbcStatsKey   key;
+	odbcStatsEntry *entry;  /* NULL if the shared table was full */
+} odbcStatsLocalEntry;
 
-static int strtoint(const char *nptr, char **endptr, int base)
+static odbcStatsShared *StatsShared = NULL;
+static HTAB *StatsHash = NULL;
+static HTAB *StatsLocal = NULL;
+
+static Size
+odbcStatsShmemSize(void)
 {
-	long val = strtol(nptr, endptr, base);
-	return (int) val;
+	return add_size(MAXALIGN(sizeof(odbcStatsShared)),
+	                hash_estimate_size(odbc_stats_max, sizeof(odbcStatsEntry)));
 }
 
-static Oid oid_from_server_name(char *serverName)
+static void
+odbcStatsShmemRequest(void)
 {
-	char *serverOidString;
-	char sql[1024];
-	int serverOid;
-	HeapTuple tuple;
-	TupleDesc tupdesc;
-	int ret;
+	RequestAddinShmemSpace(odbcStatsShmemSize());
+#if PG_VERSION_NUM >= 90600
+	RequestNamedLWLockTranche("odbc_fdw", 1);
+#else
+	RequestAddinLWLocks(1);
+#endif
+}
 
-	if ((ret = SPI_connect()) < 0) {
-		elog(ERROR, "oid_from_server_name: SPI_connect returned %d", ret);
-	}
+static void
+odbcStatsShmemStartup(void)
+{
+	HASHCTL info;
+	bool found;
 
-	sprintf(sql, "SELECT oid FROM pg_foreign_server where srvname = '%s'", serverName);
-	if ((ret = SPI_execute(sql, true, 1)) != SPI_OK_SELECT) {
-		elog(ERROR, "oid_from_server_name: Get server name from Oid query Failed, SP_exec returned %d.", ret);
-	}
+	if (prev_shmem_startup_hook)
+		prev_shmem_startup_hook();
 
-	if (SPI_tuptable->vals[0] != NULL)
+	LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+	StatsShared = (odbcStatsShared *) ShmemInitStruct("odbc_fdw stats", sizeof(odbcStatsShared), &found);
+	if (!found)
 	{
-		tupdesc  = SPI_tuptable->tupdesc;
-		tuple    = SPI_tuptable->vals[0];
-
-		serverOidString = SPI_getvalue(tuple, tupdesc, 1);
-		serverOid = strtoint(serverOidString, NULL, 10);
-	} else {
-		elog(ERROR, "Foreign server %s doesn't exist", serverName);
+#if PG_VERSION_NUM >= 90600
+		StatsShared->lock = &(GetNamedLWLockTranche("odbc_fdw"))->lock;
+#else
+		StatsShared->lock = LWLockAssign();
+#endif
 	}
-
-	SPI_finish();
-	return serverOid;
+	memset(&info, 0, sizeof(info));
+	info.keysize = sizeof(odbcStatsKey);
+	info.entrysize = sizeof(odbcStatsEntry);
+	StatsHash = ShmemInitHash("odbc_fdw stats hash", odbc_stats_max, odbc_stats_max,
+	                          &info, HASH_ELEM | HASH_BLOBS);
+	LWLockRelease(AddinShmemInitLock);
 }
 
-Datum
-odbc_table_size(PG_FUNCTION_ARGS)
+static uint64
+odbcStatsQueryId(const char *query)
 {
-	char *serverName = text_to_cstring(PG_GETARG_TEXT_PP(0));
-	char *tableName = text_to_cstring(PG_GETARG_TEXT_PP(1));
-	char *defname = "table";
-	unsigned int tableSize;
-	List *tableOptions = NIL;
-	Node *val = (Node *) makeString(tableName);
-#if PG_VERSION_NUM >= 100000
-	DefElem *elem = (DefElem *) makeDefElem(defname, val, -1);
+	uint64 queryid;
+
+#if PG_VERSION_NUM >= 110000
+	queryid = DatumGetUInt64(hash_any_extended((const unsigned char *) query, strlen(query), 0));
 #else
-	DefElem *elem = (DefElem *) makeDefElem(defname, val);
+	queryid = DatumGetUInt32(hash_any((const unsigned char *) query, strlen(query)));
 #endif
+	/* 0 identifies the entries of servers and tables */
+	return queryid != 0 ? queryid : 1;
+}
 
-	tableOptions = lappend(tableOptions, elem);
-	Oid serverOid = oid_from_server_name(serverName);
-	odbcFdwOptions options;
-	odbcGetOptions(serverOid, tableOptions, &options);
-	odbcGetTableSize(&options, &tableSize);
+/*
+ * Shared entry of a server, of a foreign table (relid) or of a
+ * statement (query); NULL if statistics are not kept
+ */
+static odbcStatsEntry *
+odbcStatsGetEntry(Oid serverid, Oid relid, const char *query)
+{
+	odbcStatsKey key;
+	odbcStatsLocalEntry *local;
+	odbcStatsEntry *entry;
+	bool found;
+
+	if (StatsHash == NULL || !OidIsValid(serverid))
+		return NULL;
+
+	memset(&key, 0, sizeof(key));
+	key.dbid = MyDatabaseId;
+	key.serverid = serverid;
+	key.relid = relid;
+	if (query)
+		key.queryid = odbcStatsQueryId(query);
+
+	if (StatsLocal == NULL)
+	{
+		HASHCTL ctl;
+
+		memset(&ctl, 0, sizeof(ctl));
+		ctl.keysize = sizeof(odbcStatsKey);
+		ctl.entrysize = sizeof(odbcStatsLocalEntry);
+		ctl.hcxt = TopMemoryContext;
+		StatsLocal = hash_create("odbc_fdw stats entries", 64, &ctl,
+		                         HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+	}
+	local = (odbcStatsLocalEntry *) hash_search(StatsLocal, &key, HASH_ENTER, &found);
+	if (found)
+		return local->entry;
+
+	LWLockAcquire(StatsShared->lock, LW_SHARED);
+	entry = (odbcStatsEntry *) hash_search(StatsHash, &key, HASH_FIND, NULL);
+	LWLockRelease(StatsShared->lock);
+	if (entry == NULL)
+	{
+		LWLockAcquire(StatsShared->lock, LW_EXCLUSIVE);
+		entry = (odbcStatsEntry *) hash_search(StatsHash, &key, HASH_ENTER_NULL, &found);
+		if (entry && !found)
+		{
+			pg_atomic_init_u64(&entry->connections, 0);
+			pg_atomic_init_u64(&entry->connections_reused, 0);
+			pg_atomic_init_u64(&entry->statements, 0);
+			pg_atomic_init_u64(&entry->rows, 0);
+			pg_atomic_init_u64(&entry->bytes, 0);
+			pg_atomic_init_u64(&entry->remote_time_us, 0);
+			pg_atomic_init_u64(&entry->errors, 0);
+			entry->query[0] = '\0';
+			if (query)
+			{
+				int len = pg_mbcliplen(query, strlen(query), ODBC_STATS_QUERY_LEN - 1);
 
-	PG_RETURN_INT32(tableSize);
+				memcpy(entry->query, query, len);
+				entry->query[len] = '\0';
+			}
+		}
+		LWLockRelease(StatsShared->lock);
+	}
+	local->entry = entry;
+	return entry;
 }
 
-Datum
-odbc_query_size(PG_FUNCTION_ARGS)
+static inline bool
+odbcStatsEnabled(void)
 {
-	char *serverName = text_to_cstring(PG_GETARG_TEXT_PP(0));
-	char *sqlQuery = text_to_cstring(PG_GETARG_TEXT_PP(1));
-	char *defname = "sql_query";
-	unsigned int querySize;
-	List *queryOptions = NIL;
-	Node *val = (Node *) makeString(sqlQuery);
-#if PG_VERSION_NUM >= 100000
-	DefElem *elem = (DefElem *) makeDefElem(defname, val, -1);
-#else
-	DefElem *elem = (DefElem *) makeDefElem(defname, val);
-#endif
-
-	queryOptions = lappend(queryOptions, elem);
-	Oid serverOid = oid_from_server_name(serverName);
-	odbcFdwOptions options;
-	odbcGetOptions(serverOid, queryOptions, &options);
-	odbcGetTableSize(&options, &querySize);
+	return StatsHash != NULL;
+}
 
-	PG_RETURN_INT32(querySize);
+static void
+odbcStatsAdd(odbcStatsEntry *entry, int64 statements, int64 rows, int64 bytes, double remote_ms)
+{
+	if (entry == NULL)
+		return;
+	if (statements > 0)
+		pg_atomic_fetch_add_u64(&entry->statements, statements);
+	if (rows > 0)
+		pg_atomic_fetch_add_u64(&entry->rows, rows);
+	if (bytes > 0)
+		pg_atomic_fetch_add_u64(&entry->bytes, bytes);
+	if (remote_ms > 0)
+		pg_atomic_fetch_add_u64(&entry->remote_time_us, (uint64) (remote_ms * 1000.0));
 }
 
 /*
- * Get the list of tables for the current datasource
+ * Add remote activity to the statistics of the server and, if given,
+ * of the foreign table relid and of the statement query
  */
-typedef struct {
-	SQLSMALLINT TargetType;
-	SQLPOINTER TargetValuePtr;
-	SQLINTEGER BufferLength;
-	SQLLEN StrLen_or_Ind;
-} DataBinding;
-
-typedef struct {
-	Oid serverOid;
-	DataBinding* tableResult;
-	SQLHSTMT stmt;
-	SQLCHAR schema;
-	SQLCHAR name;
-	SQLUINTEGER rowLimit;
-	SQLUINTEGER currentRow;
-} TableDataCtx;
-
-
-Datum odbc_tables_list(PG_FUNCTION_ARGS)
+static void
+odbcStatsReport(odbcFdwOptions *options, Oid relid, const char *query,
+                int64 statements, int64 rows, int64 bytes, double remote_ms)
 {
-	SQLHENV env;
-	SQLHDBC dbc;
-	SQLHSTMT stmt;
-	SQLUSMALLINT i;
-	SQLUSMALLINT numColumns = 5;
-	SQLUSMALLINT bufferSize = 1024;
-	SQLUINTEGER rowLimit;
-	SQLUINTEGER currentRow;
-	SQLRETURN retCode;
-
-	FuncCallContext *funcctx;
-	TupleDesc tupdesc;
-	TableDataCtx *datafctx;
-	DataBinding* tableResult;
-	AttInMetadata *attinmeta;
+	if (!odbcStatsEnabled())
+		return;
+	odbcStatsAdd(odbcStatsGetEntry(options->serverid, InvalidOid, NULL), statements, rows, bytes, remote_ms);
+	if (OidIsValid(relid))
+		odbcStatsAdd(odbcStatsGetEntry(options->serverid, relid, NULL), statements, rows, bytes, remote_ms);
+	if (query)
+		odbcStatsAdd(odbcStatsGetEntry(options->serverid, InvalidOid, query), statements, rows, bytes, remote_ms);
+}
 
-	if (SRF_IS_FIRSTCALL()) {
-		funcctx = SRF_FIRSTCALL_INIT();
-		MemoryContext oldcontext = MemoryContextSwitchTo(funcctx->multi_call_memory_ctx);
-		datafctx = (TableDataCtx *) palloc(sizeof(TableDataCtx));
-		tableResult = (DataBinding*) palloc( numColumns * sizeof(DataBinding) );
+static void
+odbcStatsCountConnection(Oid serverid, bool reused)
+{
+	odbcStatsEntry *entry = odbcStatsGetEntry(serverid, InvalidOid, NULL);
 
-		char *serverName = text_to_cstring(PG_GETARG_TEXT_PP(0));
-		int serverOid = oid_from_server_name(serverName);
+	if (entry)
+		pg_atomic_fetch_add_u64(reused ? &entry->connections_reused : &entry->connections, 1);
+}
 
-		rowLimit = PG_GETARG_INT32(1);
-		currentRow = 0;
+static void
+odbcStatsCountError(Oid serverid)
+{
+	odbcStatsEntry *entry = odbcStatsGetEntry(serverid, InvalidOid, NULL);
 
-		odbcFdwOptions options;
-		odbcGetOptions(serverOid, NULL, &options);
-		odbc_connection(&options, &env, &dbc);
-		SQLAllocHandle(SQL_HANDLE_STMT, dbc, &stmt);
+	if (entry)
+		pg_atomic_fetch_add_u64(&entry->errors, 1);
+}
 
-		for ( i = 0 ; i < numColumns ; i++ ) {
-			tableResult[i].TargetType = SQL_C_CHAR;
-			tableResult[i].BufferLength = (bufferSize + 1);
-			tableResult[i].TargetValuePtr = palloc( sizeof(char)*tableResult[i].BufferLength );
-		}
+static void
+odbcStatsCheckEnabled(void)
+{
+	if (!odbcStatsEnabled())
+		ereport(ERROR,
+		        (errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+		         errmsg("odbc_fdw statistics are not available"),
+		         errhint("odbc_fdw must be loaded via shared_preload_libraries.")));
+}
 
-		for ( i = 0 ; i < numColumns ; i++ ) {
-			retCode = SQLBindCol(stmt, i + 1, tableResult[i].TargetType, tableResult[i].TargetValuePtr, tableResult[i].BufferLength, &(tableResult[i].StrLen_or_Ind));
-		}
+/*
+ * Statistics of the servers, foreign tables and statements of all the
+ * databases; shown by the pg_stat_odbc_fdw views
+ */
+Datum
+odbc_fdw_stats(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext old_context;
+	HASH_SEQ_STATUS status;
+	odbcStatsEntry *entry;
+
+	odbcStatsCheckEnabled();
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+		        (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+		         errmsg("set-valued function called in context that cannot accept a set")));
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+		        (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+		         errmsg("materialize mode required, but it is not allowed in this context")));
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		ereport(ERROR,
+		        (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+		         errmsg("function returning record called in context "
+		                "that cannot accept type record")));
+
+	old_context = MemoryContextSwitchTo(rsinfo->econtext->ecxt_per_query_memory);
+	tupdesc = CreateTupleDescCopy(tupdesc);
+	tupstore = tuplestore_begin_heap(rsinfo->allowedModes & SFRM_Materialize_Random, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+	MemoryContextSwitchTo(old_context);
+
+	LWLockAcquire(StatsShared->lock, LW_SHARED);
+	hash_seq_init(&status, StatsHash);
+	while ((entry = (odbcStatsEntry *) hash_seq_search(&status)) != NULL)
+	{
+		Datum values[13];
+		bool nulls[13];
+		const char *kind;
+
+		memset(nulls, 0, sizeof(nulls));
+		if (entry->key.queryid != 0)
+			kind = "statement";
+		else if (OidIsValid(entry->key.relid))
+			kind = "table";
+		else
+			kind = "server";
+
+		values[0] = CStringGetTextDatum(kind);
+		values[1] = ObjectIdGetDatum(entry->key.dbid);
+		values[2] = ObjectIdGetDatum(entry->key.serverid);
+		values[3] = ObjectIdGetDatum(entry->key.relid);
+		nulls[3] = !OidIsValid(entry->key.relid);
+		values[4] = Int64GetDatum((int64) entry->key.queryid);
+		nulls[4] = (entry->key.queryid == 0);
+		values[5] = CStringGetTextDatum(entry->query);
+		nulls[5] = (entry->key.queryid == 0);
+		values[6] = Int64GetDatum((int64) pg_atomic_read_u64(&entry->connections));
+		values[7] = Int64GetDatum((int64) pg_atomic_read_u64(&entry->connections_reused));
+		values[8] = Int64GetDatum((int64) pg_atomic_read_u64(&entry->statements));
+		values[9] = Int64GetDatum((int64) pg_atomic_read_u64(&entry->rows));
+		values[10] = Int64GetDatum((int64) pg_atomic_read_u64(&entry->bytes));
+		values[11] = Float8GetDatum(pg_atomic_read_u64(&entry->remote_time_us) / 1000.0);
+		values[12] = Int64GetDatum((int64) pg_atomic_read_u64(&entry->errors));
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+	LWLockRelease(StatsShared->lock);
 
-		if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
-			ereport(ERROR,
-			        (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
-			         errmsg("function returning record called in context "
-			                "that cannot accept type record")));
+	return (Datum) 0;
+}
 
-		attinmeta = TupleDescGetAttInMetadata(tupdesc);
+/*
+ * Zero the counters of all the entries
+ */
+Datum
+odbc_fdw_stats_reset(PG_FUNCTION_ARGS)
+{
+	HASH_SEQ_STATUS status;
+	odbcStatsEntry *entry;
 
-		datafctx->serverOid = serverOid;
-		datafctx->tableResult = tableResult;
-		datafctx->stmt = stmt;
-		datafctx->rowLimit = rowLimit;
-		datafctx->currentRow = currentRow;
-		funcctx->user_fctx = datafctx;
-		funcctx->attinmeta = attinmeta;
+	odbcStatsCheckEnabled();
 
-		MemoryContextSwitchTo(oldcontext);
+	LWLockAcquire(StatsShared->lock, LW_SHARED);
+	hash_seq_init(&status, StatsHash);
+	while ((entry = (odbcStatsEntry *) hash_seq_search(&status)) != NULL)
+	{
+		pg_atomic_write_u64(&entry->connections, 0);
+		pg_atomic_write_u64(&entry->connections_reused, 0);
+		pg_atomic_write_u64(&entry->statements, 0);
+		pg_atomic_write_u64(&entry->rows, 0);
+		pg_atomic_write_u64(&entry->bytes, 0);
+		pg_atomic_write_u64(&entry->remote_time_us, 0);
+		pg_atomic_write_u64(&entry->errors, 0);
 	}
+	LWLockRelease(StatsShared->lock);
 
-	funcctx = SRF_PERCALL_SETUP();
-
-	datafctx = funcctx->user_fctx;
-	stmt = datafctx->stmt;
-	tableResult = datafctx->tableResult;
-	rowLimit = datafctx->rowLimit;
-	currentRow = datafctx->currentRow;
-	attinmeta = funcctx->attinmeta;
-
-	retCode = SQLTables( stmt, NULL, SQL_NTS, NULL, SQL_NTS, NULL, SQL_NTS, (SQLCHAR*)"TABLE", SQL_NTS );
-	if (SQL_SUCCEEDED(retCode = SQLFetch(stmt)) && (rowLimit == 0 || currentRow < rowLimit)) {
-		char       **values;
-		HeapTuple    tuple;
-		Datum        result;
-
-		values = (char **) palloc(2 * sizeof(char *));
-		values[0] = (char *) palloc(256 * sizeof(char));
-		values[1] = (char *) palloc(256 * sizeof(char));
-		snprintf(values[0], 256, "%s", (char *)tableResult[SQLTABLES_SCHEMA_COLUMN-1].TargetValuePtr);
-		snprintf(values[1], 256, "%s", (char *)tableResult[SQLTABLES_NAME_COLUMN-1].TargetValuePtr);
-		tuple = BuildTupleFromCStrings(attinmeta, values);
-		result = HeapTupleGetDatum(tuple);
-		currentRow++;
-		datafctx->currentRow = currentRow;
-		SRF_RETURN_NEXT(funcctx, result);
-	} else {
-		SRF_RETURN_DONE(funcctx);
-	}
+	PG_RETURN_VOID();
 }
 
 /*
- * get quals in the select if there is one
+ * Establish ODBC connection
  */
 static void
-odbcGetQual(Node *node, TupleDesc tupdesc, List *col_mapping_list, char **key, char **value, bool *pushdown)
+odbc_connection(odbcFdwOptions* options, SQLHENV *env, SQLHDBC *dbc)
 {
-	ListCell *col_mapping;
-	*key = NULL;
-	*value = NULL;
-	*pushdown = false;
-
-	elog_debug("%s", __func__);
+	StringInfoData  conn_str;
+	SQLCHAR OutConnStr[1024];
+	SQLSMALLINT OutConnStrLen;
+	SQLRETURN ret;
 
-	if (!node)
-		return;
+	odbcConnStr(&conn_str, options);
 
-	if (IsA(node, OpExpr))
-	{
-		OpExpr  *op = (OpExpr *) node;
-		Node    *left, *right;
-		Index   varattno;
+	/* Allocate an environment handle */
+	odbcAllocHandle(SQL_HANDLE_ENV, SQL_NULL_HANDLE, env);
+	/* We want ODBC 3 support */
+	SQLSetEnvAttr(*env, SQL_ATTR_ODBC_VERSION, (void *) SQL_OV_ODBC3, 0);
 
-		if (list_length(op->args) != 2)
-			return;
+	/* Allocate a connection handle */
+	odbcAllocHandle(SQL_HANDLE_DBC, *env, dbc);
+	if (options->connect_timeout > 0)
+		SQLSetConnectAttr(*dbc, SQL_ATTR_LOGIN_TIMEOUT, (SQLPOINTER) (SQLULEN) options->connect_timeout, 0);
+	/* Attributes of the session profile that must be set before connecting */
+	if (options->packet_size > 0)
+		SQLSetConnectAttr(*dbc, SQL_ATTR_PACKET_SIZE, (SQLPOINTER) (SQLULEN) options->packet_size, 0);
+	if (option_bool_value(options->read_only, false))
+		SQLSetConnectAttr(*dbc, SQL_ATTR_ACCESS_MODE, (SQLPOINTER) SQL_MODE_READ_ONLY, 0);
+	/* Connect to the DSN */
+	odbc_probe1(connect_start, options->serverid);
+	odbcWaitStart(ODBC_WAIT_CONNECT);
+	ret = SQLDriverConnect(*dbc, NULL, (SQLCHAR *) conn_str.data, SQL_NTS,
+	                       OutConnStr, 1024, &OutConnStrLen, SQL_DRIVER_COMPLETE);
+	odbcWaitEnd();
+	odbc_probe2(connect_done, options->serverid, ret);
+	if (!SQL_SUCCEEDED(ret))
+		odbcStatsCountError(options->serverid);
+	check_return(ret, "Connecting to driver", dbc, SQL_HANDLE_DBC);
+	odbcStatsCountConnection(options->serverid, false);
 
-		left = list_nth(op->args, 0);
-		if (!IsA(left, Var))
+	odbcApplySessionProfile(*dbc, options);
+}
 
-			return;
-
-		varattno = ((Var *) left)->varattno;
-
-		right = list_nth(op->args, 1);
-
-		if (IsA(right, Const))
-		{
-			StringInfoData  buf;
-			initStringInfo(&buf);
-			/* And get the column and value... */
-			*key = NameStr(TupleDescAttr(tupdesc, varattno - 1)->attname);
-
-			if (((Const *) right)->consttype == PROCID_TEXTCONST)
-				*value = TextDatumGetCString(((Const *) right)->constvalue);
-			else
-			{
-				return;
-			}
-
-			/* convert qual keys to mapped couchdb attribute name */
-			foreach(col_mapping, col_mapping_list)
-			{
-				DefElem *def = (DefElem *) lfirst(col_mapping);
-				if (strcmp(def->defname, *key) == 0)
-				{
-					*key = defGetString(def);
-					break;
-				}
-			}
-
-			/*
-			 * We can push down this qual if:
-			 * - The operatory is TEXTEQ
-			 * - The qual is on the _id column (in addition, _rev column can be also valid)
-			 */
+static SQLULEN
+isolation_level_from_name(const char *name)
+{
+	if (strcmp(name, "read_uncommitted") == 0)
+		return SQL_TXN_READ_UNCOMMITTED;
+	if (strcmp(name, "read_committed") == 0)
+		return SQL_TXN_READ_COMMITTED;
+	if (strcmp(name, "repeatable_read") == 0)
+		return SQL_TXN_REPEATABLE_READ;
+	if (strcmp(name, "serializable") == 0)
+		return SQL_TXN_SERIALIZABLE;
+	ereport(ERROR,
+	        (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+	         errmsg("invalid isolation level \"%s\"", name),
+	         errhint("Valid levels are read_uncommitted, read_committed, repeatable_read and serializable.")));
+	return 0; /* keep compiler quiet */
+}
 
-			if (op->opfuncid == PROCID_TEXTEQ)
-				*pushdown = true;
+/*
+ * Value of a boolean option, or default_value if it is not defined
+ */
+static bool
+option_bool_value(const char *value, bool default_value)
+{
+	bool result;
 
-			return;
-		}
-	}
-	return;
+	if (value == NULL || !parse_bool(value, &result))
+		return default_value;
+	return result;
 }
 
 /*
- * Check if the provided option is one of the valid options.
- * context is the Oid of the catalog holding the object the option is for.
+ * Whether the connections of the options are in autocommit mode
  */
 static bool
-odbcIsValidOption(const char *option, Oid context)
+odbc_autocommit(odbcFdwOptions *options)
 {
-	struct odbcFdwOption *opt;
+	return option_bool_value(options->autocommit, true);
+}
 
-	elog_debug("%s", __func__);
+/*
+ * Execute the statements of init_sql, separated by semicolons
+ * (not within quotes), on a new connection
+ */
+static void
+odbcExecuteInitSql(SQLHDBC dbc, const char *init_sql)
+{
+	StringInfoData statement;
+	const char *p;
+	char quote = '\0';
+	SQLHSTMT stmt;
 
-	/* Check if the options presents in the valid option list */
-	for (opt = valid_options; opt->optname; opt++)
+	initStringInfo(&statement);
+	odbcAllocHandle(SQL_HANDLE_STMT, dbc, &stmt);
+	for (p = init_sql; ; p++)
 	{
-		if (context == opt->optcontext && strcmp(opt->optname, option) == 0)
-			return true;
-	}
+		if (*p == '\0' || (*p == ';' && quote == '\0'))
+		{
+			char *sql = statement.data;
 
-	/* ODBC attributes are valid in any context */
-	if (is_odbc_attribute(option))
-	{
-		return true;
+			while (isspace((unsigned char) *sql))
+				sql++;
+			if (*sql)
+			{
+				elog_debug("Executing init_sql: %s", sql);
+				check_return(odbcExecDirect(stmt, (SQLCHAR *) sql, SQL_NTS), "Executing init_sql", stmt, SQL_HANDLE_STMT);
+				SQLFreeStmt(stmt, SQL_CLOSE);
+			}
+			resetStringInfo(&statement);
+			if (*p == '\0')
+				break;
+			continue;
+		}
+		if (quote == '\0' && (*p == '\'' || *p == '"'))
+			quote = *p;
+		else if (*p == quote)
+			quote = '\0';
+		appendStringInfoChar(&statement, *p);
 	}
-
-	/* Foreign table may have anything as a mapping option */
-	if (context == ForeignTableRelationId)
-		return true;
-	else
-		return false;
+	odbcFreeHandle(SQL_HANDLE_STMT, stmt);
+	pfree(statement.data);
 }
 
-static void odbcGetForeignRelSize(PlannerInfo *root, RelOptInfo *baserel, Oid foreigntableid)
+/*
+ * Connection attributes of the session profile that
+ * can only be set once connected, and init_sql. The autocommit option
+ * is not applied here: only the statements that end their remote
+ * transaction (odbc_execute and the modification of foreign tables)
+ * disable autocommit, so that scans and planning never disconnect with
+ * a transaction open.
+ */
+static void
+odbcApplySessionProfile(SQLHDBC dbc, odbcFdwOptions *options)
 {
-	unsigned int table_size   = 0;
-	odbcFdwOptions options;
-
-	elog_debug("%s", __func__);
+	if (options->isolation_level &&
+	    !SQL_SUCCEEDED(SQLSetConnectAttr(dbc, SQL_ATTR_TXN_ISOLATION,
+	                                     (SQLPOINTER) isolation_level_from_name(options->isolation_level), 0)))
+		elog(DEBUG1, "The ODBC driver doesn't support isolation level %s", options->isolation_level);
+	if (!is_blank_string(options->init_sql))
+		odbcExecuteInitSql(dbc, options->init_sql);
+}
 
-	/* Fetch the foreign table options */
-	odbcGetTableOptions(foreigntableid, &options);
+/*
+ * Timeout of the remote statements in seconds: the query_timeout option
+ * or, if not defined, the local statement_timeout, so that statements
+ * abandoned by a timeout don't keep running remotely
+ */
+static void
+odbcSetQueryTimeout(SQLHSTMT stmt, odbcFdwOptions *options)
+{
+	SQLULEN timeout = 0;
 
-	odbcGetTableSize(&options, &table_size);
+	if (options->query_timeout > 0)
+		timeout = options->query_timeout;
+	else if (StatementTimeout > 0)
+		timeout = (StatementTimeout + 999) / 1000;
 
-	baserel->rows = table_size;
-	baserel->tuples = baserel->rows;
+	if (timeout > 0 &&
+	    !SQL_SUCCEEDED(SQLSetStmtAttr(stmt, SQL_ATTR_QUERY_TIMEOUT, (SQLPOINTER) timeout, 0)))
+		elog(DEBUG1, "The ODBC driver doesn't support query timeouts");
 }
 
-static void odbcEstimateCosts(PlannerInfo *root, RelOptInfo *baserel, Cost *startup_cost, Cost *total_cost, Oid foreigntableid)
+/*
+ * Statements that may be running remotely, which are cancelled
+ * if the (sub)transaction that executes them is aborted
+ */
+typedef struct odbcActiveStatement
 {
-	unsigned int table_size   = 0;
-	odbcFdwOptions options;
-
-	elog_debug("----> starting %s", __func__);
-
-	/* Fetch the foreign table options */
-	odbcGetTableOptions(foreigntableid, &options);
+	SQLHSTMT stmt;
+	SubTransactionId subid;
+	Oid serverid;
+} odbcActiveStatement;
 
-	odbcGetTableSize(&options, &table_size);
+static List *ActiveStatements = NIL;
 
-	*startup_cost = 25;
+static void
+odbcRegisterActiveStatement(SQLHSTMT stmt, odbcFdwOptions *options)
+{
+	MemoryContext oldcontext = MemoryContextSwitchTo(TopMemoryContext);
+	odbcActiveStatement *active = (odbcActiveStatement *) palloc(sizeof(odbcActiveStatement));
+
+	active->stmt = stmt;
+	active->subid = GetCurrentSubTransactionId();
+	active->serverid = options->serverid;
+	ActiveStatements = lappend(ActiveStatements, active);
+	MemoryContextSwitchTo(oldcontext);
+}
 
-	*total_cost = baserel->rows + *startup_cost;
+static void
+odbcUnregisterActiveStatement(SQLHSTMT stmt)
+{
+	ListCell *lc;
 
-	elog_debug("----> finishing %s", __func__);
+	foreach(lc, ActiveStatements)
+	{
+		odbcActiveStatement *active = (odbcActiveStatement *) lfirst(lc);
 
+		if (active->stmt == stmt)
+		{
+			ActiveStatements = list_delete_ptr(ActiveStatements, active);
+			pfree(active);
+			return;
+		}
+	}
 }
 
-static void odbcGetForeignPaths(PlannerInfo *root, RelOptInfo *baserel, Oid foreigntableid)
+/*
+ * Cancel the active statements of the subtransaction subid,
+ * or all of them if it is InvalidSubTransactionId; they are
+ * counted as errors of their servers
+ */
+static void
+odbcCancelActiveStatements(SubTransactionId subid)
 {
-	Cost startup_cost;
-	Cost total_cost;
-
-	elog_debug("----> starting %s", __func__);
-
-	odbcEstimateCosts(root, baserel, &startup_cost, &total_cost, foreigntableid);
+	List *remaining = NIL;
+	ListCell *lc;
+	MemoryContext oldcontext = MemoryContextSwitchTo(TopMemoryContext);
 
-	add_path(baserel,
-	         (Path *) create_foreignscan_path(root, baserel,
-#if PG_VERSION_NUM >= 90600
-	                 NULL, /* PathTarget */
-#endif
-	                 baserel->rows,
-	                 startup_cost,
-	                 total_cost,
-	                 NIL, /* no pathkeys */
-	                 NULL, /* no outer rel either */
-	                 NULL, /* no extra plan */
-	                 NIL /* no fdw_private list */));
+	foreach(lc, ActiveStatements)
+	{
+		odbcActiveStatement *active = (odbcActiveStatement *) lfirst(lc);
 
-	elog_debug("----> finishing %s", __func__);
+		if (subid == InvalidSubTransactionId || active->subid == subid)
+		{
+			elog_debug("Cancelling remote statement");
+			SQLCancel(active->stmt);
+			odbcStatsCountError(active->serverid);
+			pfree(active);
+		}
+		else
+			remaining = lappend(remaining, active);
+	}
+	list_free(ActiveStatements);
+	ActiveStatements = remaining;
+	MemoryContextSwitchTo(oldcontext);
 }
 
-static bool odbcAnalyzeForeignTable(Relation relation, AcquireSampleRowsFunc *func, BlockNumber *totalpages)
+static void
+odbcXactCallback(XactEvent event, void *arg)
 {
-	elog_debug("----> starting %s", __func__);
-	elog_debug("----> finishing %s", __func__);
-
-	return false;
+	switch (event)
+	{
+		case XACT_EVENT_ABORT:
+		case XACT_EVENT_PARALLEL_ABORT:
+			odbcCancelActiveStatements(InvalidSubTransactionId);
+			odbcResetRemoteEstimates();
+			break;
+		case XACT_EVENT_COMMIT:
+		case XACT_EVENT_PARALLEL_COMMIT:
+		case XACT_EVENT_PREPARE:
+			odbcResetRemoteEstimates();
+			break;
+		default:
+			break;
+	}
 }
 
-static ForeignScan* odbcGetForeignPlan(PlannerInfo *root, RelOptInfo *baserel,
-                                       Oid foreigntableid, ForeignPath *best_path, List *tlist, List *scan_clauses, Plan *outer_plan)
+static void
+odbcSubXactCallback(SubXactEvent event, SubTransactionId mySubid,
+                    SubTransactionId parentSubid, void *arg)
 {
-	Index scan_relid = baserel->relid;
-	elog_debug("----> starting %s", __func__);
-
-	scan_clauses = extract_actual_clauses(scan_clauses, false);
+	ListCell *lc;
 
-	elog_debug("----> finishing %s", __func__);
+	switch (event)
+	{
+		case SUBXACT_EVENT_ABORT_SUB:
+			odbcCancelActiveStatements(mySubid);
+			break;
+		case SUBXACT_EVENT_COMMIT_SUB:
+			/* Statements of a committed subtransaction now belong to its parent */
+			foreach(lc, ActiveStatements)
+			{
+				odbcActiveStatement *active = (odbcActiveStatement *) lfirst(lc);
 
-	return make_foreignscan(tlist, scan_clauses,
-	                        scan_relid, NIL, NIL,
-	                        NIL /* fdw_scan_tlist */, NIL, /* fdw_recheck_quals */
-	                        NULL /* outer_plan */ );
+				if (active->subid == mySubid)
+					active->subid = parentSubid;
+			}
+			break;
+		default:
+			break;
+	}
 }
 
 /*
- * odbcBeginForeignScan
- *
+ * Validate function
  */
-static void
-odbcBeginForeignScan(ForeignScanState *node, int eflags)
+Datum
+odbc_fdw_validator(PG_FUNCTION_ARGS)
 {
-	SQLHENV env;
-	SQLHDBC dbc;
-	odbcFdwExecutionState   *festate;
-	SQLSMALLINT result_columns;
-	SQLHSTMT stmt;
-	SQLRETURN ret;
-
-#ifdef DEBUG
-	char dsn[256];
-	char desc[256];
-	SQLSMALLINT dsn_ret;
-	SQLSMALLINT desc_ret;
-	SQLUSMALLINT direction;
-#endif
-
-	odbcFdwOptions options;
-
-	Relation rel;
-	int num_of_columns;
-	StringInfoData *columns;
-	int i;
-	ListCell *col_mapping;
-	StringInfoData sql;
-	StringInfoData col_str;
-	StringInfoData name_qualifier_char;
-	StringInfoData quote_char;
-
-	char *qual_key         = NULL;
-	char *qual_value       = NULL;
-	bool pushdown          = false;
-
-	const char* schema_name;
-	int encoding = -1;
+	List  *options_list = untransformRelOptions(PG_GETARG_DATUM(0));
+	Oid   catalog = PG_GETARG_OID(1);
+	char  *svr_schema   = NULL;
+	char  *svr_table    = NULL;
+	char  *svr_prefix   = NULL;
+	char  *sql_query    = NULL;
+	char  *sql_count    = NULL;
+	ListCell *cell;
 
 	elog_debug("%s", __func__);
 
-	/* Fetch the foreign table options */
-	odbcGetTableOptions(RelationGetRelid(node->ss.ss_currentRelation), &options);
-
-	schema_name = get_schema_name(&options);
-
-	odbc_connection(&options, &env, &dbc);
+	/*
+	 * Check that the necessary options: address, port, database
+	 */
+	foreach(cell, options_list)
+	{
+		DefElem    *def = (DefElem *) lfirst(cell);
 
-	/* Get quote char */
-	getQuoteChar(dbc, &quote_char);
+		/* Complain invalid options */
+		if (!odbcIsValidOption(def->defname, catalog))
+		{
+			struct odbcFdwOption *opt;
+			StringInfoData buf;
 
-	/* Get name qualifier char */
-	getNameQualifierChar(dbc, &name_qualifier_char);
+			/*
+			 * Unknown option specified, complain about it. Provide a hint
+			 * with list of valid options for the object.
+			 */
+			initStringInfo(&buf);
+			for (opt = valid_options; opt->optname; opt++)
+			{
+				if (catalog == opt->optcontext)
+					appendStringInfo(&buf, "%s%s", (buf.len > 0) ? ", " : "",
+					                 opt->optname);
+			}
 
-	if (!is_blank_string(options.encoding))
-	{
-		encoding = pg_char_to_encoding(options.encoding);
-		if (encoding < 0)
-		{
 			ereport(ERROR,
-			        (errcode(ERRCODE_FDW_INVALID_ATTRIBUTE_VALUE),
-			         errmsg("invalid encoding name \"%s\"", options.encoding)
+			        (errcode(ERRCODE_FDW_INVALID_OPTION_NAME),
+			         errmsg("invalid option \"%s\"", def->defname),
+			         errhint("Valid options in this context are: %s", buf.len ? buf.data : "<none>")
 			        ));
 		}
-	}
 
-	/* Fetch the table column info */
-	rel = heap_open(RelationGetRelid(node->ss.ss_currentRelation), AccessShareLock);
-	num_of_columns = rel->rd_att->natts;
-	columns = (StringInfoData *) palloc(sizeof(StringInfoData) * num_of_columns);
-	initStringInfo(&col_str);
-	for (i = 0; i < num_of_columns; i++)
-	{
-		StringInfoData col;
-		StringInfoData mapping;
-		bool    mapped;
+		/* TODO: detect redundant connection attributes and missing required attributs (dsn or driver)
+		 * Complain about redundent options
+		 */
+		if (strcmp(def->defname, "schema") == 0)
+		{
+			if (!is_blank_string(svr_schema))
+				ereport(ERROR,
+				        (errcode(ERRCODE_SYNTAX_ERROR),
+				         errmsg("conflicting or redundant options: schema (%s)", defGetString(def))
+				        ));
 
-		/* retrieve the column name */
-		initStringInfo(&col);
-		appendStringInfo(&col, "%s", NameStr(TupleDescAttr(rel->rd_att,i)->attname));
-		mapped = false;
+			svr_schema = defGetString(def);
+		}
+		else if (strcmp(def->defname, "table") == 0)
+		{
+			if (!is_blank_string(svr_table))
+				ereport(ERROR,
+				        (errcode(ERRCODE_SYNTAX_ERROR),
+				         errmsg("conflicting or redundant options: table (%s)", defGetString(def))
+				        ));
 
-		/* check if the column name is mapping to a different name in remote table */
-		foreach(col_mapping, options.mapping_list)
+			svr_table = defGetString(def);
+		}
+		else if (strcmp(def->defname, "prefix") == 0)
 		{
-			DefElem *def = (DefElem *) lfirst(col_mapping);
-			if (strcmp(def->defname, col.data) == 0)
-			{
-				initStringInfo(&mapping);
-				appendStringInfo(&mapping, "%s", defGetString(def));
-				mapped = true;
-				break;
-			}
+			if (!is_blank_string(svr_prefix))
+				ereport(ERROR,
+				        (errcode(ERRCODE_SYNTAX_ERROR),
+				         errmsg("conflicting or redundant options: prefix (%s)", defGetString(def))
+				        ));
+
+			svr_prefix = defGetString(def);
 		}
+		else if (strcmp(def->defname, "sql_query") == 0)
+		{
+			if (sql_query)
+				ereport(ERROR,
+				        (errcode(ERRCODE_SYNTAX_ERROR),
+				         errmsg("conflicting or redundant options: sql_query (%s)", defGetString(def))
+				        ));
 
-		/* decide which name is going to be used */
-		if (mapped)
-			columns[i] = mapping;
-		else
-			columns[i] = col;
-		appendStringInfo(&col_str, i == 0 ? "%s%s%s" : ",%s%s%s", (char *) quote_char.data, columns[i].data, (char *) quote_char.data);
-	}
-	heap_close(rel, NoLock);
+			sql_query = defGetString(def);
+		}
+		else if (strcmp(def->defname, "sql_count") == 0)
+		{
+			if (!is_blank_string(sql_count))
+				ereport(ERROR,
+				        (errcode(ERRCODE_SYNTAX_ERROR),
+				         errmsg("conflicting or redundant options: sql_count (%s)", defGetString(def))
+				        ));
 
-	/* See if we've got a qual we can push down */
-	if (node->ss.ps.plan->qual)
-	{
-#if PG_VERSION_NUM >= 100000
-		ExprState  *state = node->ss.ps.qual;
-		odbcGetQual((Node *) state->expr, node->ss.ss_currentRelation->rd_att, options.mapping_list, &qual_key, &qual_value, &pushdown);
-#else
-		ListCell    *lc;
-		foreach (lc, node->ss.ps.qual)
+			sql_count = defGetString(def);
+		}
+		else if (strcmp(def->defname, "batch_size") == 0 || strcmp(def->defname, "commit_interval") == 0 ||
+		         strcmp(def->defname, "query_timeout") == 0 || strcmp(def->defname, "connect_timeout") == 0 ||
+		         strcmp(def->defname, "packet_size") == 0)
 		{
-			/* Only the first qual can be pushed down to remote DBMS */
-			ExprState  *state = lfirst(lc);
-			odbcGetQual((Node *) state->expr, node->ss.ss_currentRelation->rd_att, options.mapping_list, &qual_key, &qual_value, &pushdown);
-			if (pushdown)
-				break;
+			(void) option_int_value(def);
 		}
-#endif
-	}
-
-	/* Construct the SQL statement used for remote querying */
-	initStringInfo(&sql);
-	if (!is_blank_string(options.sql_query))
-	{
-		/* Use custom query if it's available */
-		appendStringInfo(&sql, "%s", options.sql_query);
-	}
-	else
-	{
-		/* Get options.table */
-		if (is_blank_string(schema_name))
+		else if (strcmp(def->defname, "fdw_startup_cost") == 0 || strcmp(def->defname, "fdw_tuple_cost") == 0 ||
+		         strcmp(def->defname, "fdw_byte_cost") == 0)
 		{
-			appendStringInfo(&sql, "SELECT %s FROM %s%s%s", col_str.data,
-			                 (char *) quote_char.data, options.table, (char *) quote_char.data);
+			(void) option_cost_value(def->defname, defGetString(def), 0);
 		}
-		else
+		else if (strcmp(def->defname, "size_estimate_mode") == 0)
 		{
-			appendStringInfo(&sql, "SELECT %s FROM %s%s%s%s%s%s%s", col_str.data,
-			                 (char *) quote_char.data, schema_name, (char *) quote_char.data,
-			                 (char *) name_qualifier_char.data,
-			                 (char *) quote_char.data, options.table, (char *) quote_char.data);
+			(void) size_estimate_mode_from_name(defGetString(def));
 		}
-		if (pushdown)
+		else if (strcmp(def->defname, "cursor_mode") == 0)
+		{
+			(void) cursor_mode_from_name(defGetString(def));
+		}
+		else if (strcmp(def->defname, "key") == 0 || strcmp(def->defname, "read_only") == 0 ||
+		         strcmp(def->defname, "autocommit") == 0 || strcmp(def->defname, "use_remote_estimate") == 0)
+		{
+			(void) defGetBoolean(def);
+		}
+		else if (strcmp(def->defname, "isolation_level") == 0)
 		{
-			appendStringInfo(&sql, " WHERE %s%s%s = '%s'",
-			                 (char *) quote_char.data, qual_key, (char *) quote_char.data, qual_value);
+			(void) isolation_level_from_name(defGetString(def));
 		}
 	}
 
-	/* Allocate a statement handle */
-	SQLAllocHandle(SQL_HANDLE_STMT, dbc, &stmt);
-
-	elog_debug("Executing query: %s", sql.data);
-
-	/* Retrieve a list of rows */
-	ret = SQLExecDirect(stmt, (SQLCHAR *) sql.data, SQL_NTS);
-	check_return(ret, "Executing ODBC query", stmt, SQL_HANDLE_STMT);
-	SQLNumResultCols(stmt, &result_columns);
-
-	festate = (odbcFdwExecutionState *) palloc(sizeof(odbcFdwExecutionState));
-	festate->attinmeta = TupleDescGetAttInMetadata(node->ss.ss_currentRelation->rd_att);
-	copy_odbcFdwOptions(&(festate->options), &options);
-	festate->stmt = stmt;
-	festate->table_columns = columns;
-	festate->num_of_table_cols = num_of_columns;
-	/* prepare for the first iteration, there will be some precalculation needed in the first iteration*/
-	festate->first_iteration = true;
-	festate->encoding = encoding;
-	node->fdw_state = (void *) festate;
+	PG_RETURN_VOID();
 }
 
 /*
- * odbcIterateForeignScan
- *
+ * Map ODBC data types to PostgreSQL
  */
-static TupleTableSlot *
-odbcIterateForeignScan(ForeignScanState *node)
+static void
+sql_data_type(
+    SQLSMALLINT odbc_data_type,
+    SQLULEN     column_size,
+    SQLSMALLINT decimal_digits,
+    SQLSMALLINT nullable,
+    StringInfo sql_type
+)
 {
-	EState *executor_state = node->ss.ps.state;
-	MemoryContext prev_context;
-	/* ODBC API return status */
-	SQLRETURN ret;
-	odbcFdwExecutionState *festate = (odbcFdwExecutionState *) node->fdw_state;
-	TupleTableSlot *slot = node->ss.ss_ScanTupleSlot;
-	SQLSMALLINT columns;
-	char    **values;
-	HeapTuple   tuple;
-	StringInfoData  col_data;
-	SQLHSTMT stmt = festate->stmt;
-	bool first_iteration = festate->first_iteration;
-	int num_of_table_cols = festate->num_of_table_cols;
-	int num_of_result_cols;
-	StringInfoData  *table_columns = festate->table_columns;
-	List *col_position_mask = NIL;
-	List *col_size_array = NIL;
-	List *col_conversion_array = NIL;
-
-	elog_debug("%s", __func__);
-
-	ret = SQLFetch(stmt);
-
-	SQLNumResultCols(stmt, &columns);
-
-	/*
-	 * If this is the first iteration,
-	 * we need to calculate the mask for column mapping as well as the column size
-	 */
-	if (first_iteration == true)
+	initStringInfo(sql_type);
+	switch(odbc_data_type)
 	{
-		SQLCHAR *ColumnName;
-		SQLSMALLINT NameLengthPtr;
-		SQLSMALLINT DataTypePtr;
-		SQLULEN     ColumnSizePtr;
-		SQLSMALLINT DecimalDigitsPtr;
-		SQLSMALLINT NullablePtr;
-		int i;
-		int k;
-		bool found;
-
-		StringInfoData sql_type;
-
-		/* Allocate memory for the masks in a memory context that
-		   persists between IterateForeignScan calls */
-		prev_context = MemoryContextSwitchTo(executor_state->es_query_cxt);
-		col_position_mask = NIL;
-		col_size_array = NIL;
-		col_conversion_array = NIL;
-		num_of_result_cols = columns;
-		/* Obtain the column information of the first row. */
-		for (i = 1; i <= columns; i++)
+	case SQL_CHAR:
+	case SQL_WCHAR :
+		appendStringInfo(sql_type, "char(%u)", (unsigned)column_size);
+		break;
+	case SQL_VARCHAR :
+	case SQL_WVARCHAR :
+		if (column_size <= 255)
 		{
-			ColumnConversion conversion = TEXT_CONVERSION;
-			found = false;
-			ColumnName = (SQLCHAR *) palloc(sizeof(SQLCHAR) * MAXIMUM_COLUMN_NAME_LEN);
-			SQLDescribeCol(stmt,
-			               i,                       /* ColumnName */
-			               ColumnName,
-			               sizeof(SQLCHAR) * MAXIMUM_COLUMN_NAME_LEN, /* BufferLength */
-			               &NameLengthPtr,
-			               &DataTypePtr,
-			               &ColumnSizePtr,
-			               &DecimalDigitsPtr,
-			               &NullablePtr);
-
-			sql_data_type(DataTypePtr, ColumnSizePtr, DecimalDigitsPtr, NullablePtr, &sql_type);
-			if (strcmp("bytea", (char*)sql_type.data) == 0)
-			{
-				conversion = HEX_CONVERSION;
-			}
-			if (strcmp("boolean", (char*)sql_type.data) == 0)
-			{
-				conversion = BOOL_CONVERSION;
-			}
-			else if (strncmp("bit(",(char*)sql_type.data,4)==0 || strncmp("varbit(",(char*)sql_type.data,7)==0)
-			{
-				conversion = BIN_CONVERSION;
-			}
-
-			/* Get the position of the column in the FDW table */
-			for (k=0; k<num_of_table_cols; k++)
-			{
-				if (strcmp(table_columns[k].data, (char *) ColumnName) == 0)
-				{
-					SQLULEN min_size = minimum_buffer_size(DataTypePtr);
-					SQLULEN max_size = MAXIMUM_BUFFER_SIZE;
-					found = true;
-					col_position_mask = lappend_int(col_position_mask, k);
-					if (ColumnSizePtr < min_size)
-						ColumnSizePtr = min_size;
-					if (ColumnSizePtr > max_size)
-						ColumnSizePtr = max_size;
-
-					col_size_array = lappend_int(col_size_array, (int) ColumnSizePtr);
-					col_conversion_array = lappend_int(col_conversion_array, (int) conversion);
-					break;
-				}
-			}
-			/* if current column is not used by the foreign table */
-			if (!found)
-			{
-				col_position_mask = lappend_int(col_position_mask, -1);
-				col_size_array = lappend_int(col_size_array, -1);
-				col_conversion_array = lappend_int(col_conversion_array, 0);
-			}
-			pfree(ColumnName);
+			appendStringInfo(sql_type, "varchar(%u)", (unsigned)column_size);
 		}
-		festate->num_of_result_cols = num_of_result_cols;
-		festate->col_position_mask = col_position_mask;
-		festate->col_size_array = col_size_array;
-		festate->col_conversion_array = col_conversion_array;
-		festate->first_iteration = false;
-
-		MemoryContextSwitchTo(prev_context);
-	}
-	else
-	{
-		num_of_result_cols = festate->num_of_result_cols;
-		col_position_mask = festate->col_position_mask;
-		col_size_array = festate->col_size_array;
-		col_conversion_array = festate->col_conversion_array;
+		else
+		{
+			appendStringInfo(sql_type, "text");
+		}
+		break;
+	case SQL_LONGVARCHAR :
+	case SQL_WLONGVARCHAR :
+		appendStringInfo(sql_type, "text");
+		break;
+	case SQL_DECIMAL :
+		appendStringInfo(sql_type, "decimal(%u,%d)", (unsigned)column_size, decimal_digits);
+		break;
+	case SQL_NUMERIC :
+		appendStringInfo(sql_type, "numeric(%u,%d)", (unsigned)column_size, decimal_digits);
+		break;
+	case SQL_INTEGER :
+		appendStringInfo(sql_type, "integer");
+		break;
+	case SQL_REAL :
+		appendStringInfo(sql_type, "real");
+		break;
+	case SQL_FLOAT :
+		appendStringInfo(sql_type, "real");
+		break;
+	case SQL_DOUBLE :
+		appendStringInfo(sql_type, "float8");
+		break;
+	case SQL_BIT :
+		/* Use boolean instead of bit(1) because:
+		 * * binary types are not yet fully supported
+		 * * boolean is more commonly used in PG
+		 * * With options BoolsAsChar=0 this allows
+		 *   preserving boolean columns from pSQL ODBC.
+		 */
+		appendStringInfo(sql_type, "boolean");
+		break;
+	case SQL_SMALLINT :
+	case SQL_TINYINT :
+		appendStringInfo(sql_type, "smallint");
+		break;
+	case SQL_BIGINT :
+		appendStringInfo(sql_type, "bigint");
+		break;
+	/*
+	 * TODO: Implement these cases properly. See #23
+	 *
+	case SQL_BINARY :
+		appendStringInfo(sql_type, "bit(%u)", (unsigned)column_size);
+		break;
+	case SQL_VARBINARY :
+		appendStringInfo(sql_type, "varbit(%u)", (unsigned)column_size);
+		break;
+	*/
+	case SQL_LONGVARBINARY :
+		appendStringInfo(sql_type, "bytea");
+		break;
+	case SQL_TYPE_DATE :
+	case SQL_DATE :
+		appendStringInfo(sql_type, "date");
+		break;
+	case SQL_TYPE_TIME :
+	case SQL_TIME :
+		appendStringInfo(sql_type, "time");
+		break;
+	case SQL_TYPE_TIMESTAMP :
+	case SQL_TIMESTAMP :
+		appendStringInfo(sql_type, "timestamp");
+		break;
+	case SQL_GUID :
+		appendStringInfo(sql_type, "uuid");
+		break;
+	};
+}
+
+static SQLULEN
+minimum_buffer_size(SQLSMALLINT odbc_data_type)
+{
+	switch(odbc_data_type)
+	{
+	case SQL_DECIMAL :
+	case SQL_NUMERIC :
+		return 32;
+	case SQL_INTEGER :
+		return 12;
+	case SQL_REAL :
+	case SQL_FLOAT :
+		return 18;
+	case SQL_DOUBLE :
+		return 26;
+	case SQL_SMALLINT :
+	case SQL_TINYINT :
+		return 6;
+	case SQL_BIGINT :
+		return 21;
+	case SQL_TYPE_DATE :
+	case SQL_DATE :
+		return 10;
+	case SQL_TYPE_TIME :
+	case SQL_TIME :
+		return 8;
+	case SQL_TYPE_TIMESTAMP :
+	case SQL_TIMESTAMP :
+		return 20;
+	default :
+		return 0;
+	};
+}
+
+/*
+ * Fetch the options for a server and options list
+ */
+static void
+odbcGetOptions(Oid server_oid, List *add_options, odbcFdwOptions *extracted_options)
+{
+	ForeignServer   *server;
+	UserMapping     *mapping;
+	List            *options;
+
+	elog_debug("%s", __func__);
+
+	server  = GetForeignServer(server_oid);
+	mapping = GetUserMapping(GetUserId(), server_oid);
+
+	options = NIL;
+	options = list_concat(options, add_options);
+	options = list_concat(options, server->options);
+	options = list_concat(options, mapping->options);
+
+	extract_odbcFdwOptions(options, extracted_options);
+	extracted_options->serverid = server_oid;
+}
+
+/*
+ * Fetch the options for a odbc_fdw foreign table.
+ */
+static void
+odbcGetTableOptions(Oid foreigntableid, odbcFdwOptions *extracted_options)
+{
+	ForeignTable    *table;
+
+	elog_debug("%s", __func__);
+
+	table = GetForeignTable(foreigntableid);
+	odbcGetOptions(table->serverid, table->options, extracted_options);
+}
+
+static void
+check_return(SQLRETURN ret, char *msg, SQLHANDLE handle, SQLSMALLINT type)
+{
+	int err_code = ERRCODE_SYSTEM_ERROR;
+
+#ifdef DEBUG
+	SQLINTEGER   i = 0;
+	SQLINTEGER   native;
+	SQLCHAR  state[ 7 ];
+	SQLCHAR  text[256];
+	SQLSMALLINT  len;
+	SQLRETURN    diag_ret;
+	if (SQL_SUCCEEDED(ret))
+		elog(DEBUG1, "Successful result: %s", msg);
+#endif
+
+	if (!SQL_SUCCEEDED(ret))
+	{
+#ifdef DEBUG
+		elog(DEBUG1, "Error result (%d): %s", ret, msg);
+		if (handle)
+		{
+			do
+			{
+				diag_ret = SQLGetDiagRec(type, handle, ++i, state, &native, text,
+				                         sizeof(text), &len );
+				if (SQL_SUCCEEDED(diag_ret))
+					elog(DEBUG1, " %s:%ld:%ld:%s\n", state, (long int) i, (long int) native, text);
+			}
+			while( diag_ret == SQL_SUCCESS );
+		}
+#endif
+		ereport(ERROR, (errcode(err_code), errmsg("%s", msg)));
+	}
+}
+
+/*
+ * Get name qualifier char
+ */
+static void
+getNameQualifierChar(SQLHDBC dbc, StringInfoData *nq_char)
+{
+	SQLCHAR name_qualifier_char[2];
+
+	elog_debug("%s", __func__);
+
+	SQLGetInfo(dbc,
+	           SQL_CATALOG_NAME_SEPARATOR,
+	           (SQLPOINTER)&name_qualifier_char,
+	           2,
+	           NULL);
+	name_qualifier_char[1] = 0; // some drivers fail to copy the trailing zero
+
+	initStringInfo(nq_char);
+	appendStringInfo(nq_char, "%s", (char *) name_qualifier_char);
+}
+
+/*
+ * Get quote cahr
+ */
+static void
+getQuoteChar(SQLHDBC dbc, StringInfoData *q_char)
+{
+	SQLCHAR quote_char[2];
+
+	elog_debug("%s", __func__);
+
+	SQLGetInfo(dbc,
+	           SQL_IDENTIFIER_QUOTE_CHAR,
+	           (SQLPOINTER)&quote_char,
+	           2,
+	           NULL);
+	quote_char[1] = 0; // some drivers fail to copy the trailing zero
+
+	initStringInfo(q_char);
+	appendStringInfo(q_char, "%s", (char *) quote_char);
+}
+
+/*
+ * Identifier quote and name qualifier characters of the servers,
+ * remembered so that remote queries can be built while planning
+ * without connecting again
+ */
+typedef struct odbcServerQuoting
+{
+	Oid  serverid;
+	char quote_char[8];
+	char name_qualifier_char[8];
+} odbcServerQuoting;
+
+static HTAB *ServerQuotingCache = NULL;
+
+/*
+ * Quoting characters of a server, obtained from dbc (or from a new
+ * connection if dbc is NULL) the first time; either output may be NULL
+ */
+static void
+odbcGetServerQuoting(Oid serverid, odbcFdwOptions *options, SQLHDBC dbc,
+                     StringInfoData *quote_char, StringInfoData *name_qualifier_char)
+{
+	odbcServerQuoting *entry;
+	bool found;
+
+	if (ServerQuotingCache == NULL)
+	{
+		HASHCTL ctl;
+
+		memset(&ctl, 0, sizeof(ctl));
+		ctl.keysize = sizeof(Oid);
+		ctl.entrysize = sizeof(odbcServerQuoting);
+		ctl.hcxt = TopMemoryContext;
+		ServerQuotingCache = hash_create("odbc_fdw server quoting", 8, &ctl,
+		                                 HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+	}
+
+	entry = (odbcServerQuoting *) hash_search(ServerQuotingCache, &serverid, HASH_FIND, NULL);
+	if (entry == NULL)
+	{
+		SQLHENV env = NULL;
+		SQLHDBC conn = dbc;
+		StringInfoData q_char;
+		StringInfoData nq_char;
+
+		if (conn == NULL)
+			odbc_connection(options, &env, &conn);
+		getQuoteChar(conn, &q_char);
+		getNameQualifierChar(conn, &nq_char);
+		if (dbc == NULL)
+		{
+			odbcFreeHandle(SQL_HANDLE_DBC, conn);
+			odbcFreeHandle(SQL_HANDLE_ENV, env);
+		}
+
+		entry = (odbcServerQuoting *) hash_search(ServerQuotingCache, &serverid, HASH_ENTER, &found);
+		strlcpy(entry->quote_char, q_char.data, sizeof(entry->quote_char));
+		strlcpy(entry->name_qualifier_char, nq_char.data, sizeof(entry->name_qualifier_char));
+	}
+
+	if (quote_char)
+	{
+		initStringInfo(quote_char);
+		appendStringInfoString(quote_char, entry->quote_char);
+	}
+	if (name_qualifier_char)
+	{
+		initStringInfo(name_qualifier_char);
+		appendStringInfoString(name_qualifier_char, entry->name_qualifier_char);
+	}
+}
+
+static bool appendConnAttribute(bool sep, StringInfoData *conn_str, const char* name, const char* value)
+{
+	static const char *sep_str = ";";
+	if (!is_blank_string(value))
+	{
+		if (sep)
+			appendStringInfoString(conn_str, sep_str);
+		appendStringInfo(conn_str, "%s=%s", name, value);
+		sep = true;
+	}
+	return sep;
+}
+
+/*
+ * Connection attributes defined by the options
+ */
+static bool appendConnAttributes(StringInfoData *conn_str, odbcFdwOptions* options)
+{
+	bool sep = false;
+	ListCell *lc;
+
+	foreach(lc, options->connection_list)
+	{
+		DefElem *def = (DefElem *) lfirst(lc);
+		sep = appendConnAttribute(sep, conn_str, get_odbc_attribute_name(def->defname), defGetString(def));
+	}
+	return sep;
+}
+
+static void odbcConnStr(StringInfoData *conn_str, odbcFdwOptions* options)
+{
+	bool sep;
+
+	initStringInfo(conn_str);
+	sep = appendConnAttributes(conn_str, options);
+
+	/*
+	 * Drivers that read the whole result set before returning the first
+	 * row unless told otherwise by a connection attribute
+	 */
+	if (get_cursor_mode(options) == CURSOR_MODE_STREAMING)
+	{
+		switch (odbcDriverDialect(options))
+		{
+			case ODBC_DIALECT_POSTGRESQL:
+				/* psqlODBC: fetch through a server-side cursor */
+				if (odbcConnAttribute(options, "UseDeclareFetch") == NULL)
+				{
+					char fetch[32];
+
+					snprintf(fetch, sizeof(fetch), "%d", DEFAULT_FETCH_SIZE);
+					sep = appendConnAttribute(sep, conn_str, "UseDeclareFetch", "1");
+					if (odbcConnAttribute(options, "Fetch") == NULL)
+						sep = appendConnAttribute(sep, conn_str, "Fetch", fetch);
+				}
+				break;
+			case ODBC_DIALECT_MYSQL:
+				/* MySQL Connector/ODBC: don't cache forward-only result sets */
+				if (odbcConnAttribute(options, "NO_CACHE") == NULL)
+					sep = appendConnAttribute(sep, conn_str, "NO_CACHE", "1");
+				break;
+			default:
+				break;
+		}
+	}
+	elog_debug("CONN STR: %s", conn_str->data);
+}
+
+/*
+ * Remote database dialects, for the few statements
+ * that cannot be expressed in standard SQL
+ */
+static odbcDialect
+dialect_from_name(const char *name)
+{
+	char *lower_name = pstrdup(name);
+	odbcDialect dialect = ODBC_DIALECT_GENERIC;
+	int i;
+
+	for (i = 0; lower_name[i]; i++)
+		lower_name[i] = pg_tolower((unsigned char) lower_name[i]);
+
+	if (strstr(lower_name, "postgres") || strstr(lower_name, "psql"))
+		dialect = ODBC_DIALECT_POSTGRESQL;
+	else if (strstr(lower_name, "sql server"))
+		dialect = ODBC_DIALECT_SQLSERVER;
+	else if (strstr(lower_name, "mysql") || strstr(lower_name, "mariadb"))
+		dialect = ODBC_DIALECT_MYSQL;
+	else if (strstr(lower_name, "hive"))
+		dialect = ODBC_DIALECT_HIVE;
+	pfree(lower_name);
+	return dialect;
+}
+
+static odbcDialect
+odbcGetDialect(SQLHDBC dbc)
+{
+	char dbms_name[256];
+	SQLSMALLINT len;
+
+	if (!SQL_SUCCEEDED(SQLGetInfo(dbc, SQL_DBMS_NAME, dbms_name, sizeof(dbms_name), &len)))
+		return ODBC_DIALECT_GENERIC;
+
+	elog_debug("%s: %s", __func__, dbms_name);
+
+	return dialect_from_name(dbms_name);
+}
+
+/*
+ * Value of an ODBC connection attribute defined by the options, or NULL
+ */
+static const char *
+odbcConnAttribute(odbcFdwOptions *options, const char *name)
+{
+	ListCell *lc;
+
+	foreach(lc, options->connection_list)
+	{
+		DefElem *def = (DefElem *) lfirst(lc);
+
+		if (pg_strcasecmp(get_odbc_attribute_name(def->defname), name) == 0)
+			return defGetString(def);
+	}
+	return NULL;
+}
+
+/*
+ * Dialect of the driver named by the options, known before connecting
+ */
+static odbcDialect
+odbcDriverDialect(odbcFdwOptions *options)
+{
+	const char *driver = odbcConnAttribute(options, "DRIVER");
+
+	return driver ? dialect_from_name(driver) : ODBC_DIALECT_GENERIC;
+}
+
+static CursorMode
+cursor_mode_from_name(const char *name)
+{
+	if (strcmp(name, "default") == 0)
+		return CURSOR_MODE_DEFAULT;
+	if (strcmp(name, "forward_only") == 0)
+		return CURSOR_MODE_FORWARD_ONLY;
+	if (strcmp(name, "streaming") == 0)
+		return CURSOR_MODE_STREAMING;
+	ereport(ERROR,
+	        (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+	         errmsg("invalid cursor mode \"%s\"", name),
+	         errhint("Valid modes are default, forward_only and streaming.")));
+	return CURSOR_MODE_DEFAULT; /* keep compiler quiet */
+}
+
+static CursorMode
+get_cursor_mode(odbcFdwOptions *options)
+{
+	return options->cursor_mode ? cursor_mode_from_name(options->cursor_mode) : CURSOR_MODE_DEFAULT;
+}
+
+/*
+ * Set the cursor attributes of a statement that reads a result set
+ */
+static void
+odbcSetCursorMode(SQLHSTMT stmt, odbcFdwOptions *options)
+{
+	if (get_cursor_mode(options) == CURSOR_MODE_DEFAULT)
+		return;
+	if (!SQL_SUCCEEDED(SQLSetStmtAttr(stmt, SQL_ATTR_CURSOR_TYPE, (SQLPOINTER) SQL_CURSOR_FORWARD_ONLY, 0)) ||
+	    !SQL_SUCCEEDED(SQLSetStmtAttr(stmt, SQL_ATTR_CONCURRENCY, (SQLPOINTER) SQL_CONCUR_READ_ONLY, 0)))
+		elog(DEBUG1, "The ODBC driver doesn't support forward-only read-only cursors");
+}
+
+static SizeEstimateMode
+size_estimate_mode_from_name(const char *name)
+{
+	if (strcmp(name, "auto") == 0)
+		return SIZE_ESTIMATE_AUTO;
+	if (strcmp(name, "exact") == 0)
+		return SIZE_ESTIMATE_EXACT;
+	if (strcmp(name, "quick") == 0)
+		return SIZE_ESTIMATE_QUICK;
+	if (strcmp(name, "catalog") == 0)
+		return SIZE_ESTIMATE_CATALOG;
+	ereport(ERROR,
+	        (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+	         errmsg("invalid size estimate mode \"%s\"", name),
+	         errhint("Valid modes are auto, exact, quick and catalog.")));
+	return SIZE_ESTIMATE_AUTO; /* keep compiler quiet */
+}
+
+/*
+ * Execute a query returning a single number
+ */
+static bool
+odbcQueryNumber(SQLHDBC dbc, const char *sql, int64 *number, bool errors)
+{
+	SQLHSTMT stmt;
+	SQLRETURN ret;
+	SQLBIGINT value;
+	SQLLEN indicator;
+	bool found = false;
+
+	elog_debug("Size query: %s", sql);
+
+	odbcAllocHandle(SQL_HANDLE_STMT, dbc, &stmt);
+	ret = odbcExecDirect(stmt, (SQLCHAR *) sql, SQL_NTS);
+	if (errors)
+		check_return(ret, "Executing ODBC query", stmt, SQL_HANDLE_STMT);
+	if (SQL_SUCCEEDED(ret) && SQL_SUCCEEDED(odbcFetch(stmt)))
+	{
+		ret = odbcGetData(stmt, 1, SQL_C_SBIGINT, &value, 0, &indicator);
+		if (SQL_SUCCEEDED(ret) && indicator != SQL_NULL_DATA)
+		{
+			*number = (int64) value;
+			found = true;
+		}
+	}
+	odbcFreeHandle(SQL_HANDLE_STMT, stmt);
+
+	return found;
+}
+
+/*
+ * Exact number of rows of a table or query, counted remotely
+ */
+static bool
+odbcCountRows(SQLHDBC dbc, odbcFdwOptions *options, int64 *size)
+{
+	StringInfoData  sql_str;
+	StringInfoData name_qualifier_char;
+	StringInfoData quote_char;
+	const char* schema_name = get_schema_name(options);
+
+	if (is_blank_string(options->sql_count))
+	{
+		/* Get quote char */
+		getQuoteChar(dbc, &quote_char);
+
+		/* Get name qualifier char */
+		getNameQualifierChar(dbc, &name_qualifier_char);
+
+		initStringInfo(&sql_str);
+		if (is_blank_string(options->sql_query))
+		{
+			if (is_blank_string(schema_name))
+			{
+				appendStringInfo(&sql_str, "SELECT COUNT(*) FROM %s%s%s",
+				                 quote_char.data, options->table, quote_char.data);
+			}
+			else
+			{
+				appendStringInfo(&sql_str, "SELECT COUNT(*) FROM %s%s%s%s%s%s%s",
+				                 quote_char.data, schema_name, quote_char.data,
+				                 name_qualifier_char.data,
+				                 quote_char.data, options->table, quote_char.data);
+			}
+		}
+		else
+		{
+			if (options->sql_query[strlen(options->sql_query)-1] == ';')
+			{
+				/* Remove trailing semicolon if present */
+				options->sql_query[strlen(options->sql_query)-1] = 0;
+			}
+			appendStringInfo(&sql_str, "SELECT COUNT(*) FROM (%s) AS _odbc_fwd_count_wrapped", options->sql_query);
+		}
+	}
+	else
+	{
+		initStringInfo(&sql_str);
+		appendStringInfo(&sql_str, "%s", options->sql_count);
+	}
+
+	return odbcQueryNumber(dbc, sql_str.data, size, true);
+}
+
+/*
+ * Number of rows of a table according to the system catalogs
+ * of the remote database, for the dialects we know about
+ */
+static bool
+odbcCatalogTableSize(SQLHDBC dbc, odbcFdwOptions *options, int64 *size)
+{
+	const char *schema_name = get_schema_name(options);
+	StringInfoData sql;
+
+	initStringInfo(&sql);
+	switch (odbcGetDialect(dbc))
+	{
+		case ODBC_DIALECT_POSTGRESQL:
+			appendStringInfoString(&sql, "SELECT CAST(c.reltuples AS bigint) FROM pg_catalog.pg_class c"
+			                       " JOIN pg_catalog.pg_namespace n ON n.oid = c.relnamespace WHERE c.relname = ");
+			appendQuotedString(&sql, options->table);
+			if (is_blank_string(schema_name))
+				appendStringInfoString(&sql, " AND pg_catalog.pg_table_is_visible(c.oid)");
+			else
+			{
+				appendStringInfoString(&sql, " AND n.nspname = ");
+				appendQuotedString(&sql, schema_name);
+			}
+			break;
+		case ODBC_DIALECT_SQLSERVER:
+		{
+			StringInfoData name;
+
+			initStringInfo(&name);
+			appendSQLServerName(&name, schema_name, options->table);
+			appendStringInfoString(&sql, "SELECT CAST(SUM(p.rows) AS bigint) FROM sys.partitions p"
+			                       " WHERE p.index_id IN (0, 1) AND p.object_id = OBJECT_ID(");
+			appendQuotedString(&sql, name.data);
+			appendStringInfoChar(&sql, ')');
+			break;
+		}
+		case ODBC_DIALECT_MYSQL:
+			appendStringInfoString(&sql, "SELECT table_rows FROM information_schema.tables WHERE table_name = ");
+			appendQuotedString(&sql, options->table);
+			if (is_blank_string(schema_name))
+				appendStringInfoString(&sql, " AND table_schema = DATABASE()");
+			else
+			{
+				appendStringInfoString(&sql, " AND table_schema = ");
+				appendQuotedString(&sql, schema_name);
+			}
+			break;
+		default:
+			return false;
+	}
+
+	return odbcQueryNumber(dbc, sql.data, size, false);
+}
+
+/*
+ * Number of rows of a table or query:
+ *   exact:   counted by the remote database (or with the sql_count query)
+ *   quick:   cardinality reported by SQLStatistics with SQL_QUICK
+ *   catalog: statistics of the system catalogs of the remote database
+ *   auto:    quick, catalog or exact, the first that works
+ * Only exact sizes are available for queries or if sql_count is defined.
+ * Returns false if the size could not be obtained.
+ */
+static bool
+odbcGetTableSizeOnConnection(SQLHDBC dbc, odbcFdwOptions* options, SizeEstimateMode mode, int64 *size)
+{
+	bool found = false;
+
+	if (!is_blank_string(options->sql_query) || !is_blank_string(options->sql_count))
+	{
+		if (mode == SIZE_ESTIMATE_AUTO || mode == SIZE_ESTIMATE_EXACT)
+			found = odbcCountRows(dbc, options, size);
+	}
+	else
+	{
+		if (mode == SIZE_ESTIMATE_AUTO || mode == SIZE_ESTIMATE_QUICK)
+		{
+			*size = odbcTableRowEstimate(dbc, NULL, get_schema_name(options), options->table);
+			found = *size >= 0;
+		}
+		if (!found && (mode == SIZE_ESTIMATE_AUTO || mode == SIZE_ESTIMATE_CATALOG))
+			found = odbcCatalogTableSize(dbc, options, size) && *size >= 0;
+		if (!found && (mode == SIZE_ESTIMATE_AUTO || mode == SIZE_ESTIMATE_EXACT))
+			found = odbcCountRows(dbc, options, size);
+	}
+
+	if (found)
+		elog_debug("Table size: " INT64_FORMAT, *size);
+	else
+		elog(DEBUG1, "Could not obtain the size of table %s", options->table);
+
+	return found;
+}
+
+/*
+ * Size of a table using a new connection to its server
+ */
+static bool
+odbcGetTableSize(odbcFdwOptions* options, SizeEstimateMode mode, int64 *size)
+{
+	SQLHENV env;
+	SQLHDBC dbc;
+	bool found;
+
+	odbc_connection(options, &env, &dbc);
+	found = odbcGetTableSizeOnConnection(dbc, options, mode, size);
+
+	/* Disconnect, and free handles */
+	odbcFreeHandle(SQL_HANDLE_DBC, dbc);
+	odbcFreeHandle(SQL_HANDLE_ENV, env);
+
+	return found;
+}
+
+static int strtoint(const char *nptr, char **endptr, int base)
+{
+	long val = strtol(nptr, endptr, base);
+	return (int) val;
+}
+
+static Oid oid_from_server_name(char *serverName)
+{
+	char *serverOidString;
+	char sql[1024];
+	int serverOid;
+	HeapTuple tuple;
+	TupleDesc tupdesc;
+	int ret;
+
+	if ((ret = SPI_connect()) < 0) {
+		elog(ERROR, "oid_from_server_name: SPI_connect returned %d", ret);
+	}
+
+	sprintf(sql, "SELECT oid FROM pg_foreign_server where srvname = '%s'", serverName);
+	if ((ret = SPI_execute(sql, true, 1)) != SPI_OK_SELECT) {
+		elog(ERROR, "oid_from_server_name: Get server name from Oid query Failed, SP_exec returned %d.", ret);
+	}
+
+	if (SPI_tuptable->vals[0] != NULL)
+	{
+		tupdesc  = SPI_tuptable->tupdesc;
+		tuple    = SPI_tuptable->vals[0];
+
+		serverOidString = SPI_getvalue(tuple, tupdesc, 1);
+		serverOid = strtoint(serverOidString, NULL, 10);
+	} else {
+		elog(ERROR, "Foreign server %s doesn't exist", serverName);
+	}
+
+	SPI_finish();
+	return serverOid;
+}
+
+Datum
+odbc_table_size(PG_FUNCTION_ARGS)
+{
+	char *serverName = text_to_cstring(PG_GETARG_TEXT_PP(0));
+	char *tableName = text_to_cstring(PG_GETARG_TEXT_PP(1));
+	char *defname = "table";
+	int64 tableSize = 0;
+	List *tableOptions = NIL;
+	Node *val = (Node *) makeString(tableName);
+#if PG_VERSION_NUM >= 100000
+	DefElem *elem = (DefElem *) makeDefElem(defname, val, -1);
+#else
+	DefElem *elem = (DefElem *) makeDefElem(defname, val);
+#endif
+
+	tableOptions = lappend(tableOptions, elem);
+	Oid serverOid = oid_from_server_name(serverName);
+	odbcFdwOptions options;
+	odbcGetOptions(serverOid, tableOptions, &options);
+	odbcGetTableSize(&options, SIZE_ESTIMATE_EXACT, &tableSize);
+
+	PG_RETURN_INT32((int32) Min(tableSize, PG_INT32_MAX));
+}
+
+/*
+ * ODBCTableSize(server, table, mode): number of rows of a table
+ * obtained by the given method; NULL if it is not available
+ */
+Datum
+odbc_table_size_estimate(PG_FUNCTION_ARGS)
+{
+	char *serverName = text_to_cstring(PG_GETARG_TEXT_PP(0));
+	char *tableName = text_to_cstring(PG_GETARG_TEXT_PP(1));
+	SizeEstimateMode mode = size_estimate_mode_from_name(text_to_cstring(PG_GETARG_TEXT_PP(2)));
+	List *tableOptions = NIL;
+	odbcFdwOptions options;
+	int64 tableSize;
+
+#if PG_VERSION_NUM >= 100000
+	tableOptions = lappend(tableOptions, makeDefElem("table", (Node *) makeString(tableName), -1));
+#else
+	tableOptions = lappend(tableOptions, makeDefElem("table", (Node *) makeString(tableName)));
+#endif
+	odbcGetOptions(oid_from_server_name(serverName), tableOptions, &options);
+	if (!odbcGetTableSize(&options, mode, &tableSize))
+		PG_RETURN_NULL();
+
+	PG_RETURN_INT64(tableSize);
+}
+
+Datum
+odbc_query_size(PG_FUNCTION_ARGS)
+{
+	char *serverName = text_to_cstring(PG_GETARG_TEXT_PP(0));
+	char *sqlQuery = text_to_cstring(PG_GETARG_TEXT_PP(1));
+	char *defname = "sql_query";
+	int64 querySize = 0;
+	List *queryOptions = NIL;
+	Node *val = (Node *) makeString(sqlQuery);
+#if PG_VERSION_NUM >= 100000
+	DefElem *elem = (DefElem *) makeDefElem(defname, val, -1);
+#else
+	DefElem *elem = (DefElem *) makeDefElem(defname, val);
+#endif
+
+	queryOptions = lappend(queryOptions, elem);
+	Oid serverOid = oid_from_server_name(serverName);
+	odbcFdwOptions options;
+	odbcGetOptions(serverOid, queryOptions, &options);
+	odbcGetTableSize(&options, SIZE_ESTIMATE_EXACT, &querySize);
+
+	PG_RETURN_INT32((int32) Min(querySize, PG_INT32_MAX));
+}
+
+/*
+ * Row-array fetch of result sets
+ *
+ * The result columns of an executed statement are bound column-wise
+ * to buffers holding up to fetch_size rows each, so that a single
+ * SQLFetch call transfers a whole batch of rows from the driver.
+ * Columns too wide to be bound (long or unknown size) force a fallback
+ * to fetching one row at a time reading every column with SQLGetData.
+ */
+typedef struct odbcColumnBuffer
+{
+	char            *name;           /* Result column name */
+	SQLSMALLINT     data_type;       /* ODBC SQL data type */
+	SQLULEN         column_size;
+	SQLSMALLINT     decimal_digits;
+	SQLLEN          width;           /* Bytes per row in data, including the trailing zero */
+	char            *data;           /* Bound buffer for fetch_size values */
+	SQLLEN          *indicators;     /* Bound length/indicator array */
+	StringInfoData  value;           /* Value read with SQLGetData (unbound mode) */
+	bool            isnull;          /* NULL flag for value (unbound mode) */
+} odbcColumnBuffer;
+
+typedef struct odbcResultBuffer
+{
+	SQLHSTMT         stmt;
+	SQLSMALLINT      num_cols;
+	odbcColumnBuffer *columns;
+	SQLULEN          fetch_size;     /* Rows per SQLFetch */
+	SQLULEN          rows_fetched;   /* Rows in the current batch */
+	SQLULEN          current_row;    /* Position in the current batch */
+	SQLUSMALLINT     *row_status;
+	bool             bound;          /* false if values are read with SQLGetData */
+	bool             done;
+	int              encoding;       /* Remote encoding, or -1 */
+	uint64           rows;           /* Rows fetched so far */
+	uint64           bytes;          /* Bytes received from the driver so far */
+	uint64           round_trips;    /* SQLFetch calls so far */
+} odbcResultBuffer;
+
+/*
+ * Per-column conversion of fetched values into Datums of a PostgreSQL type
+ */
+typedef struct odbcColumnConverter
+{
+	Oid       typid;
+	int32     typmod;
+	Oid       typioparam;
+	FmgrInfo  input;
+	bool      hex;     /* Binary data received as hexadecimal digits */
+} odbcColumnConverter;
+
+static bool
+is_binary_sql_type(SQLSMALLINT odbc_data_type)
+{
+	return odbc_data_type == SQL_BINARY ||
+	       odbc_data_type == SQL_VARBINARY ||
+	       odbc_data_type == SQL_LONGVARBINARY;
+}
+
+/*
+ * Read the complete value of a column with SQLGetData, part by part
+ */
+static void
+odbcGetDataAsString(SQLHSTMT stmt, SQLUSMALLINT column, StringInfo value, bool *isnull)
+{
+	char    part[MAXIMUM_BUFFER_SIZE + 1];
+	SQLLEN  indicator;
+	SQLRETURN ret;
+
+	resetStringInfo(value);
+	*isnull = false;
+
+	for (;;)
+	{
+		ret = odbcGetData(stmt, column, SQL_C_CHAR, part, sizeof(part), &indicator);
+		if (ret == SQL_NO_DATA)
+			break;
+		check_return(ret, "Reading ODBC column data", stmt, SQL_HANDLE_STMT);
+
+		if (indicator == SQL_NULL_DATA)
+		{
+			*isnull = true;
+			break;
+		}
+
+		if (ret == SQL_SUCCESS)
+		{
+			/* Last (or only) part */
+			appendBinaryStringInfo(value, part, (int) indicator);
+			break;
+		}
+
+		/* SQL_SUCCESS_WITH_INFO: the buffer has been filled, more data follows */
+		appendBinaryStringInfo(value, part, sizeof(part) - 1);
+	}
+}
+
+static void
+odbcResultBufferInit(odbcResultBuffer *buf, SQLHSTMT stmt, SQLULEN fetch_size, int encoding)
+{
+	SQLSMALLINT i;
+	SQLLEN      row_width = 0;
+	SQLULEN     actual_size = 0;
+
+	memset(buf, 0, sizeof(odbcResultBuffer));
+	buf->stmt = stmt;
+	buf->encoding = encoding;
+	buf->bound = true;
+
+	SQLNumResultCols(stmt, &buf->num_cols);
+	buf->columns = (odbcColumnBuffer *) palloc0(sizeof(odbcColumnBuffer) * Max(buf->num_cols, 1));
+
+	for (i = 0; i < buf->num_cols; i++)
+	{
+		odbcColumnBuffer *col = &buf->columns[i];
+		SQLCHAR     column_name[MAXIMUM_COLUMN_NAME_LEN];
+		SQLSMALLINT name_length;
+		SQLSMALLINT nullable;
+		SQLULEN     size;
+
+		SQLDescribeCol(stmt, i + 1,
+		               column_name, sizeof(column_name), &name_length,
+		               &col->data_type, &col->column_size, &col->decimal_digits, &nullable);
+		col->name = pstrdup((char *) column_name);
+
+		size = col->column_size;
+		if (size < minimum_buffer_size(col->data_type))
+			size = minimum_buffer_size(col->data_type);
+		if (is_binary_sql_type(col->data_type))
+			size *= 2;      /* hexadecimal digits */
+		else
+			size *= MAX_MULTIBYTE_CHAR_LEN;
+
+		if (col->column_size == 0 || size > MAXIMUM_BUFFER_SIZE)
+			buf->bound = false;
+
+		col->width = (SQLLEN) size + 1;
+		row_width += col->width;
+	}
+
+	if (buf->bound && buf->num_cols > 0)
+	{
+		/* Limit the memory used by the bound buffers */
+		if (fetch_size * row_width > MAXIMUM_FETCH_BUFFER_SIZE)
+			fetch_size = MAXIMUM_FETCH_BUFFER_SIZE / row_width;
+		if (fetch_size < 1)
+			fetch_size = 1;
+
+		SQLSetStmtAttr(stmt, SQL_ATTR_ROW_BIND_TYPE, (SQLPOINTER) SQL_BIND_BY_COLUMN, 0);
+		SQLSetStmtAttr(stmt, SQL_ATTR_ROW_ARRAY_SIZE, (SQLPOINTER) fetch_size, 0);
+		/* The driver may have chosen a different (smaller) row array size */
+		if (SQL_SUCCEEDED(SQLGetStmtAttr(stmt, SQL_ATTR_ROW_ARRAY_SIZE, &actual_size, 0, NULL)) && actual_size > 0)
+			fetch_size = actual_size;
+
+		buf->row_status = (SQLUSMALLINT *) palloc0(sizeof(SQLUSMALLINT) * fetch_size);
+		SQLSetStmtAttr(stmt, SQL_ATTR_ROW_STATUS_PTR, buf->row_status, 0);
+		SQLSetStmtAttr(stmt, SQL_ATTR_ROWS_FETCHED_PTR, &buf->rows_fetched, 0);
+
+		for (i = 0; i < buf->num_cols; i++)
+		{
+			odbcColumnBuffer *col = &buf->columns[i];
+			SQLRETURN ret;
+
+			col->data = (char *) palloc(col->width * fetch_size);
+			col->indicators = (SQLLEN *) palloc(sizeof(SQLLEN) * fetch_size);
+			ret = SQLBindCol(stmt, i + 1, SQL_C_CHAR, col->data, col->width, col->indicators);
+			check_return(ret, "Binding ODBC result column", stmt, SQL_HANDLE_STMT);
+		}
+		buf->fetch_size = fetch_size;
+	}
+	else
+	{
+		buf->bound = false;
+		buf->fetch_size = 1;
+		for (i = 0; i < buf->num_cols; i++)
+			initStringInfo(&buf->columns[i].value);
+	}
+}
+
+/*
+ * Advance to the next row of the result set, fetching a new batch
+ * from the driver when the current one has been consumed.
+ * Returns false when there are no more rows.
+ */
+static bool
+odbcResultBufferNext(odbcResultBuffer *buf)
+{
+	SQLRETURN ret;
+	SQLSMALLINT i;
+
+	if (buf->done)
+		return false;
+
+	if (buf->bound && ++buf->current_row < buf->rows_fetched)
+	{
+		buf->rows++;
+		return true;
+	}
+
+	odbc_probe(fetch_start);
+	ret = odbcFetch(buf->stmt);
+	odbc_probe1(fetch_done, ret == SQL_NO_DATA ? 0 : (buf->bound ? buf->rows_fetched : 1));
+	if (ret == SQL_NO_DATA)
+	{
+		buf->done = true;
+		return false;
+	}
+	check_return(ret, "Fetching ODBC results", buf->stmt, SQL_HANDLE_STMT);
+	buf->round_trips++;
+
+	if (buf->bound)
+	{
+		SQLULEN row;
+
+		buf->current_row = 0;
+		if (buf->rows_fetched == 0)
+		{
+			buf->done = true;
+			return false;
+		}
+		for (row = 0; row < buf->rows_fetched; row++)
+		{
+			if (buf->row_status[row] == SQL_ROW_ERROR)
+				ereport(ERROR,
+				        (errcode(ERRCODE_FDW_ERROR),
+				         errmsg("Error fetching row from ODBC data source")));
+			for (i = 0; i < buf->num_cols; i++)
+			{
+				SQLLEN indicator = buf->columns[i].indicators[row];
+				if (indicator > 0)
+					buf->bytes += indicator;
+			}
+		}
+	}
+	else
+	{
+		for (i = 0; i < buf->num_cols; i++)
+		{
+			odbcColumnBuffer *col = &buf->columns[i];
+			odbcGetDataAsString(buf->stmt, i + 1, &col->value, &col->isnull);
+			buf->bytes += col->value.len;
+		}
+	}
+
+	buf->rows++;
+	return true;
+}
+
+/*
+ * Value of a column (0-based) in the current row as a zero-terminated
+ * string in the server encoding, or NULL for SQL NULL.
+ */
+static char *
+odbcResultBufferValue(odbcResultBuffer *buf, int column, int *length)
+{
+	odbcColumnBuffer *col = &buf->columns[column];
+	char   *value;
+	int     len;
+
+	if (buf->bound)
+	{
+		SQLLEN indicator = col->indicators[buf->current_row];
+
+		if (indicator == SQL_NULL_DATA)
+			return NULL;
+		if (indicator == SQL_NO_TOTAL || indicator >= col->width)
+			ereport(ERROR,
+			        (errcode(ERRCODE_FDW_ERROR),
+			         errmsg("Value of column \"%s\" exceeds its declared size", col->name)));
+		value = col->data + buf->current_row * col->width;
+		len = (int) indicator;
+	}
+	else
+	{
+		if (col->isnull)
+			return NULL;
+		value = col->value.data;
+		len = col->value.len;
+	}
+
+	if (buf->encoding != -1)
+	{
+		value = pg_any_to_server(value, len, buf->encoding);
+		len = strlen(value);
+	}
+
+	if (length)
+		*length = len;
+	return value;
+}
+
+/*
+ * Unbind the result buffers from the statement handle
+ */
+static void
+odbcResultBufferEnd(odbcResultBuffer *buf)
+{
+	if (buf->stmt && buf->bound)
+	{
+		SQLFreeStmt(buf->stmt, SQL_UNBIND);
+		SQLSetStmtAttr(buf->stmt, SQL_ATTR_ROW_STATUS_PTR, NULL, 0);
+		SQLSetStmtAttr(buf->stmt, SQL_ATTR_ROWS_FETCHED_PTR, NULL, 0);
+		SQLSetStmtAttr(buf->stmt, SQL_ATTR_ROW_ARRAY_SIZE, (SQLPOINTER) 1, 0);
+	}
+}
+
+/*
+ * PostgreSQL type that corresponds to a result column
+ */
+static void
+odbcResultColumnType(odbcColumnBuffer *col, Oid *typid, int32 *typmod)
+{
+	StringInfoData sql_type;
+
+	*typid = TEXTOID;
+	*typmod = -1;
+
+	switch (col->data_type)
+	{
+	case SQL_CHAR:
+	case SQL_WCHAR:
+	case SQL_VARCHAR:
+	case SQL_WVARCHAR:
+		/* Unknown or excessive sizes: use plain text */
+		if (col->column_size == 0 || col->column_size > MaxAttrSize)
+			return;
+		break;
+	case SQL_DECIMAL:
+	case SQL_NUMERIC:
+		if (col->column_size == 0 || col->column_size > NUMERIC_MAX_PRECISION)
+		{
+			*typid = NUMERICOID;
+			return;
+		}
+		break;
+	case SQL_BINARY:
+	case SQL_VARBINARY:
+	case SQL_LONGVARBINARY:
+		*typid = BYTEAOID;
+		return;
+	}
+
+	sql_data_type(col->data_type, col->column_size, col->decimal_digits, SQL_NULLABLE_UNKNOWN, &sql_type);
+	if (!is_blank_string(sql_type.data))
+	{
+		parseTypeString(sql_type.data, typid, typmod, false);
+	}
+}
+
+static void
+odbcInitColumnConverter(odbcColumnConverter *conv, Oid typid, int32 typmod, SQLSMALLINT odbc_data_type)
+{
+	Oid input_func;
+
+	conv->typid = typid;
+	conv->typmod = typmod;
+	conv->hex = (typid == BYTEAOID && is_binary_sql_type(odbc_data_type));
+	getTypeInputInfo(typid, &input_func, &conv->typioparam);
+	fmgr_info(input_func, &conv->input);
+}
+
+static Datum
+odbcConvertValue(odbcColumnConverter *conv, char *value)
+{
+	if (conv->hex)
+	{
+		StringInfoData hex;
+
+		initStringInfo(&hex);
+		appendStringInfoString(&hex, "\\x");
+		appendStringInfoString(&hex, value);
+		value = hex.data;
+	}
+	return InputFunctionCall(&conv->input, value, conv->typioparam, conv->typmod);
+}
+
+/*
+ * Remote encoding defined by the options, or -1
+ */
+static int
+get_encoding(odbcFdwOptions *options)
+{
+	int encoding = -1;
+
+	if (!is_blank_string(options->encoding))
+	{
+		encoding = pg_char_to_encoding(options->encoding);
+		if (encoding < 0)
+		{
+			ereport(ERROR,
+			        (errcode(ERRCODE_FDW_INVALID_ATTRIBUTE_VALUE),
+			         errmsg("invalid encoding name \"%s\"", options->encoding)
+			        ));
+		}
+	}
+	return encoding;
+}
+
+/*
+ * Connect to the data source of a foreign server and execute a query
+ */
+static void
+odbcExecuteServerQuery(char *server_name, char *sql_query, odbcFdwOptions *options,
+                       SQLHENV *env, SQLHDBC *dbc, SQLHSTMT *stmt)
+{
+	SQLRETURN ret;
+	instr_time start;
+	instr_time duration;
+
+	odbcGetOptions(GetForeignServerByName(server_name, false)->serverid, NIL, options);
+	odbc_connection(options, env, dbc);
+
+	/* Allocate a statement handle */
+	odbcAllocHandle(SQL_HANDLE_STMT, *dbc, stmt);
+	odbcSetQueryTimeout(*stmt, options);
+	odbcSetCursorMode(*stmt, options);
+	odbcRegisterActiveStatement(*stmt, options);
+
+	elog_debug("Executing query: %s", sql_query);
+	INSTR_TIME_SET_CURRENT(start);
+	ret = odbcExecDirect(*stmt, (SQLCHAR *) sql_query, SQL_NTS);
+	check_return(ret, "Executing ODBC query", *stmt, SQL_HANDLE_STMT);
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, start);
+	odbcStatsReport(options, InvalidOid, sql_query, 1, 0, 0, INSTR_TIME_GET_MILLISEC(duration));
+}
+
+static void
+odbcFreeServerQuery(SQLHENV env, SQLHDBC dbc, SQLHSTMT stmt)
+{
+	/* Free handles, and disconnect */
+	odbcFreeHandle(SQL_HANDLE_STMT, stmt);
+	odbcFreeHandle(SQL_HANDLE_DBC, dbc);
+	odbcFreeHandle(SQL_HANDLE_ENV, env);
+}
+
+/*
+ * Cache of connections kept open for the rest of the session,
+ * one for each foreign server and local user
+ */
+typedef struct odbcConnCacheKey
+{
+	Oid serverid;
+	Oid userid;
+} odbcConnCacheKey;
+
+typedef struct odbcConnCacheEntry
+{
+	odbcConnCacheKey key;
+	char *identity;         /* Connection string and session profile used, in TopMemoryContext */
+	SQLHENV env;
+	SQLHDBC dbc;
+} odbcConnCacheEntry;
+
+static HTAB *ConnectionCache = NULL;
+
+/*
+ * What a cached connection depends on: the connection attributes, and the
+ * options applied when connecting (the session profile and the login
+ * timeout), which a connection made with other values would not honour.
+ * The attributes added for cursor_mode 'streaming' only change how results
+ * are read, so they are left out: a cursor_mode set on some foreign tables
+ * must not make the connection be reopened each time another one is used.
+ */
+static void
+odbcConnIdentity(StringInfoData *identity, odbcFdwOptions *options)
+{
+	initStringInfo(identity);
+	appendConnAttributes(identity, options);
+	appendStringInfo(identity, "\n%d\n%d\n%s\n%s\n%s",
+	                 options->connect_timeout,
+	                 options->packet_size,
+	                 options->read_only ? options->read_only : "",
+	                 options->isolation_level ? options->isolation_level : "",
+	                 options->init_sql ? options->init_sql : "");
+}
+
+static void
+odbcDisconnectCached(odbcConnCacheEntry *entry)
+{
+	if (entry->dbc)
+	{
+		odbcFreeHandle(SQL_HANDLE_DBC, entry->dbc);
+		entry->dbc = NULL;
+	}
+	if (entry->env)
+	{
+		odbcFreeHandle(SQL_HANDLE_ENV, entry->env);
+		entry->env = NULL;
+	}
+	if (entry->identity)
+	{
+		pfree(entry->identity);
+		entry->identity = NULL;
+	}
+}
+
+/*
+ * Cached connection to the data source of a foreign server for the
+ * current user; a new connection is made if the connection string or
+ * the session profile have changed
+ */
+static odbcConnCacheEntry *
+odbcGetCachedConnection(Oid serverid, odbcFdwOptions *options)
+{
+	odbcConnCacheKey key;
+	odbcConnCacheEntry *entry;
+	StringInfoData identity;
+	bool found;
+
+	if (ConnectionCache == NULL)
+	{
+		HASHCTL ctl;
+
+		memset(&ctl, 0, sizeof(ctl));
+		ctl.keysize = sizeof(odbcConnCacheKey);
+		ctl.entrysize = sizeof(odbcConnCacheEntry);
+		ctl.hcxt = TopMemoryContext;
+		ConnectionCache = hash_create("odbc_fdw connections", 8, &ctl,
+		                              HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+	}
+
+	memset(&key, 0, sizeof(key));
+	key.serverid = serverid;
+	key.userid = GetUserId();
+	entry = (odbcConnCacheEntry *) hash_search(ConnectionCache, &key, HASH_ENTER, &found);
+	if (!found)
+	{
+		entry->identity = NULL;
+		entry->env = NULL;
+		entry->dbc = NULL;
+	}
+
+	odbcConnIdentity(&identity, options);
+	if (entry->dbc && strcmp(entry->identity, identity.data) != 0)
+		odbcDisconnectCached(entry);
+
+	if (entry->dbc == NULL)
+	{
+		SQLHENV env;
+		SQLHDBC dbc;
+
+		elog_debug("New cached connection for server %u", serverid);
+		odbc_connection(options, &env, &dbc);
+		odbcKeepHandle(env);
+		odbcKeepHandle(dbc);
+		entry->env = env;
+		entry->dbc = dbc;
+		entry->identity = MemoryContextStrdup(TopMemoryContext, identity.data);
+	}
+	else
+		odbcStatsCountConnection(serverid, true);
+	pfree(identity.data);
+
+	return entry;
+}
+
+/*
+ * Bulk export of the result of a remote query to a server file
+ */
+typedef enum { CSV_EXPORT, BINARY_EXPORT } ExportFormat;
+
+static const char BINARY_COPY_SIGNATURE[11] = "PGCOPY\n\377\r\n\0";
+
+static void
+export_write(FILE *file, const void *data, size_t len, uint64 *bytes, const char *path)
+{
+	if (len > 0 && fwrite(data, 1, len, file) != len)
+		ereport(ERROR,
+		        (errcode_for_file_access(),
+		         errmsg("could not write to file \"%s\": %m", path)));
+	*bytes += len;
+}
+
+static void
+export_write_int32(FILE *file, int32 value, uint64 *bytes, const char *path)
+{
+	uint32 n = htonl((uint32) value);
+	export_write(file, &n, sizeof(n), bytes, path);
+}
+
+static void
+export_write_int16(FILE *file, int16 value, uint64 *bytes, const char *path)
+{
+	uint16 n = htons((uint16) value);
+	export_write(file, &n, sizeof(n), bytes, path);
+}
+
+/*
+ * Write a value using the CSV quoting rules of COPY:
+ * quote it if it contains special characters or is an empty string
+ */
+static void
+export_write_csv_value(FILE *file, StringInfo line, const char *value)
+{
+	const char *p;
+	bool quote = (value[0] == '\0');
+
+	for (p = value; !quote && *p; p++)
+	{
+		if (*p == ',' || *p == '"' || *p == '\n' || *p == '\r')
+			quote = true;
+	}
+
+	if (!quote)
+	{
+		appendStringInfoString(line, value);
+		return;
+	}
+
+	appendStringInfoChar(line, '"');
+	for (p = value; *p; p++)
+	{
+		if (*p == '"')
+			appendStringInfoChar(line, '"');
+		appendStringInfoChar(line, *p);
+	}
+	appendStringInfoChar(line, '"');
+}
+
+Datum
+odbc_fdw_export(PG_FUNCTION_ARGS)
+{
+	char   *server_name = text_to_cstring(PG_GETARG_TEXT_PP(0));
+	char   *sql_query = text_to_cstring(PG_GETARG_TEXT_PP(1));
+	char   *path = text_to_cstring(PG_GETARG_TEXT_PP(2));
+	char   *format_name = text_to_cstring(PG_GETARG_TEXT_PP(3));
+	ExportFormat format;
+	odbcFdwOptions options;
+	SQLHENV env;
+	SQLHDBC dbc;
+	SQLHSTMT stmt;
+	odbcResultBuffer result;
+	odbcColumnConverter *converters = NULL;
+	FmgrInfo *send_funcs = NULL;
+	FILE *file;
+	StringInfoData line;
+	MemoryContext row_context;
+	MemoryContext old_context;
+	uint64 bytes = 0;
+	instr_time start_time;
+	instr_time elapsed;
+	TupleDesc tupdesc;
+	Datum values[3];
+	bool nulls[3] = { false, false, false };
+	int i;
+
+	elog_debug("%s", __func__);
+
+#if PG_VERSION_NUM >= 110000
+	if (!superuser() && !is_member_of_role(GetUserId(), DEFAULT_ROLE_WRITE_SERVER_FILES))
+#else
+	if (!superuser())
+#endif
+		ereport(ERROR,
+		        (errcode(ERRCODE_INSUFFICIENT_PRIVILEGE),
+		         errmsg("must be superuser to export to a file")));
+
+	if (pg_strcasecmp(format_name, "csv") == 0)
+		format = CSV_EXPORT;
+	else if (pg_strcasecmp(format_name, "binary") == 0)
+		format = BINARY_EXPORT;
+	else
+		ereport(ERROR,
+		        (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+		         errmsg("export format \"%s\" not supported", format_name),
+		         errhint("Valid formats are: csv, binary")));
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		ereport(ERROR,
+		        (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+		         errmsg("function returning record called in context "
+		                "that cannot accept type record")));
+
+	INSTR_TIME_SET_CURRENT(start_time);
+
+	odbcExecuteServerQuery(server_name, sql_query, &options, &env, &dbc, &stmt);
+	odbcResultBufferInit(&result, stmt, DEFAULT_FETCH_SIZE, get_encoding(&options));
+
+	if (format == BINARY_EXPORT)
+	{
+		/* Binary COPY needs the values in the send format of their types */
+		converters = (odbcColumnConverter *) palloc(sizeof(odbcColumnConverter) * Max(result.num_cols, 1));
+		send_funcs = (FmgrInfo *) palloc(sizeof(FmgrInfo) * Max(result.num_cols, 1));
+		for (i = 0; i < result.num_cols; i++)
+		{
+			Oid   typid;
+			int32 typmod;
+			Oid   send_func;
+			bool  is_varlena;
+
+			odbcResultColumnType(&result.columns[i], &typid, &typmod);
+			odbcInitColumnConverter(&converters[i], typid, typmod, result.columns[i].data_type);
+			getTypeBinaryOutputInfo(typid, &send_func, &is_varlena);
+			fmgr_info(send_func, &send_funcs[i]);
+		}
+	}
+
+	file = AllocateFile(path, PG_BINARY_W);
+	if (file == NULL)
+		ereport(ERROR,
+		        (errcode_for_file_access(),
+		         errmsg("could not open file \"%s\" for writing: %m", path)));
+
+	if (format == BINARY_EXPORT)
+	{
+		export_write(file, BINARY_COPY_SIGNATURE, sizeof(BINARY_COPY_SIGNATURE), &bytes, path);
+		export_write_int32(file, 0, &bytes, path);   /* flags */
+		export_write_int32(file, 0, &bytes, path);   /* header extension length */
+	}
+
+	row_context = AllocSetContextCreate(CurrentMemoryContext,
+	                                    "odbc_fdw export row",
+	                                    ALLOCSET_DEFAULT_SIZES);
+	initStringInfo(&line);
+
+	while (odbcResultBufferNext(&result))
+	{
+		CHECK_FOR_INTERRUPTS();
+		old_context = MemoryContextSwitchTo(row_context);
+
+		if (format == CSV_EXPORT)
+		{
+			resetStringInfo(&line);
+			for (i = 0; i < result.num_cols; i++)
+			{
+				char *value = odbcResultBufferValue(&result, i, NULL);
+
+				if (i > 0)
+					appendStringInfoChar(&line, ',');
+				if (value != NULL)
+				{
+					if (is_binary_sql_type(result.columns[i].data_type))
+						appendStringInfoString(&line, "\\x");
+					export_write_csv_value(file, &line, value);
+				}
+			}
+			appendStringInfoChar(&line, '\n');
+			export_write(file, line.data, line.len, &bytes, path);
+		}
+		else
+		{
+			export_write_int16(file, (int16) result.num_cols, &bytes, path);
+			for (i = 0; i < result.num_cols; i++)
+			{
+				char *value = odbcResultBufferValue(&result, i, NULL);
+
+				if (value == NULL)
+					export_write_int32(file, -1, &bytes, path);
+				else
+				{
+					Datum datum = odbcConvertValue(&converters[i], value);
+					bytea *outputbytes = SendFunctionCall(&send_funcs[i], datum);
+
+					export_write_int32(file, VARSIZE(outputbytes) - VARHDRSZ, &bytes, path);
+					export_write(file, VARDATA(outputbytes), VARSIZE(outputbytes) - VARHDRSZ, &bytes, path);
+				}
+			}
+		}
+
+		MemoryContextSwitchTo(old_context);
+		MemoryContextReset(row_context);
+	}
+
+	if (format == BINARY_EXPORT)
+		export_write_int16(file, -1, &bytes, path);
+
+	if (FreeFile(file))
+		ereport(ERROR,
+		        (errcode_for_file_access(),
+		         errmsg("could not close file \"%s\": %m", path)));
+
+	odbcStatsReport(&options, InvalidOid, sql_query, 0, result.rows, result.bytes, 0);
+	odbcResultBufferEnd(&result);
+	MemoryContextDelete(row_context);
+	odbcFreeServerQuery(env, dbc, stmt);
+
+	INSTR_TIME_SET_CURRENT(elapsed);
+	INSTR_TIME_SUBTRACT(elapsed, start_time);
+
+	values[0] = Int64GetDatum((int64) result.rows);
+	values[1] = Int64GetDatum((int64) bytes);
+	values[2] = Float8GetDatum(INSTR_TIME_GET_MILLISEC(elapsed));
+
+	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(BlessTupleDesc(tupdesc), values, nulls)));
+}
+
+/*
+ * Bulk load of the result of a remote query into a local table
+ *
+ * Like COPY FROM, rows are inserted with heap_multi_insert in batches
+ * of LOAD_BATCH_SIZE tuples using a bulk-insert state, and the indexes
+ * of the table are updated after each batch. Result columns are assigned
+ * by position to the columns of the table; remaining columns get their
+ * defaults, as with COPY.
+ */
+#define LOAD_BATCH_SIZE 1000
+
+static void
+odbcLoadFlushBatch(Relation rel, HeapTuple *tuples, int ntuples,
+                   CommandId cid, int options, BulkInsertState bistate,
+                   EState *estate, ResultRelInfo *resultRelInfo, TupleTableSlot *slot)
+{
+	int i;
+
+	heap_multi_insert(rel, tuples, ntuples, cid, options, bistate);
+
+	if (resultRelInfo->ri_NumIndices > 0)
+	{
+		for (i = 0; i < ntuples; i++)
+		{
+			List *recheck_indexes;
+
+			ExecStoreTuple(tuples[i], slot, InvalidBuffer, false);
+			recheck_indexes = ExecInsertIndexTuples(slot, &(tuples[i]->t_self), estate, false, NULL, NIL);
+			list_free(recheck_indexes);
+			ResetPerTupleExprContext(estate);
+		}
+	}
+}
+
+Datum
+odbc_fdw_load(PG_FUNCTION_ARGS)
+{
+	Oid    relid = PG_GETARG_OID(0);
+	char  *server_name = text_to_cstring(PG_GETARG_TEXT_PP(1));
+	char  *sql_query = text_to_cstring(PG_GETARG_TEXT_PP(2));
+	bool   freeze = PG_GETARG_BOOL(3);
+	Relation rel;
+	TupleDesc tupdesc;
+	AclResult aclresult;
+	odbcFdwOptions options;
+	SQLHENV env;
+	SQLHDBC dbc;
+	SQLHSTMT stmt;
+	odbcResultBuffer result;
+	odbcColumnConverter *converters;
+	AttrNumber *attnums;
+	int num_attrs = 0;
+	ExprState **defexprs;
+	AttrNumber *defmap;
+	int num_defaults = 0;
+	ExprContext *econtext;
+	Datum *values;
+	bool *nulls;
+	HeapTuple *tuples;
+	int ntuples = 0;
+	int64 total = 0;
+	int insert_options = 0;
+	CommandId cid;
+	BulkInsertState bistate;
+	EState *estate;
+	ResultRelInfo *resultRelInfo;
+	TupleTableSlot *slot;
+	MemoryContext batch_context;
+	MemoryContext old_context;
+	int i;
+
+	elog_debug("%s", __func__);
+
+	rel = heap_open(relid, RowExclusiveLock);
+	tupdesc = RelationGetDescr(rel);
+
+	if (rel->rd_rel->relkind != RELKIND_RELATION)
+		ereport(ERROR,
+		        (errcode(ERRCODE_WRONG_OBJECT_TYPE),
+		         errmsg("\"%s\" is not a table", RelationGetRelationName(rel))));
+
+	aclresult = pg_class_aclcheck(relid, GetUserId(), ACL_INSERT);
+	if (aclresult != ACLCHECK_OK)
+#if PG_VERSION_NUM >= 110000
+		aclcheck_error(aclresult, OBJECT_TABLE, RelationGetRelationName(rel));
+#else
+		aclcheck_error(aclresult, ACL_KIND_CLASS, RelationGetRelationName(rel));
+#endif
+
+	/* The fast path bypasses the executor: refuse what it would have to handle */
+	if (check_enable_rls(relid, InvalidOid, false) == RLS_ENABLED)
+		ereport(ERROR,
+		        (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+		         errmsg("odbc_fdw_load is not supported for tables with row-level security")));
+	if (rel->trigdesc && (rel->trigdesc->trig_insert_before_row ||
+	                      rel->trigdesc->trig_insert_after_row ||
+	                      rel->trigdesc->trig_insert_before_statement ||
+	                      rel->trigdesc->trig_insert_after_statement))
+		ereport(ERROR,
+		        (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+		         errmsg("odbc_fdw_load is not supported for tables with INSERT triggers"),
+		         errhint("Use INSERT ... SELECT from a foreign table instead.")));
+	if (tupdesc->constr && tupdesc->constr->num_check > 0)
+		ereport(ERROR,
+		        (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+		         errmsg("odbc_fdw_load is not supported for tables with CHECK constraints"),
+		         errhint("Use INSERT ... SELECT from a foreign table instead.")));
+
+	if (freeze)
+	{
+		/* Same requirements as COPY FREEZE */
+		if (!ThereAreNoPriorRegisteredSnapshots() || !ThereAreNoReadyPortals())
+			ereport(ERROR,
+			        (errcode(ERRCODE_INVALID_TRANSACTION_STATE),
+			         errmsg("cannot perform FREEZE because of prior transaction activity")));
+		if (rel->rd_createSubid != GetCurrentSubTransactionId() &&
+		    rel->rd_newRelfilenodeSubid != GetCurrentSubTransactionId())
+			ereport(ERROR,
+			        (errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+			         errmsg("cannot perform FREEZE because the table was not created or truncated in the current subtransaction")));
+		insert_options |= HEAP_INSERT_FROZEN | HEAP_INSERT_SKIP_FSM;
+	}
+
+	odbcExecuteServerQuery(server_name, sql_query, &options, &env, &dbc, &stmt);
+	odbcResultBufferInit(&result, stmt, DEFAULT_FETCH_SIZE, get_encoding(&options));
+
+	/* Assign result columns to table columns by position */
+	attnums = (AttrNumber *) palloc(sizeof(AttrNumber) * Max(result.num_cols, 1));
+	converters = (odbcColumnConverter *) palloc(sizeof(odbcColumnConverter) * Max(result.num_cols, 1));
+	for (i = 0; i < tupdesc->natts && num_attrs < result.num_cols; i++)
+	{
+		Form_pg_attribute attr = TupleDescAttr(tupdesc, i);
+
+		if (attr->attisdropped)
+			continue;
+		attnums[num_attrs] = attr->attnum;
+		odbcInitColumnConverter(&converters[num_attrs], attr->atttypid, attr->atttypmod,
+		                        result.columns[num_attrs].data_type);
+		num_attrs++;
+	}
+	if (num_attrs < result.num_cols)
+		ereport(ERROR,
+		        (errcode(ERRCODE_DATATYPE_MISMATCH),
+		         errmsg("query returns %d columns but table \"%s\" has only %d",
+		                result.num_cols, RelationGetRelationName(rel), num_attrs)));
+
+	/* The columns after the last assigned one get their defaults */
+	defexprs = (ExprState **) palloc(sizeof(ExprState *) * tupdesc->natts);
+	defmap = (AttrNumber *) palloc(sizeof(AttrNumber) * tupdesc->natts);
+	for (; i < tupdesc->natts; i++)
+	{
+		Form_pg_attribute attr = TupleDescAttr(tupdesc, i);
+		Expr *defexpr;
+
+		if (attr->attisdropped)
+			continue;
+		defexpr = (Expr *) build_column_default(rel, attr->attnum);
+		if (defexpr == NULL)
+			continue;
+		defexpr = expression_planner(defexpr);
+		defexprs[num_defaults] = ExecInitExpr(defexpr, NULL);
+		defmap[num_defaults] = i;
+		num_defaults++;
+	}
+
+	/* Executor state needed to maintain the indexes */
+	estate = CreateExecutorState();
+	resultRelInfo = makeNode(ResultRelInfo);
+#if PG_VERSION_NUM >= 100000
+	InitResultRelInfo(resultRelInfo, rel, 1, NULL, 0);
+#else
+	InitResultRelInfo(resultRelInfo, rel, 1, 0);
+#endif
+	ExecOpenIndices(resultRelInfo, false);
+	for (i = 0; i < resultRelInfo->ri_NumIndices; i++)
+	{
+		if (!resultRelInfo->ri_IndexRelationDescs[i]->rd_index->indimmediate)
+			ereport(ERROR,
+			        (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+			         errmsg("odbc_fdw_load is not supported for tables with deferrable unique constraints")));
+	}
+	estate->es_result_relations = resultRelInfo;
+	estate->es_num_result_relations = 1;
+	estate->es_result_relation_info = resultRelInfo;
+	slot = MakeSingleTupleTableSlot(tupdesc);
+	econtext = GetPerTupleExprContext(estate);
+
+	values = (Datum *) palloc(sizeof(Datum) * tupdesc->natts);
+	nulls = (bool *) palloc(sizeof(bool) * tupdesc->natts);
+	tuples = (HeapTuple *) palloc(sizeof(HeapTuple) * LOAD_BATCH_SIZE);
+	cid = GetCurrentCommandId(true);
+	bistate = GetBulkInsertState();
+	batch_context = AllocSetContextCreate(CurrentMemoryContext,
+	                                      "odbc_fdw load batch",
+	                                      ALLOCSET_DEFAULT_SIZES);
+
+	while (odbcResultBufferNext(&result))
+	{
+		CHECK_FOR_INTERRUPTS();
+		old_context = MemoryContextSwitchTo(batch_context);
+
+		memset(nulls, true, sizeof(bool) * tupdesc->natts);
+		for (i = 0; i < result.num_cols; i++)
+		{
+			char *value = odbcResultBufferValue(&result, i, NULL);
+			int   attidx = attnums[i] - 1;
+
+			if (value != NULL)
+			{
+				values[attidx] = odbcConvertValue(&converters[i], value);
+				nulls[attidx] = false;
+			}
+		}
+		for (i = 0; i < num_defaults; i++)
+		{
+#if PG_VERSION_NUM >= 100000
+			values[defmap[i]] = ExecEvalExpr(defexprs[i], econtext, &nulls[defmap[i]]);
+#else
+			values[defmap[i]] = ExecEvalExpr(defexprs[i], econtext, &nulls[defmap[i]], NULL);
+#endif
+		}
+		for (i = 0; i < tupdesc->natts; i++)
+		{
+			Form_pg_attribute attr = TupleDescAttr(tupdesc, i);
+
+			if (attr->attnotnull && nulls[i])
+				ereport(ERROR,
+				        (errcode(ERRCODE_NOT_NULL_VIOLATION),
+				         errmsg("null value in column \"%s\" violates not-null constraint",
+				                NameStr(attr->attname))));
+		}
+		tuples[ntuples++] = heap_form_tuple(tupdesc, values, nulls);
+		ResetPerTupleExprContext(estate);
+
+		MemoryContextSwitchTo(old_context);
+
+		if (ntuples == LOAD_BATCH_SIZE)
+		{
+			odbcLoadFlushBatch(rel, tuples, ntuples, cid, insert_options, bistate,
+			                   estate, resultRelInfo, slot);
+			total += ntuples;
+			ntuples = 0;
+			MemoryContextReset(batch_context);
+		}
+	}
+	if (ntuples > 0)
+	{
+		odbcLoadFlushBatch(rel, tuples, ntuples, cid, insert_options, bistate,
+		                   estate, resultRelInfo, slot);
+		total += ntuples;
+	}
+
+	odbcStatsReport(&options, InvalidOid, sql_query, 0, result.rows, result.bytes, 0);
+	odbcResultBufferEnd(&result);
+	odbcFreeServerQuery(env, dbc, stmt);
+
+	MemoryContextDelete(batch_context);
+	FreeBulkInsertState(bistate);
+	ExecDropSingleTupleTableSlot(slot);
+	ExecCloseIndices(resultRelInfo);
+	FreeExecutorState(estate);
+	heap_close(rel, NoLock);
+
+	PG_RETURN_INT64(total);
+}
+
+/*
+ * Pass-through query
+ *
+ * odbc_query(server, sql) executes sql on the data source of the server
+ * and returns its rows, converted to the column types of the column
+ * definition list of the call, one row per call so that the whole
+ * result is never held by the function.
+ */
+typedef struct odbcQueryState
+{
+	SQLHENV env;
+	SQLHDBC dbc;
+	SQLHSTMT stmt;
+	odbcResultBuffer result;
+	odbcColumnConverter *converters;
+	Datum *values;
+	bool *nulls;
+	bool open;
+	ExprContext *econtext;  /* Where odbcQueryShutdown is registered */
+	odbcFdwOptions options;
+	char *sql;
+} odbcQueryState;
+
+static void
+odbcQueryClose(odbcQueryState *state)
+{
+	if (state->open)
+	{
+		state->open = false;
+		odbcStatsReport(&state->options, InvalidOid, state->sql, 0,
+		                state->result.rows, state->result.bytes, 0);
+		odbcResultBufferEnd(&state->result);
+		odbcFreeServerQuery(state->env, state->dbc, state->stmt);
+	}
+}
+
+/*
+ * Release the connection when the query is not read to the end
+ */
+static void
+odbcQueryShutdown(Datum arg)
+{
+	odbcQueryClose((odbcQueryState *) DatumGetPointer(arg));
+}
+
+Datum
+odbc_query(PG_FUNCTION_ARGS)
+{
+	FuncCallContext *funcctx;
+	odbcQueryState *state;
+	int i;
+
+	if (SRF_IS_FIRSTCALL())
+	{
+		char *server_name = text_to_cstring(PG_GETARG_TEXT_PP(0));
+		char *sql_query = text_to_cstring(PG_GETARG_TEXT_PP(1));
+		ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+		odbcFdwOptions options;
+		TupleDesc tupdesc;
+		MemoryContext oldcontext;
+
+		elog_debug("%s", __func__);
+
+		funcctx = SRF_FIRSTCALL_INIT();
+		oldcontext = MemoryContextSwitchTo(funcctx->multi_call_memory_ctx);
+
+		if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+			ereport(ERROR,
+			        (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+			         errmsg("a column definition list is required for odbc_query"),
+			         errhint("Use SELECT * FROM odbc_query(server, sql) AS t(column type, ...).")));
+		funcctx->tuple_desc = BlessTupleDesc(tupdesc);
+
+		state = (odbcQueryState *) palloc0(sizeof(odbcQueryState));
+		odbcExecuteServerQuery(server_name, sql_query, &options, &state->env, &state->dbc, &state->stmt);
+		state->open = true;
+		state->options = options;
+		state->sql = pstrdup(sql_query);
+		odbcResultBufferInit(&state->result, state->stmt, DEFAULT_FETCH_SIZE, get_encoding(&options));
+
+		if (state->result.num_cols != tupdesc->natts)
+		{
+			int num_cols = state->result.num_cols;
+
+			odbcQueryClose(state);
+			ereport(ERROR,
+			        (errcode(ERRCODE_DATATYPE_MISMATCH),
+			         errmsg("query returns %d columns but the column definition list has %d",
+			                num_cols, tupdesc->natts)));
+		}
+
+		state->converters = (odbcColumnConverter *) palloc(sizeof(odbcColumnConverter) * Max(tupdesc->natts, 1));
+		for (i = 0; i < tupdesc->natts; i++)
+		{
+			Form_pg_attribute attr = TupleDescAttr(tupdesc, i);
+
+			odbcInitColumnConverter(&state->converters[i], attr->atttypid, attr->atttypmod,
+			                        state->result.columns[i].data_type);
+		}
+		state->values = (Datum *) palloc(sizeof(Datum) * Max(tupdesc->natts, 1));
+		state->nulls = (bool *) palloc(sizeof(bool) * Max(tupdesc->natts, 1));
+
+		if (rsinfo && IsA(rsinfo, ReturnSetInfo) && rsinfo->econtext)
+		{
+			state->econtext = rsinfo->econtext;
+			RegisterExprContextCallback(state->econtext, odbcQueryShutdown, PointerGetDatum(state));
+		}
+
+		funcctx->user_fctx = state;
+		MemoryContextSwitchTo(oldcontext);
+	}
+
+	funcctx = SRF_PERCALL_SETUP();
+	state = (odbcQueryState *) funcctx->user_fctx;
+
+	CHECK_FOR_INTERRUPTS();
+	if (state->open && odbcResultBufferNext(&state->result))
+	{
+		HeapTuple tuple;
+
+		for (i = 0; i < state->result.num_cols; i++)
+		{
+			char *value = odbcResultBufferValue(&state->result, i, NULL);
+
+			state->nulls[i] = (value == NULL);
+			state->values[i] = value ? odbcConvertValue(&state->converters[i], value) : (Datum) 0;
+		}
+		tuple = heap_form_tuple(funcctx->tuple_desc, state->values, state->nulls);
+		SRF_RETURN_NEXT(funcctx, HeapTupleGetDatum(tuple));
+	}
+
+	/* The state is freed with the multi-call context */
+	odbcQueryClose(state);
+	if (state->econtext)
+		UnregisterExprContextCallback(state->econtext, odbcQueryShutdown, PointerGetDatum(state));
+	SRF_RETURN_DONE(funcctx);
+}
+
+/*
+ * Fetch throughput probe
+ *
+ * odbc_fdw_benchmark(server, sql, fetch_size, mode) executes a remote
+ * query and reads its result to the end without returning it, stopping
+ * at the stage selected by mode: 'fetch' only transfers the rows from
+ * the driver, 'text' also reads every value as a string in the server
+ * encoding, and 'datum' converts them to Datums of the PostgreSQL type
+ * of each column. It returns the wall and CPU time of each phase
+ * (connect, execute, fetch, convert and total) with the throughput in
+ * rows and megabytes per second, so that the time spent in the driver
+ * and the network can be told from the time spent in the conversions.
+ */
+typedef enum { BENCH_FETCH, BENCH_TEXT, BENCH_DATUM } BenchmarkMode;
+
+typedef enum
+{
+	BENCH_PHASE_CONNECT,
+	BENCH_PHASE_EXECUTE,
+	BENCH_PHASE_FETCH,
+	BENCH_PHASE_CONVERT,
+	BENCH_NUM_PHASES
+} BenchmarkPhase;
+
+static const char *const benchmark_phase_names[] = { "connect", "execute", "fetch", "convert" };
+
+typedef struct odbcBenchmarkClock
+{
+	BenchmarkPhase phase;                   /* Phase being timed */
+	PGRUsage       mark;                    /* Start of the current interval */
+	double         wall_ms[BENCH_NUM_PHASES];
+	double         cpu_ms[BENCH_NUM_PHASES];
+} odbcBenchmarkClock;
+
+static double
+rusage_cpu_ms(const PGRUsage *ru)
+{
+	return (ru->ru.ru_utime.tv_sec + ru->ru.ru_stime.tv_sec) * 1000.0 +
+	       (ru->ru.ru_utime.tv_usec + ru->ru.ru_stime.tv_usec) / 1000.0;
+}
+
+/*
+ * Charge the time elapsed since the last switch to the current phase,
+ * and start timing the given one. The clocks are only read when the
+ * phase changes, i.e. twice per batch of fetched rows.
+ */
+static void
+odbcBenchmarkSwitch(odbcBenchmarkClock *timer, BenchmarkPhase phase)
+{
+	PGRUsage now;
+
+	pg_rusage_init(&now);
+	timer->wall_ms[timer->phase] += (now.tv.tv_sec - timer->mark.tv.tv_sec) * 1000.0 +
+	                                (now.tv.tv_usec - timer->mark.tv.tv_usec) / 1000.0;
+	timer->cpu_ms[timer->phase] += rusage_cpu_ms(&now) - rusage_cpu_ms(&timer->mark);
+	timer->mark = now;
+	timer->phase = phase;
+}
+
+static void
+odbcBenchmarkPutRow(Tuplestorestate *tupstore, TupleDesc tupdesc, const char *phase,
+                    double wall_ms, double cpu_ms, bool with_rows, uint64 rows, uint64 bytes)
+{
+	Datum values[7];
+	bool nulls[7] = { false, false, false, false, false, false, false };
+
+	values[0] = CStringGetTextDatum(phase);
+	values[1] = Float8GetDatum(wall_ms);
+	values[2] = Float8GetDatum(cpu_ms);
+	values[3] = Int64GetDatum((int64) rows);
+	values[4] = Int64GetDatum((int64) bytes);
+	values[5] = Float8GetDatum(wall_ms > 0 ? rows * 1000.0 / wall_ms : 0);
+	values[6] = Float8GetDatum(wall_ms > 0 ? bytes * 1000.0 / wall_ms / (1024 * 1024) : 0);
+	/* Rows and rates only apply to the phases that read the result */
+	nulls[3] = nulls[4] = !with_rows;
+	nulls[5] = nulls[6] = !with_rows || wall_ms <= 0;
+	tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+}
+
+/*
+ * True if the next odbcResultBufferNext call will fetch from the driver
+ */
+static inline bool
+odbcResultBufferNeedsFetch(odbcResultBuffer *buf)
+{
+	return !buf->bound || buf->current_row + 1 >= buf->rows_fetched;
+}
+
+/*
+ * Execute a query and read its result to the stage of mode, timing
+ * each phase; returns the number of rows and bytes received
+ */
+static void
+odbcBenchmarkQuery(char *server_name, char *sql_query, int32 fetch_size, BenchmarkMode mode,
+                   odbcBenchmarkClock *timer, uint64 *rows, uint64 *bytes)
+{
+	odbcFdwOptions options;
+	SQLHENV env;
+	SQLHDBC dbc;
+	SQLHSTMT stmt;
+	SQLRETURN ret;
+	odbcResultBuffer result;
+	odbcColumnConverter *converters = NULL;
+	MemoryContext row_context;
+	MemoryContext old_context;
+	int i;
+
+	memset(timer, 0, sizeof(odbcBenchmarkClock));
+	timer->phase = BENCH_PHASE_CONNECT;
+	pg_rusage_init(&timer->mark);
+
+	odbcGetOptions(GetForeignServerByName(server_name, false)->serverid, NIL, &options);
+	odbc_connection(&options, &env, &dbc);
+
+	odbcBenchmarkSwitch(timer, BENCH_PHASE_EXECUTE);
+	odbcAllocHandle(SQL_HANDLE_STMT, dbc, &stmt);
+	odbcSetQueryTimeout(stmt, &options);
+	odbcSetCursorMode(stmt, &options);
+	odbcRegisterActiveStatement(stmt, &options);
+	elog_debug("Executing query: %s", sql_query);
+	ret = odbcExecDirect(stmt, (SQLCHAR *) sql_query, SQL_NTS);
+	check_return(ret, "Executing ODBC query", stmt, SQL_HANDLE_STMT);
+	odbcResultBufferInit(&result, stmt, (SQLULEN) fetch_size, get_encoding(&options));
+
+	if (mode == BENCH_DATUM)
+	{
+		converters = (odbcColumnConverter *) palloc(sizeof(odbcColumnConverter) * Max(result.num_cols, 1));
+		for (i = 0; i < result.num_cols; i++)
+		{
+			Oid   typid;
+			int32 typmod;
+
+			odbcResultColumnType(&result.columns[i], &typid, &typmod);
+			odbcInitColumnConverter(&converters[i], typid, typmod, result.columns[i].data_type);
+		}
+	}
+
+	row_context = AllocSetContextCreate(CurrentMemoryContext,
+	                                    "odbc_fdw benchmark row",
+	                                    ALLOCSET_DEFAULT_SIZES);
+
+	for (;;)
+	{
+		CHECK_FOR_INTERRUPTS();
+		if (timer->phase != BENCH_PHASE_FETCH && odbcResultBufferNeedsFetch(&result))
+			odbcBenchmarkSwitch(timer, BENCH_PHASE_FETCH);
+		if (!odbcResultBufferNext(&result))
+			break;
+		if (mode == BENCH_FETCH)
+			continue;
+
+		if (timer->phase != BENCH_PHASE_CONVERT)
+			odbcBenchmarkSwitch(timer, BENCH_PHASE_CONVERT);
+		old_context = MemoryContextSwitchTo(row_context);
+		for (i = 0; i < result.num_cols; i++)
+		{
+			char *value = odbcResultBufferValue(&result, i, NULL);
+
+			if (value != NULL && mode == BENCH_DATUM)
+				(void) odbcConvertValue(&converters[i], value);
+		}
+		MemoryContextSwitchTo(old_context);
+		MemoryContextReset(row_context);
+	}
+	odbcBenchmarkSwitch(timer, BENCH_PHASE_FETCH);
+
+	odbcStatsReport(&options, InvalidOid, sql_query, 1, result.rows, result.bytes,
+	                timer->wall_ms[BENCH_PHASE_EXECUTE] + timer->wall_ms[BENCH_PHASE_FETCH]);
+	*rows = result.rows;
+	*bytes = result.bytes;
+	odbcResultBufferEnd(&result);
+	MemoryContextDelete(row_context);
+	odbcFreeServerQuery(env, dbc, stmt);
+}
+
+Datum
+odbc_fdw_benchmark(PG_FUNCTION_ARGS)
+{
+	char   *server_name = text_to_cstring(PG_GETARG_TEXT_PP(0));
+	char   *sql_query = text_to_cstring(PG_GETARG_TEXT_PP(1));
+	int32   fetch_size = PG_GETARG_INT32(2);
+	char   *mode_name = text_to_cstring(PG_GETARG_TEXT_PP(3));
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	BenchmarkMode mode;
+	odbcBenchmarkClock timer;
+	uint64 rows;
+	uint64 bytes;
+	MemoryContext old_context;
+	TupleDesc tupdesc;
+	Tuplestorestate *tupstore;
+	double total_wall_ms = 0;
+	double total_cpu_ms = 0;
+	int i;
+
+	elog_debug("%s", __func__);
+
+	if (pg_strcasecmp(mode_name, "fetch") == 0)
+		mode = BENCH_FETCH;
+	else if (pg_strcasecmp(mode_name, "text") == 0)
+		mode = BENCH_TEXT;
+	else if (pg_strcasecmp(mode_name, "datum") == 0)
+		mode = BENCH_DATUM;
+	else
+		ereport(ERROR,
+		        (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+		         errmsg("benchmark mode \"%s\" not supported", mode_name),
+		         errhint("Valid modes are: fetch, text, datum")));
+
+	if (fetch_size < 1)
+		ereport(ERROR,
+		        (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+		         errmsg("fetch_size must be a positive number")));
+
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+		        (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+		         errmsg("set-valued function called in context that cannot accept a set")));
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+		        (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+		         errmsg("materialize mode required, but it is not allowed in this context")));
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		ereport(ERROR,
+		        (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+		         errmsg("function returning record called in context "
+		                "that cannot accept type record")));
+
+	odbcBenchmarkQuery(server_name, sql_query, fetch_size, mode, &timer, &rows, &bytes);
+
+	old_context = MemoryContextSwitchTo(rsinfo->econtext->ecxt_per_query_memory);
+	tupdesc = CreateTupleDescCopy(tupdesc);
+	tupstore = tuplestore_begin_heap(rsinfo->allowedModes & SFRM_Materialize_Random, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+	MemoryContextSwitchTo(old_context);
+
+	for (i = 0; i < BENCH_NUM_PHASES; i++)
+	{
+		bool with_rows = (i == BENCH_PHASE_FETCH || i == BENCH_PHASE_CONVERT);
+
+		if (i == BENCH_PHASE_CONVERT && mode == BENCH_FETCH)
+			continue;
+		odbcBenchmarkPutRow(tupstore, tupdesc, benchmark_phase_names[i],
+		                    timer.wall_ms[i], timer.cpu_ms[i], with_rows, rows, bytes);
+		total_wall_ms += timer.wall_ms[i];
+		total_cpu_ms += timer.cpu_ms[i];
+	}
+	odbcBenchmarkPutRow(tupstore, tupdesc, "total", total_wall_ms, total_cpu_ms, true, rows, bytes);
+
+	return (Datum) 0;
+}
+
+/*
+ * Calibration of the cost options of a server
+ *
+ * odbc_fdw_calibrate(server, sql, store) reads the result of a sample
+ * query like a foreign scan does and derives the cost options from the
+ * times measured: fdw_startup_cost from the time to connect and execute
+ * the query, fdw_tuple_cost from the CPU time spent per row fetched and
+ * converted, and fdw_byte_cost from the rest of the fetch time (waiting
+ * for the driver and the network) per byte received. A cost unit is
+ * taken as CALIBRATION_MS_PER_COST_UNIT milliseconds, about the time of
+ * a sequential page read with the default seq_page_cost. Unless store
+ * is false, the options of the server are set to the values obtained.
+ */
+#define CALIBRATION_MS_PER_COST_UNIT 0.1
+
+static void
+odbcStoreCostOptions(char *server_name, const char **names, double *values, int count)
+{
+	ForeignServer *server = GetForeignServerByName(server_name, false);
+	StringInfoData sql;
+	int ret;
+	int i;
+
+	initStringInfo(&sql);
+	appendStringInfo(&sql, "ALTER SERVER %s OPTIONS (", quote_identifier(server->servername));
+	for (i = 0; i < count; i++)
+	{
+		bool defined = false;
+		char value[64];
+		ListCell *lc;
+
+		foreach(lc, server->options)
+		{
+			if (strcmp(((DefElem *) lfirst(lc))->defname, names[i]) == 0)
+				defined = true;
+		}
+		snprintf(value, sizeof(value), "%g", values[i]);
+		appendStringInfo(&sql, "%s%s %s %s", i > 0 ? ", " : "", defined ? "SET" : "ADD",
+		                 names[i], quote_literal_cstr(value));
+	}
+	appendStringInfoChar(&sql, ')');
+
+	if ((ret = SPI_connect()) < 0)
+		elog(ERROR, "odbc_fdw_calibrate: SPI_connect returned %d", ret);
+	if ((ret = SPI_execute(sql.data, false, 0)) != SPI_OK_UTILITY)
+		elog(ERROR, "odbc_fdw_calibrate: SPI_execute returned %d", ret);
+	SPI_finish();
+}
+
+Datum
+odbc_fdw_calibrate(PG_FUNCTION_ARGS)
+{
+	char   *server_name = text_to_cstring(PG_GETARG_TEXT_PP(0));
+	char   *sql_query = text_to_cstring(PG_GETARG_TEXT_PP(1));
+	bool    store = PG_GETARG_BOOL(2);
+	static const char *cost_options[] = { "fdw_startup_cost", "fdw_tuple_cost", "fdw_byte_cost" };
+	odbcBenchmarkClock timer;
+	uint64 rows;
+	uint64 bytes;
+	double costs[3];
+	double fetch_wait_ms;
+	TupleDesc tupdesc;
+	Datum values[7];
+	bool nulls[7] = { false, false, false, false, false, false, false };
+
+	elog_debug("%s", __func__);
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		ereport(ERROR,
+		        (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+		         errmsg("function returning record called in context "
+		                "that cannot accept type record")));
+
+	odbcBenchmarkQuery(server_name, sql_query, DEFAULT_FETCH_SIZE, BENCH_DATUM, &timer, &rows, &bytes);
+	if (rows == 0)
+		ereport(ERROR,
+		        (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+		         errmsg("the calibration query returned no rows"),
+		         errhint("Use a query that returns a representative number of rows, e.g. a table scan.")));
+
+	fetch_wait_ms = Max(timer.wall_ms[BENCH_PHASE_FETCH] - timer.cpu_ms[BENCH_PHASE_FETCH], 0);
+	costs[0] = (timer.wall_ms[BENCH_PHASE_CONNECT] + timer.wall_ms[BENCH_PHASE_EXECUTE]) / CALIBRATION_MS_PER_COST_UNIT;
+	costs[1] = (timer.cpu_ms[BENCH_PHASE_FETCH] + timer.cpu_ms[BENCH_PHASE_CONVERT]) / rows / CALIBRATION_MS_PER_COST_UNIT;
+	costs[2] = bytes > 0 ? fetch_wait_ms / bytes / CALIBRATION_MS_PER_COST_UNIT : 0;
+
+	if (store)
+		odbcStoreCostOptions(server_name, cost_options, costs, 3);
+
+	values[0] = Float8GetDatum(timer.wall_ms[BENCH_PHASE_CONNECT] + timer.wall_ms[BENCH_PHASE_EXECUTE]);
+	values[1] = Int64GetDatum((int64) rows);
+	values[2] = Int64GetDatum((int64) bytes);
+	values[3] = Float8GetDatum(fetch_wait_ms > 0 ? bytes * 1000.0 / fetch_wait_ms / (1024 * 1024) : 0);
+	nulls[3] = (fetch_wait_ms <= 0);
+	values[4] = Float8GetDatum(costs[0]);
+	values[5] = Float8GetDatum(costs[1]);
+	values[6] = Float8GetDatum(costs[2]);
+
+	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(BlessTupleDesc(tupdesc), values, nulls)));
+}
+
+/*
+ * Remote command execution
+ *
+ * odbc_execute(server, sql, transactional) executes the statements of
+ * the array sql on a cached connection to the data source of the server,
+ * in a single remote transaction unless transactional is false, and
+ * returns the number of rows affected by each statement (-1 when the
+ * driver doesn't know it). If the driver supports batches with explicit
+ * row counts the statements are sent in a single batch.
+ */
+static int64
+odbcStatementRowCount(SQLHSTMT stmt)
+{
+	SQLLEN rows = -1;
+
+	if (!SQL_SUCCEEDED(SQLRowCount(stmt, &rows)))
+		rows = -1;
+	return (int64) rows;
+}
+
+/*
+ * Execute the statements separately
+ */
+static void
+odbcExecuteEach(SQLHDBC dbc, odbcFdwOptions *options, char **statements, int count, int64 *row_counts)
+{
+	SQLHSTMT stmt;
+	SQLRETURN ret;
+	instr_time start;
+	instr_time duration;
+	int i;
+
+	odbcAllocHandle(SQL_HANDLE_STMT, dbc, &stmt);
+	odbcSetQueryTimeout(stmt, options);
+	odbcRegisterActiveStatement(stmt, options);
+	for (i = 0; i < count; i++)
+	{
+		CHECK_FOR_INTERRUPTS();
+		elog_debug("Executing statement: %s", statements[i]);
+		INSTR_TIME_SET_CURRENT(start);
+		ret = odbcExecDirect(stmt, (SQLCHAR *) statements[i], SQL_NTS);
+		if (ret == SQL_NO_DATA)
+			row_counts[i] = 0;
+		else
+		{
+			check_return(ret, "Executing ODBC statement", stmt, SQL_HANDLE_STMT);
+			row_counts[i] = odbcStatementRowCount(stmt);
+		}
+		INSTR_TIME_SET_CURRENT(duration);
+		INSTR_TIME_SUBTRACT(duration, start);
+		odbcStatsReport(options, InvalidOid, statements[i], 1, row_counts[i], 0, INSTR_TIME_GET_MILLISEC(duration));
+		SQLFreeStmt(stmt, SQL_CLOSE);
+	}
+	odbcFreeHandle(SQL_HANDLE_STMT, stmt);
+}
+
+/*
+ * Execute the statements as a single batch; the driver must report
+ * a row count for each of them
+ */
+static void
+odbcExecuteBatch(SQLHDBC dbc, odbcFdwOptions *options, char **statements, int count, int64 *row_counts)
+{
+	StringInfoData batch;
+	SQLHSTMT stmt;
+	SQLRETURN ret;
+	instr_time start;
+	instr_time duration;
+	int64 rows = 0;
+	int results = 0;
+	int i;
+
+	initStringInfo(&batch);
+	for (i = 0; i < count; i++)
+	{
+		if (i > 0)
+			appendStringInfoString(&batch, ";\n");
+		appendStringInfoString(&batch, statements[i]);
+	}
+	elog_debug("Executing batch: %s", batch.data);
+
+	odbcAllocHandle(SQL_HANDLE_STMT, dbc, &stmt);
+	odbcSetQueryTimeout(stmt, options);
+	odbcRegisterActiveStatement(stmt, options);
+	INSTR_TIME_SET_CURRENT(start);
+	ret = odbcExecDirect(stmt, (SQLCHAR *) batch.data, SQL_NTS);
+	while (ret != SQL_NO_DATA || results == 0)
+	{
+		if (ret == SQL_NO_DATA)
+			row_counts[results] = 0;
+		else
+		{
+			check_return(ret, "Executing ODBC statement", stmt, SQL_HANDLE_STMT);
+			if (results < count)
+			{
+				row_counts[results] = odbcStatementRowCount(stmt);
+				if (row_counts[results] > 0)
+					rows += row_counts[results];
+			}
+		}
+		results++;
+		ret = odbcMoreResults(stmt);
+	}
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, start);
+	odbcFreeHandle(SQL_HANDLE_STMT, stmt);
+	odbcStatsReport(options, InvalidOid, batch.data, count, rows, 0, INSTR_TIME_GET_MILLISEC(duration));
+
+	if (results != count)
+		ereport(ERROR,
+		        (errcode(ERRCODE_FDW_ERROR),
+		         errmsg("the ODBC driver returned %d results for a batch of %d statements", results, count)));
+}
+
+Datum
+odbc_execute(PG_FUNCTION_ARGS)
+{
+	char *server_name = text_to_cstring(PG_GETARG_TEXT_PP(0));
+	ArrayType *sql_array = PG_GETARG_ARRAYTYPE_P(1);
+	bool transactional = PG_GETARG_BOOL(2);
+	Oid serverid;
+	odbcFdwOptions options;
+	odbcConnCacheEntry *entry;
+	Datum *elements;
+	bool *element_nulls;
+	int count;
+	char **statements;
+	int64 *row_counts;
+	Datum *results;
+	SQLUINTEGER batch_support = 0;   /* SQL_BATCH_SUPPORT and SQL_BATCH_ROW_COUNT are 32-bit masks */
+	SQLUINTEGER batch_row_count = 0;
+	bool batch;
+	int i;
+
+	elog_debug("%s", __func__);
+
+	deconstruct_array(sql_array, TEXTOID, -1, false, 'i', &elements, &element_nulls, &count);
+	if (count == 0)
+		PG_RETURN_ARRAYTYPE_P(construct_empty_array(INT8OID));
+	statements = (char **) palloc(sizeof(char *) * count);
+	for (i = 0; i < count; i++)
+	{
+		if (element_nulls[i])
+			ereport(ERROR,
+			        (errcode(ERRCODE_NULL_VALUE_NOT_ALLOWED),
+			         errmsg("statements cannot be null")));
+		statements[i] = TextDatumGetCString(elements[i]);
+	}
+	row_counts = (int64 *) palloc0(sizeof(int64) * count);
+
+	serverid = GetForeignServerByName(server_name, false)->serverid;
+	odbcGetOptions(serverid, NIL, &options);
+	entry = odbcGetCachedConnection(serverid, &options);
+	/* Without autocommit in the session profile the statements must be committed anyway */
+	if (!odbc_autocommit(&options))
+		transactional = true;
+
+	/*
+	 * A batch is only sent inside a transaction: otherwise its statements
+	 * would already be committed when a mismatched result count is detected.
+	 * The driver must also report a separate row count for each statement.
+	 */
+	if (transactional && count > 1 &&
+	    SQL_SUCCEEDED(SQLGetInfo(entry->dbc, SQL_BATCH_SUPPORT, &batch_support, sizeof(batch_support), NULL)) &&
+	    SQL_SUCCEEDED(SQLGetInfo(entry->dbc, SQL_BATCH_ROW_COUNT, &batch_row_count, sizeof(batch_row_count), NULL)))
+		batch = (batch_support & SQL_BS_ROW_COUNT_EXPLICIT) != 0 &&
+		        (batch_row_count & SQL_BRC_EXPLICIT) != 0 &&
+		        (batch_row_count & SQL_BRC_ROLLED_UP) == 0;
+	else
+		batch = false;
+
+	PG_TRY();
+	{
+		if (transactional)
+			check_return(SQLSetConnectAttr(entry->dbc, SQL_ATTR_AUTOCOMMIT, (SQLPOINTER) SQL_AUTOCOMMIT_OFF, SQL_IS_UINTEGER),
+			             "Disabling autocommit", entry->dbc, SQL_HANDLE_DBC);
+		if (batch)
+			odbcExecuteBatch(entry->dbc, &options, statements, count, row_counts);
+		else
+			odbcExecuteEach(entry->dbc, &options, statements, count, row_counts);
+		if (transactional)
+		{
+			check_return(SQLEndTran(SQL_HANDLE_DBC, entry->dbc, SQL_COMMIT),
+			             "Committing remote transaction", entry->dbc, SQL_HANDLE_DBC);
+			/* The cached connection is kept in autocommit mode */
+			SQLSetConnectAttr(entry->dbc, SQL_ATTR_AUTOCOMMIT, (SQLPOINTER) SQL_AUTOCOMMIT_ON, SQL_IS_UINTEGER);
+		}
+	}
+	PG_CATCH();
+	{
+		/* The state of the connection is unknown: don't reuse it */
+		if (transactional)
+			SQLEndTran(SQL_HANDLE_DBC, entry->dbc, SQL_ROLLBACK);
+		odbcDisconnectCached(entry);
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+
+	results = (Datum *) palloc(sizeof(Datum) * count);
+	for (i = 0; i < count; i++)
+		results[i] = Int64GetDatum(row_counts[i]);
+	PG_RETURN_ARRAYTYPE_P(construct_array(results, count, INT8OID, sizeof(int64), FLOAT8PASSBYVAL, 'd'));
+}
+
+/*
+ * Import of the statistics maintained by the remote database
+ *
+ * odbc_fdw_import_stats(foreign_table) reads the per-column statistics
+ * of the remote table and stores them in pg_statistic, as ANALYZE would,
+ * together with the number of rows in pg_class.reltuples, so that the
+ * planner has accurate selectivities without sampling the remote table.
+ */
+typedef struct odbcColumnStats
+{
+	bool    found;
+	float4  null_frac;
+	int32   width;
+	float4  n_distinct;     /* Like pg_statistic.stadistinct: negative for a fraction of the rows */
+	char    *mcv_values;    /* Array literals, or NULL */
+	char    *mcv_freqs;
+	char    *histogram;
+	bool    has_correlation;
+	float4  correlation;
+} odbcColumnStats;
+
+/*
+ * Statistics of the local column whose remote name is column_name, or NULL
+ */
+static odbcColumnStats *
+odbcFindColumnStats(odbcColumnStats *stats, TupleDesc tupdesc, odbcFdwOptions *options, const char *column_name)
+{
+	int i;
+
+	for (i = 0; i < tupdesc->natts; i++)
+	{
+		Form_pg_attribute attr = TupleDescAttr(tupdesc, i);
+
+		if (!attr->attisdropped &&
+		    strcmp(remote_column_name(options, NameStr(attr->attname)), column_name) == 0)
+			return &stats[i];
+	}
+	return NULL;
+}
+
+static float4
+stats_float(char *value)
+{
+	return value ? (float4) strtod(value, NULL) : 0;
+}
+
+/*
+ * Statistics of a PostgreSQL table (psqlODBC), from the pg_stats view
+ */
+static void
+odbcImportPostgresStats(SQLHDBC dbc, odbcFdwOptions *options, TupleDesc tupdesc, odbcColumnStats *stats)
+{
+	const char *schema_name = get_schema_name(options);
+	StringInfoData sql;
+	SQLHSTMT stmt;
+	odbcResultBuffer result;
+
+	initStringInfo(&sql);
+	appendStringInfoString(&sql, "SELECT attname, null_frac, avg_width, n_distinct,"
+	                       " CAST(most_common_vals AS text), CAST(most_common_freqs AS text),"
+	                       " CAST(histogram_bounds AS text), correlation"
+	                       " FROM pg_catalog.pg_stats WHERE NOT inherited AND tablename = ");
+	appendQuotedString(&sql, options->table);
+	appendStringInfoString(&sql, " AND schemaname = ");
+	if (is_blank_string(schema_name))
+		appendStringInfoString(&sql, "current_schema()");
+	else
+		appendQuotedString(&sql, schema_name);
+
+	elog_debug("Statistics query: %s", sql.data);
+
+	odbcAllocHandle(SQL_HANDLE_STMT, dbc, &stmt);
+	check_return(odbcExecDirect(stmt, (SQLCHAR *) sql.data, SQL_NTS), "Executing ODBC query", stmt, SQL_HANDLE_STMT);
+	odbcResultBufferInit(&result, stmt, DEFAULT_FETCH_SIZE, get_encoding(options));
+	while (odbcResultBufferNext(&result))
+	{
+		odbcColumnStats *col = odbcFindColumnStats(stats, tupdesc, options, odbcResultBufferValue(&result, 0, NULL));
+		char *value;
+
+		if (col == NULL)
+			continue;
+		col->found = true;
+		col->null_frac = stats_float(odbcResultBufferValue(&result, 1, NULL));
+		col->width = (int32) stats_float(odbcResultBufferValue(&result, 2, NULL));
+		col->n_distinct = stats_float(odbcResultBufferValue(&result, 3, NULL));
+		if ((value = odbcResultBufferValue(&result, 4, NULL)) != NULL)
+			col->mcv_values = pstrdup(value);
+		if ((value = odbcResultBufferValue(&result, 5, NULL)) != NULL)
+			col->mcv_freqs = pstrdup(value);
+		if ((value = odbcResultBufferValue(&result, 6, NULL)) != NULL)
+			col->histogram = pstrdup(value);
+		if ((value = odbcResultBufferValue(&result, 7, NULL)) != NULL)
+		{
+			col->has_correlation = true;
+			col->correlation = stats_float(value);
+		}
+	}
+	odbcResultBufferEnd(&result);
+	odbcFreeHandle(SQL_HANDLE_STMT, stmt);
+}
+
+/*
+ * Append an element to an array literal
+ */
+static void
+appendArrayElement(StringInfo array, const char *value)
+{
+	const char *p;
+
+	appendStringInfoString(array, array->len == 0 ? "{\"" : ",\"");
+	for (p = value; *p; p++)
+	{
+		if (*p == '"' || *p == '\\')
+			appendStringInfoChar(array, '\\');
+		appendStringInfoChar(array, *p);
+	}
+	appendStringInfoChar(array, '"');
+}
+
+/*
+ * A step of a SQL Server histogram: the rows equal to its upper bound,
+ * and the rows between the previous upper bound and this one
+ */
+typedef struct odbcHistogramStep
+{
+	char   *high_key;
+	double  equal_rows;
+	double  range_rows;
+	bool    mcv;
+} odbcHistogramStep;
+
+/* Maximum number of most common values and of histogram bounds imported */
+#define SQLSERVER_STATS_TARGET 100
+
+static int
+histogram_step_cmp_equal_rows(const void *a, const void *b)
+{
+	const odbcHistogramStep *sa = *(odbcHistogramStep *const *) a;
+	const odbcHistogramStep *sb = *(odbcHistogramStep *const *) b;
+
+	if (sa->equal_rows > sb->equal_rows)
+		return -1;
+	return sa->equal_rows < sb->equal_rows ? 1 : 0;
+}
+
+/*
+ * Most common values and equi-depth histogram of a column from the
+ * steps of a SQL Server histogram, in which each step holds a different
+ * number of rows and so cannot be used as histogram bounds directly.
+ * Keys with many more equal rows than the average value become most
+ * common values, like in ANALYZE; the remaining rows, those equal to the
+ * other keys and those in the ranges between keys, are divided into
+ * bounds holding the same number of rows.
+ */
+static void
+odbcSQLServerHistogramStats(odbcColumnStats *col, odbcHistogramStep *steps, int num_steps,
+                            double rows, double distinct)
+{
+	odbcHistogramStep **by_equal_rows;
+	double *weights;
+	StringInfoData values;
+	StringInfoData freqs;
+	double nonnull_rows = 0;
+	double histogram_rows = 0;
+	double cumulative = 0;
+	double avg_rows;
+	int num_mcv = 0;
+	int num_bounds;
+	int bound;
+	int last_step = -1;
+	int written = 0;
+	int i;
+
+	for (i = 0; i < num_steps; i++)
+		nonnull_rows += steps[i].equal_rows + steps[i].range_rows;
+	if (num_steps == 0 || nonnull_rows <= 0)
+		return;
+
+	/* Most common values, by decreasing frequency */
+	avg_rows = nonnull_rows / Max(distinct, 1);
+	by_equal_rows = (odbcHistogramStep **) palloc(sizeof(odbcHistogramStep *) * num_steps);
+	for (i = 0; i < num_steps; i++)
+		by_equal_rows[i] = &steps[i];
+	qsort(by_equal_rows, num_steps, sizeof(odbcHistogramStep *), histogram_step_cmp_equal_rows);
+	initStringInfo(&values);
+	initStringInfo(&freqs);
+	for (i = 0; i < num_steps && num_mcv < SQLSERVER_STATS_TARGET; i++)
+	{
+		if (by_equal_rows[i]->equal_rows <= 1 || by_equal_rows[i]->equal_rows <= avg_rows * 1.25)
+			break;
+		by_equal_rows[i]->mcv = true;
+		appendArrayElement(&values, by_equal_rows[i]->high_key);
+		appendStringInfo(&freqs, "%s%g", num_mcv == 0 ? "{" : ",", by_equal_rows[i]->equal_rows / rows);
+		num_mcv++;
+	}
+	pfree(by_equal_rows);
+	if (num_mcv > 0)
+	{
+		appendStringInfoChar(&values, '}');
+		appendStringInfoChar(&freqs, '}');
+		col->mcv_values = values.data;
+		col->mcv_freqs = freqs.data;
+	}
+
+	/* Equi-depth bounds of the other rows */
+	weights = (double *) palloc(sizeof(double) * num_steps);
+	for (i = 0; i < num_steps; i++)
+	{
+		weights[i] = steps[i].range_rows + (steps[i].mcv ? 0 : steps[i].equal_rows);
+		histogram_rows += weights[i];
+	}
+	num_bounds = Min(num_steps, SQLSERVER_STATS_TARGET + 1);
+	if (num_bounds < 2 || histogram_rows <= 0)
+		return;
+
+	initStringInfo(&values);
+	i = 0;
+	for (bound = 0; bound < num_bounds; bound++)
+	{
+		double target = histogram_rows * bound / (num_bounds - 1);
+
+		/* The bound is the key of the first step whose rows reach the target */
+		while (i < num_steps - 1 && cumulative + weights[i] < target)
+			cumulative += weights[i++];
+		if (i == last_step)
+			continue;
+		appendArrayElement(&values, steps[i].high_key);
+		last_step = i;
+		written++;
+	}
+	pfree(weights);
+	if (written >= 2)
+	{
+		appendStringInfoChar(&values, '}');
+		col->histogram = values.data;
+	}
+}
+
+/*
+ * Statistics of a SQL Server table, from the histograms of the
+ * statistics objects whose leading column is each column of the table
+ */
+static void
+odbcImportSQLServerStats(SQLHDBC dbc, odbcFdwOptions *options, TupleDesc tupdesc, odbcColumnStats *stats)
+{
+	const char *schema_name = get_schema_name(options);
+	StringInfoData name;
+	StringInfoData sql;
+	SQLHSTMT stmt;
+	odbcResultBuffer result;
+	odbcColumnStats *col = NULL;
+	odbcHistogramStep *steps = NULL;
+	int num_steps = 0;
+	int max_steps = 0;
+	char *current_column = NULL;
+	char *current_stats = NULL;
+	double rows = 0, null_rows = 0, distinct = 0;
+
+	initStringInfo(&name);
+	appendSQLServerName(&name, schema_name, options->table);
+
+	initStringInfo(&sql);
+	appendStringInfoString(&sql, "SELECT c.name, CAST(s.stats_id AS varchar(20)),"
+	                       " CONVERT(nvarchar(4000), h.range_high_key, 126), h.equal_rows, h.range_rows, h.distinct_range_rows"
+	                       " FROM sys.stats s"
+	                       " JOIN sys.stats_columns sc ON sc.object_id = s.object_id AND sc.stats_id = s.stats_id AND sc.stats_column_id = 1"
+	                       " JOIN sys.columns c ON c.object_id = sc.object_id AND c.column_id = sc.column_id"
+	                       " CROSS APPLY sys.dm_db_stats_histogram(s.object_id, s.stats_id) h"
+	                       " WHERE s.object_id = OBJECT_ID(");
+	appendQuotedString(&sql, name.data);
+	appendStringInfoString(&sql, ") ORDER BY c.name, s.stats_id, h.step_number");
+
+	elog_debug("Statistics query: %s", sql.data);
+
+	odbcAllocHandle(SQL_HANDLE_STMT, dbc, &stmt);
+	check_return(odbcExecDirect(stmt, (SQLCHAR *) sql.data, SQL_NTS), "Executing ODBC query", stmt, SQL_HANDLE_STMT);
+	odbcResultBufferInit(&result, stmt, DEFAULT_FETCH_SIZE, get_encoding(options));
+	for (;;)
+	{
+		bool more = odbcResultBufferNext(&result);
+		char *column = more ? odbcResultBufferValue(&result, 0, NULL) : NULL;
+		char *stats_id = more ? odbcResultBufferValue(&result, 1, NULL) : NULL;
+		char *high_key;
+		double equal_rows;
+
+		/* Only the first statistics object of each column is used */
+		if (more && current_column && strcmp(column, current_column) == 0 &&
+		    strcmp(stats_id, current_stats) != 0)
+			continue;
+
+		if (!more || current_column == NULL || strcmp(column, current_column) != 0)
+		{
+			/* Finish the previous column */
+			if (col != NULL && rows > 0)
+			{
+				col->found = true;
+				col->null_frac = (float4) (null_rows / rows);
+				col->n_distinct = (float4) distinct;
+				odbcSQLServerHistogramStats(col, steps, num_steps, rows, distinct);
+			}
+			if (!more)
+				break;
+			col = odbcFindColumnStats(stats, tupdesc, options, column);
+			current_column = pstrdup(column);
+			current_stats = pstrdup(stats_id);
+			rows = null_rows = distinct = 0;
+			num_steps = 0;
+		}
+
+		high_key = odbcResultBufferValue(&result, 2, NULL);
+		equal_rows = stats_float(odbcResultBufferValue(&result, 3, NULL));
+		rows += equal_rows + stats_float(odbcResultBufferValue(&result, 4, NULL));
+		distinct += stats_float(odbcResultBufferValue(&result, 5, NULL));
+		if (high_key == NULL)
+			null_rows += equal_rows;
+		else
+		{
+			if (equal_rows > 0)
+				distinct += 1;
+			if (num_steps == max_steps)
+			{
+				max_steps = Max(max_steps * 2, 16);
+				steps = steps ? (odbcHistogramStep *) repalloc(steps, sizeof(odbcHistogramStep) * max_steps)
+				              : (odbcHistogramStep *) palloc(sizeof(odbcHistogramStep) * max_steps);
+			}
+			steps[num_steps].high_key = pstrdup(high_key);
+			steps[num_steps].equal_rows = equal_rows;
+			steps[num_steps].range_rows = stats_float(odbcResultBufferValue(&result, 4, NULL));
+			steps[num_steps].mcv = false;
+			num_steps++;
+		}
+	}
+	odbcResultBufferEnd(&result);
+	odbcFreeHandle(SQL_HANDLE_STMT, stmt);
+}
+
+/*
+ * Statistics of any other table: the number of distinct values of the
+ * columns with a single-column index, as reported by SQLStatistics
+ */
+static void
+odbcImportGenericStats(SQLHDBC dbc, odbcFdwOptions *options, TupleDesc tupdesc, odbcColumnStats *stats)
+{
+	const char *schema_name = get_schema_name(options);
+	SQLHSTMT stmt;
+	SQLRETURN ret;
+	odbcResultBuffer result;
+	char *index_name = NULL;
+	char *column = NULL;
+	char *cardinality = NULL;
+	bool unique = false;
+	int columns = 0;
+
+	odbcAllocHandle(SQL_HANDLE_STMT, dbc, &stmt);
+	odbcWaitStart(ODBC_WAIT_EXECUTE);
+	ret = SQLStatistics(stmt,
+	                    NULL, 0,
+	                    (SQLCHAR *) schema_name, schema_name ? SQL_NTS : 0,
+	                    (SQLCHAR *) options->table, SQL_NTS,
+	                    SQL_INDEX_ALL, SQL_QUICK);
+	odbcWaitEnd();
+	if (!SQL_SUCCEEDED(ret))
+	{
+		odbcFreeHandle(SQL_HANDLE_STMT, stmt);
+		return;
+	}
+
+	/*
+	 * Columns: 4 NON_UNIQUE, 6 INDEX_NAME, 7 TYPE, 8 ORDINAL_POSITION,
+	 * 9 COLUMN_NAME, 11 CARDINALITY; rows are ordered by index
+	 */
+	odbcResultBufferInit(&result, stmt, DEFAULT_FETCH_SIZE, get_encoding(options));
+	for (;;)
+	{
+		bool more = odbcResultBufferNext(&result);
+		char *type = more ? odbcResultBufferValue(&result, 6, NULL) : NULL;
+		char *name;
+
+		if (more && (type == NULL || atoi(type) == SQL_TABLE_STAT))
+			continue;
+		name = more ? odbcResultBufferValue(&result, 5, NULL) : NULL;
+
+		if (!more || index_name == NULL || name == NULL || strcmp(name, index_name) != 0)
+		{
+			/* Finish the previous index: only single-column indexes are useful */
+			if (columns == 1 && column != NULL)
+			{
+				odbcColumnStats *col = odbcFindColumnStats(stats, tupdesc, options, column);
+
+				if (col != NULL && (unique || cardinality != NULL))
+				{
+					col->found = true;
+					col->n_distinct = unique ? -1 : stats_float(cardinality);
+				}
+			}
+			if (!more)
+				break;
+			index_name = name ? pstrdup(name) : NULL;
+			columns = 0;
+			column = cardinality = NULL;
+		}
+
+		columns++;
+		if (columns == 1)
+		{
+			char *value = odbcResultBufferValue(&result, 3, NULL);
+
+			unique = value != NULL && atoi(value) == SQL_FALSE;
+			if ((value = odbcResultBufferValue(&result, 8, NULL)) != NULL)
+				column = pstrdup(value);
+			if ((value = odbcResultBufferValue(&result, 10, NULL)) != NULL)
+				cardinality = pstrdup(value);
+		}
+	}
+	odbcResultBufferEnd(&result);
+	odbcFreeHandle(SQL_HANDLE_STMT, stmt);
+}
+
+/*
+ * Array of values of a column type from an array literal
+ */
+static Datum
+stats_array(const char *literal, Oid typid, int32 typmod)
+{
+	return OidInputFunctionCall(F_ARRAY_IN, (char *) literal, typid, typmod);
+}
+
+/*
+ * Replace the pg_statistic entry of a column
+ */
+static void
+odbcStoreColumnStats(Relation rel, Form_pg_attribute attr, odbcColumnStats *col)
+{
+	Relation sd;
+	Datum values[Natts_pg_statistic];
+	bool nulls[Natts_pg_statistic];
+	bool replaces[Natts_pg_statistic];
+	HeapTuple oldtup;
+	HeapTuple stup;
+	Oid ltop = InvalidOid;
+	Oid eqop = InvalidOid;
+	int k = 0;
+	int i;
+
+	get_sort_group_operators(attr->atttypid, false, false, false, &ltop, &eqop, NULL, NULL);
+
+	memset(nulls, false, sizeof(nulls));
+	memset(replaces, true, sizeof(replaces));
+
+	values[Anum_pg_statistic_starelid - 1] = ObjectIdGetDatum(RelationGetRelid(rel));
+	values[Anum_pg_statistic_staattnum - 1] = Int16GetDatum(attr->attnum);
+	values[Anum_pg_statistic_stainherit - 1] = BoolGetDatum(false);
+	values[Anum_pg_statistic_stanullfrac - 1] = Float4GetDatum(col->null_frac);
+	values[Anum_pg_statistic_stawidth - 1] = Int32GetDatum(col->width > 0 ? col->width : get_typavgwidth(attr->atttypid, attr->atttypmod));
+	values[Anum_pg_statistic_stadistinct - 1] = Float4GetDatum(col->n_distinct);
+	for (i = 0; i < STATISTIC_NUM_SLOTS; i++)
+	{
+		values[Anum_pg_statistic_stakind1 - 1 + i] = Int16GetDatum(0);
+		values[Anum_pg_statistic_staop1 - 1 + i] = ObjectIdGetDatum(InvalidOid);
+		nulls[Anum_pg_statistic_stanumbers1 - 1 + i] = true;
+		nulls[Anum_pg_statistic_stavalues1 - 1 + i] = true;
+	}
+
+	if (col->mcv_values && col->mcv_freqs && OidIsValid(eqop))
+	{
+		values[Anum_pg_statistic_stakind1 - 1 + k] = Int16GetDatum(STATISTIC_KIND_MCV);
+		values[Anum_pg_statistic_staop1 - 1 + k] = ObjectIdGetDatum(eqop);
+		values[Anum_pg_statistic_stanumbers1 - 1 + k] = stats_array(col->mcv_freqs, FLOAT4OID, -1);
+		nulls[Anum_pg_statistic_stanumbers1 - 1 + k] = false;
+		values[Anum_pg_statistic_stavalues1 - 1 + k] = stats_array(col->mcv_values, attr->atttypid, attr->atttypmod);
+		nulls[Anum_pg_statistic_stavalues1 - 1 + k] = false;
+		k++;
+	}
+	if (col->histogram && OidIsValid(ltop))
+	{
+		values[Anum_pg_statistic_stakind1 - 1 + k] = Int16GetDatum(STATISTIC_KIND_HISTOGRAM);
+		values[Anum_pg_statistic_staop1 - 1 + k] = ObjectIdGetDatum(ltop);
+		values[Anum_pg_statistic_stavalues1 - 1 + k] = stats_array(col->histogram, attr->atttypid, attr->atttypmod);
+		nulls[Anum_pg_statistic_stavalues1 - 1 + k] = false;
+		k++;
+	}
+	if (col->has_correlation && OidIsValid(ltop))
+	{
+		Datum correlation = Float4GetDatum(col->correlation);
+		int16 typlen;
+		bool typbyval;
+		char typalign;
+
+		get_typlenbyvalalign(FLOAT4OID, &typlen, &typbyval, &typalign);
+
+		values[Anum_pg_statistic_stakind1 - 1 + k] = Int16GetDatum(STATISTIC_KIND_CORRELATION);
+		values[Anum_pg_statistic_staop1 - 1 + k] = ObjectIdGetDatum(ltop);
+		values[Anum_pg_statistic_stanumbers1 - 1 + k] =
+		    PointerGetDatum(construct_array(&correlation, 1, FLOAT4OID, typlen, typbyval, typalign));
+		nulls[Anum_pg_statistic_stanumbers1 - 1 + k] = false;
+		k++;
+	}
+
+	sd = heap_open(StatisticRelationId, RowExclusiveLock);
+	oldtup = SearchSysCache3(STATRELATTINH,
+	                         ObjectIdGetDatum(RelationGetRelid(rel)),
+	                         Int16GetDatum(attr->attnum),
+	                         BoolGetDatum(false));
+	if (HeapTupleIsValid(oldtup))
+	{
+		stup = heap_modify_tuple(oldtup, RelationGetDescr(sd), values, nulls, replaces);
+		ReleaseSysCache(oldtup);
+#if PG_VERSION_NUM >= 100000
+		CatalogTupleUpdate(sd, &stup->t_self, stup);
+#else
+		simple_heap_update(sd, &stup->t_self, stup);
+		CatalogUpdateIndexes(sd, stup);
+#endif
+	}
+	else
+	{
+		stup = heap_form_tuple(RelationGetDescr(sd), values, nulls);
+#if PG_VERSION_NUM >= 100000
+		CatalogTupleInsert(sd, stup);
+#else
+		simple_heap_insert(sd, stup);
+		CatalogUpdateIndexes(sd, stup);
+#endif
+	}
+	heap_freetuple(stup);
+	heap_close(sd, RowExclusiveLock);
+}
+
+/*
+ * Set the number of rows of a foreign table in pg_class
+ */
+static void
+odbcStoreTableRows(Relation rel, int64 rows)
+{
+	Relation pg_class = heap_open(RelationRelationId, RowExclusiveLock);
+	HeapTuple tuple = SearchSysCacheCopy1(RELOID, ObjectIdGetDatum(RelationGetRelid(rel)));
+
+	if (!HeapTupleIsValid(tuple))
+		elog(ERROR, "cache lookup failed for relation %u", RelationGetRelid(rel));
+	((Form_pg_class) GETSTRUCT(tuple))->reltuples = (float4) rows;
+#if PG_VERSION_NUM >= 100000
+	CatalogTupleUpdate(pg_class, &tuple->t_self, tuple);
+#else
+	simple_heap_update(pg_class, &tuple->t_self, tuple);
+	CatalogUpdateIndexes(pg_class, tuple);
+#endif
+	heap_freetuple(tuple);
+	heap_close(pg_class, RowExclusiveLock);
+}
+
+Datum
+odbc_fdw_import_stats(PG_FUNCTION_ARGS)
+{
+	Oid relid = PG_GETARG_OID(0);
+	Relation rel;
+	TupleDesc tupdesc;
+	odbcFdwOptions options;
+	odbcColumnStats *stats;
+	SQLHENV env;
+	SQLHDBC dbc;
+	int64 rows;
+	int imported = 0;
+	int i;
+
+	rel = heap_open(relid, ShareUpdateExclusiveLock);
+	if (rel->rd_rel->relkind != RELKIND_FOREIGN_TABLE)
+		ereport(ERROR,
+		        (errcode(ERRCODE_WRONG_OBJECT_TYPE),
+		         errmsg("\"%s\" is not a foreign table", RelationGetRelationName(rel))));
+	if (!pg_class_ownercheck(relid, GetUserId()))
+#if PG_VERSION_NUM >= 110000
+		aclcheck_error(ACLCHECK_NOT_OWNER, OBJECT_FOREIGN_TABLE, RelationGetRelationName(rel));
+#else
+		aclcheck_error(ACLCHECK_NOT_OWNER, ACL_KIND_CLASS, RelationGetRelationName(rel));
+#endif
+
+	odbcGetTableOptions(relid, &options);
+	if (!is_blank_string(options.sql_query) || is_blank_string(options.table))
+		ereport(ERROR,
+		        (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+		         errmsg("statistics can only be imported for foreign tables defined by a remote table")));
+
+	tupdesc = RelationGetDescr(rel);
+	stats = (odbcColumnStats *) palloc0(sizeof(odbcColumnStats) * Max(tupdesc->natts, 1));
+
+	odbc_connection(&options, &env, &dbc);
+	switch (odbcGetDialect(dbc))
+	{
+		case ODBC_DIALECT_POSTGRESQL:
+			odbcImportPostgresStats(dbc, &options, tupdesc, stats);
+			break;
+		case ODBC_DIALECT_SQLSERVER:
+			odbcImportSQLServerStats(dbc, &options, tupdesc, stats);
+			break;
+		default:
+			odbcImportGenericStats(dbc, &options, tupdesc, stats);
+			break;
+	}
+	if (odbcGetTableSizeOnConnection(dbc, &options, SIZE_ESTIMATE_AUTO, &rows))
+		odbcStoreTableRows(rel, rows);
+	odbcFreeHandle(SQL_HANDLE_DBC, dbc);
+	odbcFreeHandle(SQL_HANDLE_ENV, env);
+
+	for (i = 0; i < tupdesc->natts; i++)
+	{
+		if (stats[i].found)
+		{
+			odbcStoreColumnStats(rel, TupleDescAttr(tupdesc, i), &stats[i]);
+			imported++;
+		}
+	}
+
+	heap_close(rel, NoLock);
+	CommandCounterIncrement();
+
+	PG_RETURN_INT32(imported);
+}
+
+/*
+ * Get the list of tables for the current datasource
+ *
+ * ODBCTablesList(server, row_limit) returns the schema and name of
+ * the tables; the extended form
+ * ODBCTablesList(server, row_limit, schema_pattern, name_pattern, table_types, with_estimates)
+ * also returns the catalog, the type and, optionally, an estimate
+ * of the number of rows of each table.
+ */
+
+/* Columns returned by the extended form */
+#define TABLES_LIST_COLUMNS 5
+
+/*
+ * Number of rows of a table estimated by the data source
+ * (from the SQL_TABLE_STAT row of SQLStatistics), or -1 if unknown
+ */
+static int64
+odbcTableRowEstimate(SQLHDBC dbc, const char *catalog, const char *schema, const char *table)
+{
+	SQLHSTMT stmt;
+	SQLRETURN ret;
+	SQLSMALLINT type;
+	SQLLEN type_ind, cardinality_ind;
+	char cardinality[32];
+	int64 estimate = -1;
+
+	odbcAllocHandle(SQL_HANDLE_STMT, dbc, &stmt);
+	odbcWaitStart(ODBC_WAIT_EXECUTE);
+	ret = SQLStatistics(stmt,
+	                    (SQLCHAR *) catalog, catalog ? SQL_NTS : 0,
+	                    (SQLCHAR *) schema, schema ? SQL_NTS : 0,
+	                    (SQLCHAR *) table, SQL_NTS,
+	                    SQL_INDEX_ALL, SQL_QUICK);
+	odbcWaitEnd();
+	if (SQL_SUCCEEDED(ret))
+	{
+		/* Column 7: TYPE; column 11: CARDINALITY */
+		SQLBindCol(stmt, 7, SQL_C_SSHORT, &type, 0, &type_ind);
+		SQLBindCol(stmt, 11, SQL_C_CHAR, cardinality, sizeof(cardinality), &cardinality_ind);
+		while (SQL_SUCCEEDED(odbcFetch(stmt)))
+		{
+			if (type_ind != SQL_NULL_DATA && type == SQL_TABLE_STAT && cardinality_ind != SQL_NULL_DATA)
+			{
+				estimate = strtoll(cardinality, NULL, 10);
+				break;
+			}
+		}
+	}
+	odbcFreeHandle(SQL_HANDLE_STMT, stmt);
+
+	return estimate;
+}
+
+/*
+ * Add a row of the extended form of ODBCTablesList to its result
+ */
+static void
+odbcTablesListPutRow(Tuplestorestate *tupstore, TupleDesc tupdesc, char **values, int64 estimate)
+{
+	Datum datums[TABLES_LIST_COLUMNS];
+	bool  nulls[TABLES_LIST_COLUMNS];
+	int   i;
+
+	for (i = 0; i < TABLES_LIST_COLUMNS - 1; i++)
+	{
+		nulls[i] = values[i] == NULL;
+		datums[i] = nulls[i] ? (Datum) 0 : CStringGetTextDatum(values[i]);
+	}
+	nulls[TABLES_LIST_COLUMNS - 1] = estimate < 0;
+	datums[TABLES_LIST_COLUMNS - 1] = Int64GetDatum(estimate);
+
+	tuplestore_putvalues(tupstore, tupdesc, datums, nulls);
+}
+
+Datum
+odbc_tables_list(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext old_context;
+	bool extended = PG_NARGS() > 2;
+	char *server_name;
+	int32 row_limit;
+	char *schema_pattern = NULL;
+	char *name_pattern = NULL;
+	char *table_types = "TABLE";
+	bool with_estimates = false;
+	odbcFdwOptions options;
+	SQLHENV env;
+	SQLHDBC dbc;
+	SQLHSTMT stmt;
+	SQLRETURN ret;
+	odbcResultBuffer result;
+	List *rows = NIL;
+	ListCell *lc;
+	int64 count = 0;
+
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+		        (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+		         errmsg("set-valued function called in context that cannot accept a set")));
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+		        (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+		         errmsg("materialize mode required, but it is not allowed in this context")));
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		ereport(ERROR,
+		        (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+		         errmsg("function returning record called in context "
+		                "that cannot accept type record")));
+
+	if (PG_ARGISNULL(0))
+		ereport(ERROR,
+		        (errcode(ERRCODE_NULL_VALUE_NOT_ALLOWED),
+		         errmsg("server name must not be null")));
+	server_name = text_to_cstring(PG_GETARG_TEXT_PP(0));
+	row_limit = PG_ARGISNULL(1) ? 0 : PG_GETARG_INT32(1);
+	if (extended)
+	{
+		if (!PG_ARGISNULL(2))
+			schema_pattern = text_to_cstring(PG_GETARG_TEXT_PP(2));
+		if (!PG_ARGISNULL(3))
+			name_pattern = text_to_cstring(PG_GETARG_TEXT_PP(3));
+		table_types = PG_ARGISNULL(4) ? NULL : text_to_cstring(PG_GETARG_TEXT_PP(4));
+		with_estimates = !PG_ARGISNULL(5) && PG_GETARG_BOOL(5);
+	}
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	old_context = MemoryContextSwitchTo(per_query_ctx);
+	tupdesc = CreateTupleDescCopy(tupdesc);
+	tupstore = tuplestore_begin_heap(rsinfo->allowedModes & SFRM_Materialize_Random, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+	MemoryContextSwitchTo(old_context);
+
+	odbcGetOptions(oid_from_server_name(server_name), NIL, &options);
+	odbc_connection(&options, &env, &dbc);
+	odbcAllocHandle(SQL_HANDLE_STMT, dbc, &stmt);
+
+	odbcWaitStart(ODBC_WAIT_EXECUTE);
+	ret = SQLTables(stmt,
+	                NULL, 0,
+	                (SQLCHAR *) schema_pattern, schema_pattern ? SQL_NTS : 0,
+	                (SQLCHAR *) name_pattern, name_pattern ? SQL_NTS : 0,
+	                (SQLCHAR *) table_types, table_types ? SQL_NTS : 0);
+	odbcWaitEnd();
+	check_return(ret, "Obtaining ODBC tables", stmt, SQL_HANDLE_STMT);
+
+	odbcResultBufferInit(&result, stmt, DEFAULT_FETCH_SIZE, get_encoding(&options));
+	while ((row_limit <= 0 || count < row_limit) && odbcResultBufferNext(&result))
+	{
+		char *values[TABLES_LIST_COLUMNS];
+		int   i;
+
+		CHECK_FOR_INTERRUPTS();
+
+		if (!extended)
+		{
+			Datum   datums[2];
+			bool    nulls[2] = { false, false };
+			char   *schema = odbcResultBufferValue(&result, SQLTABLES_SCHEMA_COLUMN - 1, NULL);
+			char   *name = odbcResultBufferValue(&result, SQLTABLES_NAME_COLUMN - 1, NULL);
+
+			datums[0] = CStringGetTextDatum(schema ? schema : "");
+			datums[1] = CStringGetTextDatum(name ? name : "");
+			tuplestore_putvalues(tupstore, tupdesc, datums, nulls);
+			count++;
+			continue;
+		}
+
+		/* The first four columns of SQLTables: catalog, schema, name and type */
+		for (i = 0; i < TABLES_LIST_COLUMNS - 1; i++)
+			values[i] = odbcResultBufferValue(&result, i, NULL);
+
+		if (with_estimates)
+		{
+			/* Estimates need another statement, once the tables have been read */
+			char **row;
+
+			old_context = MemoryContextSwitchTo(per_query_ctx);
+			row = (char **) palloc0(sizeof(char *) * TABLES_LIST_COLUMNS);
+			for (i = 0; i < TABLES_LIST_COLUMNS - 1; i++)
+				row[i] = values[i] ? pstrdup(values[i]) : NULL;
+			rows = lappend(rows, row);
+			MemoryContextSwitchTo(old_context);
+		}
+		else
+		{
+			odbcTablesListPutRow(tupstore, tupdesc, values, -1);
+		}
+		count++;
+	}
+	odbcResultBufferEnd(&result);
+	odbcFreeHandle(SQL_HANDLE_STMT, stmt);
+
+	foreach(lc, rows)
+	{
+		char **values = (char **) lfirst(lc);
+
+		CHECK_FOR_INTERRUPTS();
+		odbcTablesListPutRow(tupstore, tupdesc, values,
+		                     odbcTableRowEstimate(dbc, values[0], values[1], values[2]));
+	}
+
+	odbcFreeHandle(SQL_HANDLE_DBC, dbc);
+	odbcFreeHandle(SQL_HANDLE_ENV, env);
+
+	return (Datum) 0;
+}
+
+/*
+ * get quals in the select if there is one
+ */
+static void
+odbcGetQual(Node *node, TupleDesc tupdesc, List *col_mapping_list, char **key, char **value, bool *pushdown)
+{
+	ListCell *col_mapping;
+	*key = NULL;
+	*value = NULL;
+	*pushdown = false;
+
+	elog_debug("%s", __func__);
+
+	if (!node)
+		return;
+
+	if (IsA(node, OpExpr))
+	{
+		OpExpr  *op = (OpExpr *) node;
+		Node    *left, *right;
+		Index   varattno;
+
+		if (list_length(op->args) != 2)
+			return;
+
+		left = list_nth(op->args, 0);
+		if (!IsA(left, Var))
+
+			return;
+
+		varattno = ((Var *) left)->varattno;
+
+		right = list_nth(op->args, 1);
+
+		if (IsA(right, Const))
+		{
+			StringInfoData  buf;
+			initStringInfo(&buf);
+			/* And get the column and value... */
+			*key = NameStr(TupleDescAttr(tupdesc, varattno - 1)->attname);
+
+			if (((Const *) right)->consttype == PROCID_TEXTCONST)
+				*value = TextDatumGetCString(((Const *) right)->constvalue);
+			else
+			{
+				return;
+			}
+
+			/* convert qual keys to mapped couchdb attribute name */
+			foreach(col_mapping, col_mapping_list)
+			{
+				DefElem *def = (DefElem *) lfirst(col_mapping);
+				if (strcmp(def->defname, *key) == 0)
+				{
+					*key = defGetString(def);
+					break;
+				}
+			}
+
+			/*
+			 * We can push down this qual if:
+			 * - The operatory is TEXTEQ
+			 * - The qual is on the _id column (in addition, _rev column can be also valid)
+			 */
+
+			if (op->opfuncid == PROCID_TEXTEQ)
+				*pushdown = true;
+
+			return;
+		}
+	}
+	return;
+}
+
+/*
+ * Check if the provided option is one of the valid options.
+ * context is the Oid of the catalog holding the object the option is for.
+ */
+static bool
+odbcIsValidOption(const char *option, Oid context)
+{
+	struct odbcFdwOption *opt;
+
+	elog_debug("%s", __func__);
+
+	/* Check if the options presents in the valid option list */
+	for (opt = valid_options; opt->optname; opt++)
+	{
+		if (context == opt->optcontext && strcmp(opt->optname, option) == 0)
+			return true;
+	}
+
+	/* ODBC attributes are valid in any context */
+	if (is_odbc_attribute(option))
+	{
+		return true;
+	}
+
+	/* Foreign table may have anything as a mapping option */
+	if (context == ForeignTableRelationId)
+		return true;
+	else
+		return false;
+}
+
+/*
+ * Conditions of the scan of a foreign table that are sent to the remote
+ * database: a single text equality, as chosen by odbcGetForeignPlan
+ */
+static List *
+odbcRemoteConditions(RelOptInfo *baserel, Oid foreigntableid, odbcFdwOptions *options)
+{
+	Relation rel;
+	List *remote_conds = NIL;
+	char *qual_key;
+	char *qual_value;
+	bool pushdown = false;
+	ListCell *lc;
+
+	if (!is_blank_string(options->sql_query))
+		return NIL;
+
+	rel = heap_open(foreigntableid, NoLock);
+	foreach(lc, baserel->baserestrictinfo)
+	{
+		RestrictInfo *rinfo = (RestrictInfo *) lfirst(lc);
+
+		odbcGetQual((Node *) rinfo->clause, RelationGetDescr(rel), options->mapping_list,
+		            &qual_key, &qual_value, &pushdown);
+		if (pushdown)
+		{
+			remote_conds = list_make1(rinfo);
+			break;
+		}
+	}
+	heap_close(rel, NoLock);
+
+	return remote_conds;
+}
+
+/*
+ * Average width of the rows returned by the remote query, which reads
+ * all the columns of the table; imported statistics are used if present
+ */
+static int
+odbcRemoteWidth(Oid foreigntableid)
+{
+	Relation rel;
+	TupleDesc tupdesc;
+	int width = 0;
+	int i;
+
+	rel = heap_open(foreigntableid, NoLock);
+	tupdesc = RelationGetDescr(rel);
+	for (i = 0; i < tupdesc->natts; i++)
+	{
+		Form_pg_attribute attr = TupleDescAttr(tupdesc, i);
+		int32 attr_width;
+
+		if (attr->attisdropped)
+			continue;
+		attr_width = get_attavgwidth(foreigntableid, attr->attnum);
+		if (attr_width <= 0)
+			attr_width = get_typavgwidth(attr->atttypid, attr->atttypmod);
+		width += attr_width;
+	}
+	heap_close(rel, NoLock);
+
+	return width;
+}
+
+/*
+ * SELECT statement of the scan of a foreign table, with the condition
+ * pushed down if any: a single text equality can be sent to the remote
+ * DBMS; all the quals are still checked locally
+ */
+static void
+odbcDeparseSelect(StringInfo sql, StringInfo remote_filter, Oid foreigntableid, odbcFdwOptions *options,
+                  List *clauses, const char *quote_char, const char *name_qualifier_char)
+{
+	Relation rel;
+	TupleDesc tupdesc;
+	const char *schema_name = get_schema_name(options);
+	char *qual_key = NULL;
+	char *qual_value = NULL;
+	bool pushdown = false;
+	bool first = true;
+	ListCell *lc;
+	int i;
+
+	initStringInfo(sql);
+	initStringInfo(remote_filter);
+	if (!is_blank_string(options->sql_query))
+	{
+		/* Use custom query if it's available */
+		appendStringInfoString(sql, options->sql_query);
+		return;
+	}
+
+	rel = heap_open(foreigntableid, NoLock);
+	tupdesc = RelationGetDescr(rel);
+
+	appendStringInfoString(sql, "SELECT ");
+	for (i = 0; i < tupdesc->natts; i++)
+	{
+		Form_pg_attribute attr = TupleDescAttr(tupdesc, i);
+
+		if (attr->attisdropped)
+			continue;
+		appendStringInfo(sql, first ? "%s%s%s" : ",%s%s%s", quote_char,
+		                 remote_column_name(options, NameStr(attr->attname)), quote_char);
+		first = false;
+	}
+	appendStringInfoString(sql, " FROM ");
+	if (!is_blank_string(schema_name))
+		appendStringInfo(sql, "%s%s%s%s", quote_char, schema_name, quote_char,
+		                 name_qualifier_char);
+	appendStringInfo(sql, "%s%s%s", quote_char, options->table, quote_char);
+
+	foreach(lc, clauses)
+	{
+		odbcGetQual((Node *) lfirst(lc), tupdesc, options->mapping_list, &qual_key, &qual_value, &pushdown);
+		if (pushdown)
+			break;
+	}
+	if (pushdown)
+	{
+		appendStringInfo(remote_filter, "%s%s%s = ", quote_char, qual_key, quote_char);
+		appendQuotedString(remote_filter, qual_value);
+		appendStringInfo(sql, " WHERE %s", remote_filter->data);
+	}
+
+	heap_close(rel, NoLock);
+}
+
+/*
+ * Remote estimates (use_remote_estimate)
+ *
+ * The remote query of a scan is explained by the remote database with
+ * the statement of its dialect, and the estimated number of rows (and,
+ * for PostgreSQL, whose costs are in our units, the costs) replace the
+ * local estimates. Estimates are cached until the end of the transaction,
+ * so that a table scanned several times with the same conditions, or a
+ * query planned again, costs a single round trip.
+ */
+typedef struct odbcRemoteEstimate
+{
+	Oid     serverid;
+	char    *sql;           /* Remote query explained */
+	bool    valid;          /* false if the remote database gave no estimate */
+	double  rows;
+	int     width;          /* 0 if unknown */
+	bool    has_costs;
+	Cost    startup_cost;
+	Cost    total_cost;
+} odbcRemoteEstimate;
+
+static List *RemoteEstimateCache = NIL;    /* In TopTransactionContext */
+
+/*
+ * Forget the cached estimates at the end of the transaction; their
+ * memory is freed with TopTransactionContext
+ */
+static void
+odbcResetRemoteEstimates(void)
+{
+	RemoteEstimateCache = NIL;
+}
+
+/*
+ * Read the estimates from the plan returned by the remote database
+ */
+static void
+odbcParseRemoteEstimate(SQLHSTMT stmt, odbcDialect dialect, odbcRemoteEstimate *est)
+{
+	odbcResultBuffer result;
+	StringInfoData plan;
+	int rows_col = -1;
+	int filtered_col = -1;
+	char *p;
+	char *next;
+	int i;
+
+	odbcResultBufferInit(&result, stmt, DEFAULT_FETCH_SIZE, -1);
+	for (i = 0; i < result.num_cols; i++)
+	{
+		if (pg_strcasecmp(result.columns[i].name, "rows") == 0)
+			rows_col = i;
+		else if (pg_strcasecmp(result.columns[i].name, "filtered") == 0)
+			filtered_col = i;
+	}
+
+	initStringInfo(&plan);
+	est->rows = 1;
+	while (odbcResultBufferNext(&result))
+	{
+		if (dialect == ODBC_DIALECT_MYSQL)
+		{
+			/* A row for each table read: the estimate of the join is their product */
+			char *rows = rows_col >= 0 ? odbcResultBufferValue(&result, rows_col, NULL) : NULL;
+			char *filtered = filtered_col >= 0 ? odbcResultBufferValue(&result, filtered_col, NULL) : NULL;
+
+			if (rows == NULL)
+				continue;
+			est->rows *= strtod(rows, NULL);
+			if (filtered != NULL)
+				est->rows *= strtod(filtered, NULL) / 100;
+			est->valid = true;
+		}
+		else
+		{
+			char *line = odbcResultBufferValue(&result, 0, NULL);
+
+			if (line != NULL)
+			{
+				appendStringInfoString(&plan, line);
+				appendStringInfoChar(&plan, '\n');
+			}
+		}
+	}
+	odbcResultBufferEnd(&result);
+
+	switch (dialect)
+	{
+		case ODBC_DIALECT_POSTGRESQL:
+			/* The first line shows the top node: "... (cost=0.00..35.50 rows=2550 width=36)" */
+			p = strstr(plan.data, "(cost=");
+			if (p && sscanf(p, "(cost=%lf..%lf rows=%lf width=%d",
+			                &est->startup_cost, &est->total_cost, &est->rows, &est->width) == 4)
+			{
+				est->has_costs = true;
+				est->valid = true;
+			}
+			break;
+		case ODBC_DIALECT_SQLSERVER:
+			p = strstr(plan.data, "StatementEstRows=\"");
+			if (p)
+			{
+				est->rows = strtod(p + strlen("StatementEstRows=\""), NULL);
+				est->valid = true;
+			}
+			break;
+		case ODBC_DIALECT_HIVE:
+			/* The statistics of the last operator: "Statistics: Num rows: 500 Data size: ..." */
+			for (p = strstr(plan.data, "Num rows: "); p; p = next)
+			{
+				est->rows = strtod(p + strlen("Num rows: "), NULL);
+				est->valid = true;
+				next = strstr(p + 1, "Num rows: ");
+			}
+			break;
+		default:
+			break;
+	}
+}
+
+/*
+ * Estimates of the remote database for the scan of a foreign table with
+ * the given conditions, from the cache or by explaining the remote query
+ */
+static odbcRemoteEstimate *
+odbcGetRemoteEstimate(Oid foreigntableid, odbcFdwOptions *options, List *clauses)
+{
+	Oid serverid = GetForeignTable(foreigntableid)->serverid;
+	StringInfoData quote_char;
+	StringInfoData name_qualifier_char;
+	StringInfoData sql;
+	StringInfoData remote_filter;
+	StringInfoData explain;
+	odbcRemoteEstimate *est;
+	MemoryContext old_context;
+	odbcDialect dialect;
+	SQLHENV env;
+	SQLHDBC dbc;
+	SQLHSTMT stmt;
+	ListCell *lc;
+
+	odbcGetServerQuoting(serverid, options, NULL, &quote_char, &name_qualifier_char);
+	odbcDeparseSelect(&sql, &remote_filter, foreigntableid, options, clauses,
+	                  quote_char.data, name_qualifier_char.data);
+
+	foreach(lc, RemoteEstimateCache)
+	{
+		est = (odbcRemoteEstimate *) lfirst(lc);
+		if (est->serverid == serverid && strcmp(est->sql, sql.data) == 0)
+			return est;
+	}
+
+	old_context = MemoryContextSwitchTo(TopTransactionContext);
+	est = (odbcRemoteEstimate *) palloc0(sizeof(odbcRemoteEstimate));
+	est->serverid = serverid;
+	est->sql = pstrdup(sql.data);
+	MemoryContextSwitchTo(old_context);
+
+	odbc_connection(options, &env, &dbc);
+	dialect = odbcGetDialect(dbc);
+
+	initStringInfo(&explain);
+	switch (dialect)
+	{
+		case ODBC_DIALECT_POSTGRESQL:
+		case ODBC_DIALECT_MYSQL:
+		case ODBC_DIALECT_HIVE:
+			appendStringInfo(&explain, "EXPLAIN %s", sql.data);
+			break;
+		case ODBC_DIALECT_SQLSERVER:
+			/* Queries return their plan instead of being executed while SHOWPLAN_XML is on */
+			appendStringInfoString(&explain, sql.data);
+			break;
+		default:
+			elog_debug("%s: remote estimates are not available for this data source", __func__);
+			break;
+	}
+
+	if (explain.len > 0)
+	{
+		SQLRETURN ret = SQL_SUCCESS;
+
+		odbcAllocHandle(SQL_HANDLE_STMT, dbc, &stmt);
+		odbcSetQueryTimeout(stmt, options);
+		if (dialect == ODBC_DIALECT_SQLSERVER)
+		{
+			ret = odbcExecDirect(stmt, (SQLCHAR *) "SET SHOWPLAN_XML ON", SQL_NTS);
+			SQLFreeStmt(stmt, SQL_CLOSE);
+		}
+		if (SQL_SUCCEEDED(ret))
+		{
+			elog_debug("Explaining remote query: %s", explain.data);
+			ret = odbcExecDirect(stmt, (SQLCHAR *) explain.data, SQL_NTS);
+		}
+		if (SQL_SUCCEEDED(ret))
+			odbcParseRemoteEstimate(stmt, dialect, est);
+		else
+			elog_debug("%s: the remote query could not be explained", __func__);
+		/* The connection is closed, so SHOWPLAN_XML needn't be turned off */
+		odbcFreeHandle(SQL_HANDLE_STMT, stmt);
+	}
+	odbcFreeHandle(SQL_HANDLE_DBC, dbc);
+	odbcFreeHandle(SQL_HANDLE_ENV, env);
+
+	/* Failures are cached too, so that they aren't retried */
+	old_context = MemoryContextSwitchTo(TopTransactionContext);
+	RemoteEstimateCache = lappend(RemoteEstimateCache, est);
+	MemoryContextSwitchTo(old_context);
+
+	return est;
+}
+
+static void odbcGetForeignRelSize(PlannerInfo *root, RelOptInfo *baserel, Oid foreigntableid)
+{
+	int64 table_size = 0;
+	odbcFdwOptions options;
+	odbcFdwRelationInfo *fpinfo;
+	List *remote_conds;
+	SizeEstimateMode mode;
+	SQLHENV env;
+	SQLHDBC dbc;
+
+	elog_debug("%s", __func__);
+
+	/* Fetch the foreign table options */
+	odbcGetTableOptions(foreigntableid, &options);
+	mode = options.size_estimate_mode ? size_estimate_mode_from_name(options.size_estimate_mode) : SIZE_ESTIMATE_AUTO;
+
+	fpinfo = (odbcFdwRelationInfo *) palloc0(sizeof(odbcFdwRelationInfo));
+	fpinfo->startup_cost = option_cost_value("fdw_startup_cost", options.fdw_startup_cost, DEFAULT_FDW_STARTUP_COST);
+	fpinfo->tuple_cost = option_cost_value("fdw_tuple_cost", options.fdw_tuple_cost, DEFAULT_FDW_TUPLE_COST);
+	fpinfo->byte_cost = option_cost_value("fdw_byte_cost", options.fdw_byte_cost, DEFAULT_FDW_BYTE_COST);
+	fpinfo->remote_width = odbcRemoteWidth(foreigntableid);
+	baserel->fdw_private = fpinfo;
+	remote_conds = odbcRemoteConditions(baserel, foreigntableid, &options);
+
+	if (option_bool_value(options.use_remote_estimate, false))
+	{
+		odbcRemoteEstimate *est = odbcGetRemoteEstimate(foreigntableid, &options,
+		                                                extract_actual_clauses(baserel->baserestrictinfo, false));
+
+		if (est->valid)
+		{
+			fpinfo->remote_rows = clamp_row_est(est->rows);
+			if (est->width > 0)
+				fpinfo->remote_width = est->width;
+			fpinfo->has_remote_costs = est->has_costs;
+			fpinfo->remote_startup_cost = est->startup_cost;
+			fpinfo->remote_total_cost = est->total_cost;
+			if (baserel->tuples <= 0)
+				baserel->tuples = fpinfo->remote_rows;
+			/* The remote estimate already accounts for the condition pushed down */
+			baserel->rows = clamp_row_est(fpinfo->remote_rows *
+			                              clauselist_selectivity(root, list_difference_ptr(baserel->baserestrictinfo, remote_conds),
+			                                                     0, JOIN_INNER, NULL));
+			return;
+		}
+	}
+
+	/*
+	 * With statistics imported by odbc_fdw_import_stats the local
+	 * selectivity estimates are meaningful, and the remote database
+	 * needn't be asked for the size of the table
+	 */
+	if (mode != SIZE_ESTIMATE_AUTO || baserel->tuples <= 0)
+	{
+		/*
+		 * Prefer the cheap estimates of the remote database to counting the
+		 * rows; the connection also provides the quoting for odbcGetForeignPlan
+		 */
+		odbc_connection(&options, &env, &dbc);
+		odbcGetServerQuoting(GetForeignTable(foreigntableid)->serverid, &options, dbc, NULL, NULL);
+		odbcGetTableSizeOnConnection(dbc, &options, mode, &table_size);
+		odbcFreeHandle(SQL_HANDLE_DBC, dbc);
+		odbcFreeHandle(SQL_HANDLE_ENV, env);
+
+		baserel->tuples = table_size;
+	}
+
+	/*
+	 * The remote database only applies the condition pushed down;
+	 * all the conditions are checked again locally
+	 */
+	fpinfo->remote_rows = clamp_row_est(baserel->tuples *
+	                                    clauselist_selectivity(root, remote_conds, 0, JOIN_INNER, NULL));
+	baserel->rows = clamp_row_est(baserel->tuples *
+	                              clauselist_selectivity(root, baserel->baserestrictinfo, 0, JOIN_INNER, NULL));
+}
+
+/*
+ * Cost of a foreign scan: the startup cost of the server, the transfer
+ * of the remote rows, by row and by byte, and the local evaluation of
+ * the conditions on each of them
+ */
+static void odbcEstimateCosts(PlannerInfo *root, RelOptInfo *baserel, Cost *startup_cost, Cost *total_cost, Oid foreigntableid)
+{
+	odbcFdwRelationInfo *fpinfo = (odbcFdwRelationInfo *) baserel->fdw_private;
+	QualCost qual_cost;
+
+	elog_debug("----> starting %s", __func__);
+
+	cost_qual_eval(&qual_cost, baserel->baserestrictinfo, root);
+
+	*startup_cost = fpinfo->startup_cost + qual_cost.startup;
+	*total_cost = *startup_cost +
+	              fpinfo->remote_rows * (fpinfo->tuple_cost + fpinfo->remote_width * fpinfo->byte_cost) +
+	              fpinfo->remote_rows * (cpu_tuple_cost + qual_cost.per_tuple);
+
+	/* The costs of a remote PostgreSQL are in the same units */
+	if (fpinfo->has_remote_costs)
+	{
+		*startup_cost += fpinfo->remote_startup_cost;
+		*total_cost += fpinfo->remote_total_cost;
+	}
+
+	elog_debug("----> finishing %s", __func__);
+}
+
+static void odbcGetForeignPaths(PlannerInfo *root, RelOptInfo *baserel, Oid foreigntableid)
+{
+	Cost startup_cost;
+	Cost total_cost;
+
+	elog_debug("----> starting %s", __func__);
+
+	odbcEstimateCosts(root, baserel, &startup_cost, &total_cost, foreigntableid);
+
+	add_path(baserel,
+	         (Path *) create_foreignscan_path(root, baserel,
+#if PG_VERSION_NUM >= 90600
+	                 NULL, /* PathTarget */
+#endif
+	                 baserel->rows,
+	                 startup_cost,
+	                 total_cost,
+	                 NIL, /* no pathkeys */
+	                 NULL, /* no outer rel either */
+	                 NULL, /* no extra plan */
+	                 NIL /* no fdw_private list */));
+
+	elog_debug("----> finishing %s", __func__);
+}
+
+static bool odbcAnalyzeForeignTable(Relation relation, AcquireSampleRowsFunc *func, BlockNumber *totalpages)
+{
+	elog_debug("----> starting %s", __func__);
+	elog_debug("----> finishing %s", __func__);
+
+	return false;
+}
+
+static ForeignScan* odbcGetForeignPlan(PlannerInfo *root, RelOptInfo *baserel,
+                                       Oid foreigntableid, ForeignPath *best_path, List *tlist, List *scan_clauses, Plan *outer_plan)
+{
+	Index scan_relid = baserel->relid;
+	odbcFdwOptions options;
+	StringInfoData quote_char;
+	StringInfoData name_qualifier_char;
+	StringInfoData sql;
+	StringInfoData remote_filter;
+
+	elog_debug("----> starting %s", __func__);
+
+	scan_clauses = extract_actual_clauses(scan_clauses, false);
+
+	odbcGetTableOptions(foreigntableid, &options);
+	odbcGetServerQuoting(GetForeignTable(foreigntableid)->serverid, &options, NULL,
+	                     &quote_char, &name_qualifier_char);
+
+	/*
+	 * Construct the SQL statement used for remote querying, so that
+	 * EXPLAIN can show it without executing it. The quoting characters
+	 * are normally cached by odbcGetForeignRelSize; only when it did not
+	 * connect, and the server was never used, is a connection opened here.
+	 */
+	odbcDeparseSelect(&sql, &remote_filter, foreigntableid, &options, scan_clauses,
+	                  quote_char.data, name_qualifier_char.data);
+
+	elog_debug("----> finishing %s", __func__);
+
+	return make_foreignscan(tlist, scan_clauses,
+	                        scan_relid, NIL,
+	                        list_make2(makeString(sql.data), makeString(remote_filter.data)),
+	                        NIL /* fdw_scan_tlist */, NIL, /* fdw_recheck_quals */
+	                        NULL /* outer_plan */ );
+}
+
+/*
+ * odbcBeginForeignScan
+ *
+ */
+static void
+odbcBeginForeignScan(ForeignScanState *node, int eflags)
+{
+	ForeignScan *fsplan = (ForeignScan *) node->ss.ps.plan;
+	SQLHENV env;
+	SQLHDBC dbc;
+	odbcFdwExecutionState   *festate;
+	SQLSMALLINT result_columns;
+	SQLHSTMT stmt;
+	SQLRETURN ret;
+	instr_time start;
+	instr_time duration;
+
+	odbcFdwOptions options;
+
+	Relation rel;
+	int num_of_columns;
+	StringInfoData *columns;
+	int i;
+	ListCell *col_mapping;
+	char *sql;
+
+	int encoding = -1;
+
+	elog_debug("%s", __func__);
+
+	/* The remote query has been built by odbcGetForeignPlan */
+	sql = strVal(linitial(fsplan->fdw_private));
+
+	/* EXPLAIN shows the query from the plan: don't connect */
+	if (eflags & EXEC_FLAG_EXPLAIN_ONLY)
+		return;
+
+	/* Fetch the foreign table options */
+	odbcGetTableOptions(RelationGetRelid(node->ss.ss_currentRelation), &options);
+
+	festate = (odbcFdwExecutionState *) palloc0(sizeof(odbcFdwExecutionState));
+	/* Timings are needed by EXPLAIN ANALYZE, the shared statistics and the slow scan log */
+	festate->metrics.enabled = (node->ss.ps.instrument != NULL || odbcStatsEnabled() ||
+	                            odbc_log_min_remote_duration >= 0);
+
+	if (!is_blank_string(options.encoding))
+	{
+		encoding = pg_char_to_encoding(options.encoding);
+		if (encoding < 0)
+		{
+			ereport(ERROR,
+			        (errcode(ERRCODE_FDW_INVALID_ATTRIBUTE_VALUE),
+			         errmsg("invalid encoding name \"%s\"", options.encoding)
+			        ));
+		}
+	}
+
+	/* Fetch the table column info */
+	rel = heap_open(RelationGetRelid(node->ss.ss_currentRelation), AccessShareLock);
+	num_of_columns = rel->rd_att->natts;
+	columns = (StringInfoData *) palloc(sizeof(StringInfoData) * num_of_columns);
+	for (i = 0; i < num_of_columns; i++)
+	{
+		StringInfoData col;
+		StringInfoData mapping;
+		bool    mapped;
+
+		/* retrieve the column name */
+		initStringInfo(&col);
+		appendStringInfo(&col, "%s", NameStr(TupleDescAttr(rel->rd_att,i)->attname));
+		mapped = false;
+
+		/* check if the column name is mapping to a different name in remote table */
+		foreach(col_mapping, options.mapping_list)
+		{
+			DefElem *def = (DefElem *) lfirst(col_mapping);
+			if (strcmp(def->defname, col.data) == 0)
+			{
+				initStringInfo(&mapping);
+				appendStringInfo(&mapping, "%s", defGetString(def));
+				mapped = true;
+				break;
+			}
+		}
+
+		/* decide which name is going to be used */
+		if (mapped)
+			columns[i] = mapping;
+		else
+			columns[i] = col;
+	}
+	heap_close(rel, NoLock);
+
+	INSTR_TIME_SET_CURRENT(start);
+	odbc_connection(&options, &env, &dbc);
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, start);
+	festate->metrics.connect_ms = INSTR_TIME_GET_MILLISEC(duration);
+
+	/* Allocate a statement handle */
+	odbcAllocHandle(SQL_HANDLE_STMT, dbc, &stmt);
+	odbcSetQueryTimeout(stmt, &options);
+	odbcSetCursorMode(stmt, &options);
+	odbcRegisterActiveStatement(stmt, &options);
+
+	elog_debug("Executing query: %s", sql);
+
+	/* Retrieve a list of rows */
+	INSTR_TIME_SET_CURRENT(start);
+	odbc_probe2(execute_start, RelationGetRelid(node->ss.ss_currentRelation), sql);
+	ret = odbcExecDirect(stmt, (SQLCHAR *) sql, SQL_NTS);
+	odbc_probe2(execute_done, RelationGetRelid(node->ss.ss_currentRelation), ret);
+	check_return(ret, "Executing ODBC query", stmt, SQL_HANDLE_STMT);
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, start);
+	festate->metrics.execute_ms = INSTR_TIME_GET_MILLISEC(duration);
+	SQLNumResultCols(stmt, &result_columns);
+
+	festate->attinmeta = TupleDescGetAttInMetadata(node->ss.ss_currentRelation->rd_att);
+	copy_odbcFdwOptions(&(festate->options), &options);
+	festate->env = env;
+	festate->dbc = dbc;
+	festate->stmt = stmt;
+	festate->table_columns = columns;
+	festate->num_of_table_cols = num_of_columns;
+	/* prepare for the first iteration, there will be some precalculation needed in the first iteration*/
+	festate->first_iteration = true;
+	festate->encoding = encoding;
+	festate->relid = RelationGetRelid(node->ss.ss_currentRelation);
+	festate->query = sql;
+	node->fdw_state = (void *) festate;
+}
+
+/*
+ * odbcIterateForeignScan
+ *
+ */
+static TupleTableSlot *
+odbcIterateForeignScan(ForeignScanState *node)
+{
+	EState *executor_state = node->ss.ps.state;
+	MemoryContext prev_context;
+	/* ODBC API return status */
+	SQLRETURN ret;
+	odbcFdwExecutionState *festate = (odbcFdwExecutionState *) node->fdw_state;
+	TupleTableSlot *slot = node->ss.ss_ScanTupleSlot;
+	SQLSMALLINT columns;
+	char    **values;
+	HeapTuple   tuple;
+	StringInfoData  col_data;
+	SQLHSTMT stmt = festate->stmt;
+	bool first_iteration = festate->first_iteration;
+	int num_of_table_cols = festate->num_of_table_cols;
+	int num_of_result_cols;
+	StringInfoData  *table_columns = festate->table_columns;
+	List *col_position_mask = NIL;
+	List *col_size_array = NIL;
+	List *col_conversion_array = NIL;
+	instr_time start;
+	instr_time duration;
+
+	elog_debug("%s", __func__);
+
+	if (festate->metrics.enabled)
+		INSTR_TIME_SET_CURRENT(start);
+
+	odbc_probe(fetch_start);
+	ret = odbcFetch(stmt);
+	odbc_probe1(fetch_done, SQL_SUCCEEDED(ret) ? 1 : 0);
+	festate->metrics.fetches++;
+
+	SQLNumResultCols(stmt, &columns);
+
+	/*
+	 * If this is the first iteration,
+	 * we need to calculate the mask for column mapping as well as the column size
+	 */
+	if (first_iteration == true)
+	{
+		SQLCHAR *ColumnName;
+		SQLSMALLINT NameLengthPtr;
+		SQLSMALLINT DataTypePtr;
+		SQLULEN     ColumnSizePtr;
+		SQLSMALLINT DecimalDigitsPtr;
+		SQLSMALLINT NullablePtr;
+		int i;
+		int k;
+		bool found;
+
+		StringInfoData sql_type;
+
+		/* Allocate memory for the masks in a memory context that
+		   persists between IterateForeignScan calls */
+		prev_context = MemoryContextSwitchTo(executor_state->es_query_cxt);
+		col_position_mask = NIL;
+		col_size_array = NIL;
+		col_conversion_array = NIL;
+		num_of_result_cols = columns;
+		/* Obtain the column information of the first row. */
+		for (i = 1; i <= columns; i++)
+		{
+			ColumnConversion conversion = TEXT_CONVERSION;
+			found = false;
+			ColumnName = (SQLCHAR *) palloc(sizeof(SQLCHAR) * MAXIMUM_COLUMN_NAME_LEN);
+			SQLDescribeCol(stmt,
+			               i,                       /* ColumnName */
+			               ColumnName,
+			               sizeof(SQLCHAR) * MAXIMUM_COLUMN_NAME_LEN, /* BufferLength */
+			               &NameLengthPtr,
+			               &DataTypePtr,
+			               &ColumnSizePtr,
+			               &DecimalDigitsPtr,
+			               &NullablePtr);
+
+			sql_data_type(DataTypePtr, ColumnSizePtr, DecimalDigitsPtr, NullablePtr, &sql_type);
+			if (strcmp("bytea", (char*)sql_type.data) == 0)
+			{
+				conversion = HEX_CONVERSION;
+			}
+			if (strcmp("boolean", (char*)sql_type.data) == 0)
+			{
+				conversion = BOOL_CONVERSION;
+			}
+			else if (strncmp("bit(",(char*)sql_type.data,4)==0 || strncmp("varbit(",(char*)sql_type.data,7)==0)
+			{
+				conversion = BIN_CONVERSION;
+			}
+
+			/* Get the position of the column in the FDW table */
+			for (k=0; k<num_of_table_cols; k++)
+			{
+				if (strcmp(table_columns[k].data, (char *) ColumnName) == 0)
+				{
+					SQLULEN min_size = minimum_buffer_size(DataTypePtr);
+					SQLULEN max_size = MAXIMUM_BUFFER_SIZE;
+					found = true;
+					col_position_mask = lappend_int(col_position_mask, k);
+					if (ColumnSizePtr < min_size)
+						ColumnSizePtr = min_size;
+					if (ColumnSizePtr > max_size)
+						ColumnSizePtr = max_size;
+
+					col_size_array = lappend_int(col_size_array, (int) ColumnSizePtr);
+					col_conversion_array = lappend_int(col_conversion_array, (int) conversion);
+					break;
+				}
+			}
+			/* if current column is not used by the foreign table */
+			if (!found)
+			{
+				col_position_mask = lappend_int(col_position_mask, -1);
+				col_size_array = lappend_int(col_size_array, -1);
+				col_conversion_array = lappend_int(col_conversion_array, 0);
+			}
+			pfree(ColumnName);
+		}
+		festate->num_of_result_cols = num_of_result_cols;
+		festate->col_position_mask = col_position_mask;
+		festate->col_size_array = col_size_array;
+		festate->col_conversion_array = col_conversion_array;
+		festate->first_iteration = false;
+
+		MemoryContextSwitchTo(prev_context);
+	}
+	else
+	{
+		num_of_result_cols = festate->num_of_result_cols;
+		col_position_mask = festate->col_position_mask;
+		col_size_array = festate->col_size_array;
+		col_conversion_array = festate->col_conversion_array;
+	}
+
+	ExecClearTuple(slot);
+	if (SQL_SUCCEEDED(ret))
+	{
+		SQLSMALLINT i;
+		values = (char **) palloc(sizeof(char *) * columns);
+
+		/* Loop through the columns */
+		for (i = 1; i <= columns; i++)
+		{
+			SQLLEN indicator;
+			char * buf;
+
+			int mask_index = i - 1;
+			int col_size = list_nth_int(col_size_array, mask_index);
+			int mapped_pos = list_nth_int(col_position_mask, mask_index);
+			ColumnConversion conversion = list_nth_int(col_conversion_array, mask_index);
+
+			/* Ignore this column if position is marked as invalid */
+			if (mapped_pos == -1)
+				continue;
+
+			buf = (char *) palloc(sizeof(char) * (col_size+1));
+
+			/* retrieve column data as a zero-terminated string */
+			/* TODO:
+			   binary fields (SQL_C_BIT, SQL_C_BINARY) do not have
+			   a trailing zero; they should be copied as now but without
+			   adding 1 to col_size, or using SQL_C_BIT or SQL_C_BINARY
+			   and then encoded into a binary PG literal (e.g. X'...'
+			   or B'...')
+			   For floating point types we should use SQL_C_FLOAT/SQL_C_DOUBLE
+			   to avoid precision loss.
+			   For date/time/timestamp these structures can be used:
+			   SQL_C_TYPE_DATE/SQL_C_TYPE_TIME/SQL_C_TYPE_TIMESTAMP.
+			   And finally, SQL_C_NUMERIC and SQL_C_GUID could also be used.
+			*/
+			buf[0] = 0;
+			ret = odbcGetData(stmt, i, SQL_C_CHAR,
+			                  buf, sizeof(char) * (col_size+1), &indicator);
+
+			if (ret == SQL_SUCCESS_WITH_INFO)
+			{
+				SQLCHAR sqlstate[5];
+				SQLGetDiagRec(SQL_HANDLE_STMT, stmt, 1, sqlstate, NULL, NULL, 0, NULL);
+				if (strcmp((char*)sqlstate, ODBC_SQLSTATE_FRACTIONAL_TRUNCATION) == 0)
+				{
+					/* Fractional truncation has occured;
+					 * at this point we cannot obtain the lost digits
+					 */
+					if (buf[col_size])
+					{
+						/* The driver has omitted the trailing */
+						char *buf2 = (char *) palloc(sizeof(char) * (col_size+2));
+						strncpy(buf2, buf, col_size+1);
+						buf2[col_size+1] = 0;
+						pfree(buf);
+						buf = buf2;
+					}
+					elog(NOTICE,"Truncating number: %s",buf);
+				}
+				else
+				{
+					/* The output is incomplete, we need to obtain the rest of the data */
+					char* accum_buffer;
+					size_t accum_buffer_size;
+					size_t accum_used = 0;
+					if (indicator == SQL_NO_TOTAL)
+					{
+						/* Unknown total size, must copy part by part */
+						accum_buffer_size = 0;
+						accum_buffer = NULL;
+						while (1)
+						{
+							size_t buf_len = buf[col_size] ? col_size + 1 : col_size;
+							// Allocate new accumulation buffer if necessary
+							if (accum_used + buf_len > accum_buffer_size)
+							{
+								char *new_buff;
+								accum_buffer_size = accum_buffer_size == 0 ? col_size*2 : accum_buffer_size*2;
+								new_buff = (char *) palloc(sizeof(char) * (accum_buffer_size+1));
+								if (accum_buffer)
+								{
+									memmove(new_buff, accum_buffer, accum_used);
+									pfree(accum_buffer);
+								}
+								accum_buffer = new_buff;
+								accum_buffer[accum_used] = 0;
+							}
+							// Copy part to the accumulation buffer
+							strncpy(accum_buffer+accum_used, buf, buf_len);
+							accum_used += buf_len;
+							accum_buffer[accum_used] = 0;
+							// Get new part
+							if (ret != SQL_SUCCESS_WITH_INFO)
+								break;
+							ret = odbcGetData(stmt, i, SQL_C_CHAR, buf, sizeof(char) * (col_size+1), &indicator);
+						};
+
+					}
+					else
+					{
+						/* We need to retrieve indicator more characters */
+						size_t buf_len = buf[col_size] ? col_size + 1 : col_size;
+						accum_buffer_size = buf_len + indicator;
+						accum_buffer = (char *) palloc(sizeof(char) * (accum_buffer_size+1));
+						strncpy(accum_buffer, buf, buf_len);
+						accum_buffer[buf_len] = 0;
+						ret = odbcGetData(stmt, i, SQL_C_CHAR, accum_buffer+buf_len, sizeof(char) * (indicator+1), &indicator);
+					}
+					pfree(buf);
+					buf = accum_buffer;
+				}
+			}
+
+			if (SQL_SUCCEEDED(ret))
+			{
+				/* Handle null columns */
+				if (indicator == SQL_NULL_DATA)
+				{
+					// BuildTupleFromCStrings expects NULLs to be NULL pointers
+					values[mapped_pos] = NULL;
+				}
+				else
+				{
+					if (festate->encoding != -1)
+					{
+						/* Convert character encoding */
+						buf = pg_any_to_server(buf, strlen(buf), festate->encoding);
+					}
+					initStringInfo(&col_data);
+					switch (conversion)
+					{
+					case TEXT_CONVERSION :
+						appendStringInfoString (&col_data, buf);
+						break;
+					case HEX_CONVERSION :
+						appendStringInfoString (&col_data, "\\x");
+						appendStringInfoString (&col_data, buf);
+						break;
+					case BOOL_CONVERSION :
+						if (buf[0] == 0)
+							strcpy(buf, "F");
+						else if (buf[0] == 1)
+							strcpy(buf, "T");
+						appendStringInfoString (&col_data, buf);
+						break;
+					case BIN_CONVERSION :
+						ereport(ERROR,
+						        (errcode(ERRCODE_FDW_INVALID_DATA_TYPE),
+						         errmsg("Bit string columns are not supported")
+						        ));
+						break;
+					}
+
+					values[mapped_pos] = col_data.data;
+					festate->metrics.bytes += col_data.len;
+					odbc_probe2(convert_column, i, col_data.len);
+				}
+			}
+			pfree(buf);
+		}
+
+		if (festate->metrics.enabled)
+		{
+			INSTR_TIME_SET_CURRENT(duration);
+			INSTR_TIME_SUBTRACT(duration, start);
+			festate->metrics.fetch_ms += INSTR_TIME_GET_MILLISEC(duration);
+			if (festate->metrics.rows == 0)
+				festate->metrics.first_row_ms = festate->metrics.execute_ms + festate->metrics.fetch_ms;
+			INSTR_TIME_SET_CURRENT(start);
+		}
+
+		odbc_probe(convert_start);
+		tuple = BuildTupleFromCStrings(festate->attinmeta, values);
+		ExecStoreTuple(tuple, slot, InvalidBuffer, false);
+		odbc_probe1(convert_done, festate->metrics.rows + 1);
+		pfree(values);
+		festate->metrics.rows++;
+
+		if (festate->metrics.enabled)
+		{
+			INSTR_TIME_SET_CURRENT(duration);
+			INSTR_TIME_SUBTRACT(duration, start);
+			festate->metrics.convert_ms += INSTR_TIME_GET_MILLISEC(duration);
+		}
+	}
+	else if (festate->metrics.enabled)
+	{
+		INSTR_TIME_SET_CURRENT(duration);
+		INSTR_TIME_SUBTRACT(duration, start);
+		festate->metrics.fetch_ms += INSTR_TIME_GET_MILLISEC(duration);
+	}
+
+	return slot;
+}
+
+/*
+ * odbcExplainForeignScan
+ *
+ */
+static void
+odbcExplainForeignScan(ForeignScanState *node, ExplainState *es)
+{
+	ForeignScan *fsplan = (ForeignScan *) node->ss.ps.plan;
+	odbcFdwExecutionState *festate;
+	char *remote_filter;
+
+	elog_debug("%s", __func__);
+
+	/* Everything comes from the plan: the remote database is not queried */
+	if (es->verbose)
+	{
+		ExplainPropertyText("Remote SQL", strVal(linitial(fsplan->fdw_private)), es);
+		remote_filter = strVal(lsecond(fsplan->fdw_private));
+		if (!is_blank_string(remote_filter))
+			ExplainPropertyText("Remote Filter", remote_filter, es);
+	}
+
+	/* if festate is NULL, we are in EXPLAIN without ANALYZE */
+	festate = (odbcFdwExecutionState *) node->fdw_state;
+	if (es->analyze && festate && festate->metrics.enabled)
+	{
+		odbcScanMetrics *metrics = &festate->metrics;
+
+		if (es->timing)
+		{
+			odbcExplainMilliseconds("Remote Connect Time", metrics->connect_ms, es);
+			odbcExplainMilliseconds("Remote Execute Time", metrics->execute_ms, es);
+			odbcExplainMilliseconds("Remote Fetch Time", metrics->fetch_ms, es);
+			odbcExplainMilliseconds("Conversion Time", metrics->convert_ms, es);
+		}
+#if PG_VERSION_NUM >= 110000
+		ExplainPropertyInteger("Remote Fetches", NULL, metrics->fetches, es);
+		ExplainPropertyInteger("Remote Rows", NULL, metrics->rows, es);
+		ExplainPropertyInteger("Remote Bytes", "B", metrics->bytes, es);
+#else
+		ExplainPropertyLong("Remote Fetches", (long) metrics->fetches, es);
+		ExplainPropertyLong("Remote Rows", (long) metrics->rows, es);
+		ExplainPropertyLong("Remote Bytes", (long) metrics->bytes, es);
+#endif
+	}
+}
+
+static void
+odbcExplainMilliseconds(const char *label, double value, ExplainState *es)
+{
+#if PG_VERSION_NUM >= 110000
+	ExplainPropertyFloat(label, "ms", value, 3, es);
+#else
+	ExplainPropertyFloat(label, value, 3, es);
+#endif
+}
+
+/*
+ * Log a foreign scan whose remote time exceeds odbc_fdw.log_min_remote_duration
+ */
+static void
+odbcLogSlowScan(odbcFdwExecutionState *festate)
+{
+	odbcScanMetrics *metrics = &festate->metrics;
+	double remote_ms;
+
+	if (odbc_log_min_remote_duration < 0 || !metrics->enabled)
+		return;
+	remote_ms = metrics->connect_ms + metrics->execute_ms + metrics->fetch_ms;
+	if (remote_ms < odbc_log_min_remote_duration)
+		return;
+
+	ereport(LOG,
+	        (errmsg("odbc_fdw: remote scan of server \"%s\" for foreign table %s: "
+	                "remote %.3f ms (connect %.3f ms, execute %.3f ms, first row %.3f ms, fetch %.3f ms), "
+	                "conversion %.3f ms, rows " INT64_FORMAT ", bytes " INT64_FORMAT ", query: %s",
+	                GetForeignServer(festate->options.serverid)->servername,
+	                quote_qualified_identifier(get_namespace_name(get_rel_namespace(festate->relid)),
+	                                           get_rel_name(festate->relid)),
+	                remote_ms, metrics->connect_ms, metrics->execute_ms, metrics->first_row_ms,
+	                metrics->fetch_ms, metrics->convert_ms, metrics->rows, metrics->bytes,
+	                festate->query),
+	         errhidestmt(true)));
+}
+
+/*
+ * odbcEndForeignScan
+ *      Finish scanning foreign table and dispose objects used for this scan
+ */
+static void
+odbcEndForeignScan(ForeignScanState *node)
+{
+	odbcFdwExecutionState *festate;
+
+	elog_debug("%s", __func__);
+
+	/* if festate is NULL, we are in EXPLAIN; nothing to do */
+	festate = (odbcFdwExecutionState *) node->fdw_state;
+	if (festate)
+	{
+		odbcStatsReport(&festate->options, festate->relid, festate->query, 1,
+		                festate->metrics.rows, festate->metrics.bytes,
+		                festate->metrics.execute_ms + festate->metrics.fetch_ms);
+		odbcLogSlowScan(festate);
+		if (festate->stmt)
+		{
+			/* Stop the remote query if the scan didn't read all the rows */
+			SQLCancel(festate->stmt);
+			odbcFreeHandle(SQL_HANDLE_STMT, festate->stmt);
+			festate->stmt = NULL;
+		}
+		odbcFreeHandle(SQL_HANDLE_DBC, festate->dbc);
+		festate->dbc = NULL;
+		odbcFreeHandle(SQL_HANDLE_ENV, festate->env);
+		festate->env = NULL;
+	}
+}
+
+/*
+ * odbcReScanForeignScan
+ *      Rescan table, possibly with new parameters
+ */
+static void
+odbcReScanForeignScan(ForeignScanState *node)
+{
+	elog_debug("%s", __func__);
+}
+
+/*
+ * Set GUC options so that values are output in formats remote
+ * data sources understand (ISO dates, full float precision).
+ * Returns the GUC nest level to pass to reset_transmission_modes.
+ */
+static int
+set_transmission_modes(void)
+{
+	int nestlevel = NewGUCNestLevel();
+
+	if (DateStyle != USE_ISO_DATES)
+		(void) set_config_option("datestyle", "ISO",
+		                         PGC_USERSET, PGC_S_SESSION,
+		                         GUC_ACTION_SAVE, true, 0, false);
+	if (IntervalStyle != INTSTYLE_POSTGRES)
+		(void) set_config_option("intervalstyle", "postgres",
+		                         PGC_USERSET, PGC_S_SESSION,
+		                         GUC_ACTION_SAVE, true, 0, false);
+	if (extra_float_digits < 3)
+		(void) set_config_option("extra_float_digits", "3",
+		                         PGC_USERSET, PGC_S_SESSION,
+		                         GUC_ACTION_SAVE, true, 0, false);
+
+	return nestlevel;
+}
+
+static void
+reset_transmission_modes(int nestlevel)
+{
+	AtEOXact_GUC(true, nestlevel);
+}
+
+/*
+ * Name of a column in the remote table, considering the column mapping options
+ */
+static const char *
+remote_column_name(odbcFdwOptions *options, const char *column_name)
+{
+	ListCell *col_mapping;
+
+	foreach(col_mapping, options->mapping_list)
+	{
+		DefElem *def = (DefElem *) lfirst(col_mapping);
+		if (strcmp(def->defname, column_name) == 0)
+			return defGetString(def);
+	}
+	return column_name;
+}
+
+static void
+appendQualifiedTableName(StringInfo str, odbcFdwOptions *options, const char *quote_char, const char *name_qualifier_char)
+{
+	const char *schema_name = get_schema_name(options);
+
+	if (!is_blank_string(schema_name))
+	{
+		appendStringInfo(str, "%s%s%s%s", quote_char, schema_name, quote_char, name_qualifier_char);
+	}
+	appendStringInfo(str, "%s%s%s", quote_char, options->table, quote_char);
+}
+
+/*
+ * odbcIsForeignRelUpdatable
+ *      Tables defined by a sql_query cannot be modified
+ *      (UPDATE and DELETE further require key columns, see odbcPlanForeignModify)
+ */
+static int
+odbcIsForeignRelUpdatable(Relation rel)
+{
+	odbcFdwOptions options;
+
+	elog_debug("%s", __func__);
+
+	/* Only the table options are relevant here */
+	extract_odbcFdwOptions(GetForeignTable(RelationGetRelid(rel))->options, &options);
+	if (!is_blank_string(options.sql_query) || is_blank_string(options.table))
+		return 0;
+
+	return (1 << CMD_INSERT) | (1 << CMD_UPDATE) | (1 << CMD_DELETE);
+}
+
+/*
+ * Attribute numbers of the key columns of a foreign table:
+ * those with the column option key set to true
+ */
+static List *
+odbcGetKeyAttrs(Relation rel)
+{
+	TupleDesc tupdesc = RelationGetDescr(rel);
+	List *key_attrs = NIL;
+	int attnum;
+
+	for (attnum = 1; attnum <= tupdesc->natts; attnum++)
+	{
+		ListCell *lc;
+
+		if (TupleDescAttr(tupdesc, attnum - 1)->attisdropped)
+			continue;
+
+		foreach(lc, GetForeignColumnOptions(RelationGetRelid(rel), attnum))
+		{
+			DefElem *def = (DefElem *) lfirst(lc);
+			if (strcmp(def->defname, "key") == 0 && defGetBoolean(def))
+				key_attrs = lappend_int(key_attrs, attnum);
+		}
+	}
+	return key_attrs;
+}
+
+/*
+ * odbcAddForeignUpdateTargets
+ *      Add the (old) values of the key columns as junk attributes
+ *      to identify the remote rows to be updated or deleted
+ */
+static void
+odbcAddForeignUpdateTargets(Query *parsetree, RangeTblEntry *target_rte, Relation target_relation)
+{
+	TupleDesc tupdesc = RelationGetDescr(target_relation);
+	ListCell *lc;
+
+	elog_debug("%s", __func__);
+
+	foreach(lc, odbcGetKeyAttrs(target_relation))
+	{
+		int attnum = lfirst_int(lc);
+		Form_pg_attribute attr = TupleDescAttr(tupdesc, attnum - 1);
+		char *name = psprintf(KEY_JUNK_ATTRIBUTE_NAME, attnum);
+		Var *var;
+
+		TargetEntry *tle;
+
+		var = makeVar(parsetree->resultRelation, attnum, attr->atttypid, attr->atttypmod, attr->attcollation, 0);
+		tle = makeTargetEntry((Expr *) var, list_length(parsetree->targetList) + 1, name, true);
+		parsetree->targetList = lappend(parsetree->targetList, tle);
+	}
+}
+
+/*
+ * odbcPlanForeignModify
+ *      All the columns of the table are sent in an INSERT,
+ *      and the updated ones in an UPDATE
+ */
+static List *
+odbcPlanForeignModify(PlannerInfo *root, ModifyTable *plan, Index resultRelation, int subplan_index)
+{
+	CmdType operation = plan->operation;
+	RangeTblEntry *rte = planner_rt_fetch(resultRelation, root);
+	Relation rel;
+	TupleDesc tupdesc;
+	List *target_attrs = NIL;
+	bool returning = (plan->returningLists != NIL);
+	int attnum;
+
+	elog_debug("%s", __func__);
+
+	rel = heap_open(rte->relid, NoLock);
+	tupdesc = RelationGetDescr(rel);
+
+	if (operation == CMD_INSERT)
+	{
+		for (attnum = 1; attnum <= tupdesc->natts; attnum++)
+		{
+			if (!TupleDescAttr(tupdesc, attnum - 1)->attisdropped)
+				target_attrs = lappend_int(target_attrs, attnum);
+		}
+	}
+	else if (operation == CMD_UPDATE || operation == CMD_DELETE)
+	{
+		int col = -1;
+
+		if (odbcGetKeyAttrs(rel) == NIL)
+			ereport(ERROR,
+			        (errcode(ERRCODE_FDW_UNABLE_TO_CREATE_EXECUTION),
+			         errmsg("foreign table \"%s\" has no key columns", RelationGetRelationName(rel)),
+			         errhint("Mark the columns that identify the remote rows with the column option key 'true'.")));
+
+		while (operation == CMD_UPDATE && (col = bms_next_member(rte->updatedCols, col)) >= 0)
+		{
+			attnum = col + FirstLowInvalidHeapAttributeNumber;
+			if (attnum <= InvalidAttrNumber)
+				elog(ERROR, "system-column update is not supported");
+			target_attrs = lappend_int(target_attrs, attnum);
+		}
+	}
+	else
+	{
+		ereport(ERROR,
+		        (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+		         errmsg("unexpected operation on foreign table: %d", (int) operation)));
+	}
+	heap_close(rel, NoLock);
+
+	return list_make2(target_attrs, makeInteger(returning ? 1 : 0));
+}
+
+/*
+ * Add a value to the current batch of parameter p
+ */
+static void
+odbcStoreModifyParam(odbcFdwModifyState *fmstate, int p, Datum value, bool isnull)
+{
+	int idx = p * fmstate->batch_size + fmstate->num_rows;
+
+	if (isnull)
+	{
+		fmstate->values[idx] = NULL;
+		fmstate->lengths[idx] = SQL_NULL_DATA;
+	}
+	else if (fmstate->conversions[p] == HEX_CONVERSION)
+	{
+		bytea *data = DatumGetByteaPP(value);
+		Size len = VARSIZE_ANY_EXHDR(data);
+
+		/*
+		 * A value that is not toasted points into the tuple of the slot,
+		 * which the executor reuses before the batch is sent: copy it
+		 * into the batch context, like the text of the other types
+		 */
+		fmstate->values[idx] = palloc(len + 1);
+		memcpy(fmstate->values[idx], VARDATA_ANY(data), len);
+		fmstate->lengths[idx] = len;
+	}
+	else if (fmstate->conversions[p] == BOOL_CONVERSION)
+	{
+		fmstate->values[idx] = DatumGetBool(value) ? "1" : "0";
+		fmstate->lengths[idx] = 1;
+	}
+	else
+	{
+		char *str = OutputFunctionCall(&fmstate->out_functions[p], value);
+		if (fmstate->encoding != -1)
+			str = (char *) pg_server_to_any(str, strlen(str), fmstate->encoding);
+		fmstate->values[idx] = str;
+		fmstate->lengths[idx] = strlen(str);
+	}
+}
+
+/*
+ * Add the values of a row to the current batch of parameters:
+ * the values of the target columns, from slot, followed by
+ * the values of the key columns, from the junk attributes of planSlot
+ */
+static void
+odbcStoreModifyRow(odbcFdwModifyState *fmstate, TupleTableSlot *slot, TupleTableSlot *planSlot)
+{
+	MemoryContext old_context = MemoryContextSwitchTo(fmstate->batch_context);
+	ListCell *lc;
+	int p = 0;
+	int k;
+	int nestlevel = set_transmission_modes();
+
+	foreach(lc, fmstate->target_attrs)
+	{
+		bool   isnull;
+		Datum  value = slot_getattr(slot, lfirst_int(lc), &isnull);
+
+		odbcStoreModifyParam(fmstate, p++, value, isnull);
+	}
+	for (k = 0; k < fmstate->num_keys; k++)
+	{
+		bool   isnull;
+		Datum  value = ExecGetJunkAttribute(planSlot, fmstate->key_junk_attnos[k], &isnull);
+
+		if (isnull)
+			ereport(ERROR,
+			        (errcode(ERRCODE_FDW_ERROR),
+			         errmsg("key column of foreign table \"%s\" is NULL", RelationGetRelationName(fmstate->rel))));
+		odbcStoreModifyParam(fmstate, p++, value, false);
+	}
+	fmstate->num_rows++;
+
+	reset_transmission_modes(nestlevel);
+	MemoryContextSwitchTo(old_context);
+}
+
+/*
+ * Execute the prepared statement for the rows of the current batch.
+ * The parameters are bound column-wise as arrays, so that a single
+ * SQLExecute sends the whole batch if the driver supports it.
+ */
+static void
+odbcFlushModifyBatch(odbcFdwModifyState *fmstate)
+{
+	SQLHSTMT stmt = fmstate->stmt;
+	SQLULEN rows = fmstate->num_rows;
+	MemoryContext old_context;
+	char **buffers;
+	SQLLEN *widths;
+	SQLRETURN ret;
+	SQLULEN r;
+	int p;
+	uint64 affected_rows = fmstate->affected_rows;
+	int64 executions = 0;
+	instr_time start;
+	instr_time duration;
+
+	if (rows == 0)
+		return;
+
+	elog_debug("%s: %lu rows", __func__, (unsigned long) rows);
+
+	old_context = MemoryContextSwitchTo(fmstate->batch_context);
+
+	/* Copy the values of each parameter into a column-wise array */
+	buffers = (char **) palloc(sizeof(char *) * fmstate->num_params);
+	widths = (SQLLEN *) palloc(sizeof(SQLLEN) * fmstate->num_params);
+	for (p = 0; p < fmstate->num_params; p++)
+	{
+		SQLLEN width = 1;
+		char  *buffer;
+
+		for (r = 0; r < rows; r++)
+		{
+			SQLLEN length = fmstate->lengths[p * fmstate->batch_size + r];
+			if (length + 1 > width)
+				width = length + 1;
+		}
+		buffer = (char *) palloc0(width * rows);
+		for (r = 0; r < rows; r++)
+		{
+			int idx = p * fmstate->batch_size + r;
+			if (fmstate->lengths[idx] > 0)
+				memcpy(buffer + r * width, fmstate->values[idx], fmstate->lengths[idx]);
+		}
+		buffers[p] = buffer;
+		widths[p] = width;
+	}
+
+	INSTR_TIME_SET_CURRENT(start);
+	if (rows > 1 && fmstate->param_arrays)
+	{
+		SQLSetStmtAttr(stmt, SQL_ATTR_PARAMSET_SIZE, (SQLPOINTER) rows, 0);
+		for (p = 0; p < fmstate->num_params; p++)
+		{
+			odbcBindModifyParam(fmstate, p, buffers[p], widths[p], &fmstate->lengths[p * fmstate->batch_size]);
+		}
+		ret = odbcExecute(stmt);
+		if (ret != SQL_NO_DATA)
+			check_return(ret, "Executing ODBC statement", stmt, SQL_HANDLE_STMT);
+		odbcCountAffectedRows(fmstate, ret, rows);
+		executions++;
+	}
+	else
+	{
+		/* One row at a time */
+		SQLSetStmtAttr(stmt, SQL_ATTR_PARAMSET_SIZE, (SQLPOINTER) 1, 0);
+		for (r = 0; r < rows; r++)
+		{
+			for (p = 0; p < fmstate->num_params; p++)
+			{
+				odbcBindModifyParam(fmstate, p, buffers[p] + r * widths[p], widths[p], &fmstate->lengths[p * fmstate->batch_size + r]);
+			}
+			ret = odbcExecute(stmt);
+			if (ret != SQL_NO_DATA)
+				check_return(ret, "Executing ODBC statement", stmt, SQL_HANDLE_STMT);
+			odbcCountAffectedRows(fmstate, ret, 1);
+			executions++;
+		}
+	}
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, start);
+	odbcStatsReport(&fmstate->options, RelationGetRelid(fmstate->rel), fmstate->query, executions,
+	                fmstate->affected_rows - affected_rows, 0, INSTR_TIME_GET_MILLISEC(duration));
+
+	fmstate->num_rows = 0;
+	MemoryContextSwitchTo(old_context);
+	MemoryContextReset(fmstate->batch_context);
+
+	fmstate->uncommitted_rows += rows;
+	if (fmstate->commit_interval > 0 && fmstate->uncommitted_rows >= fmstate->commit_interval)
+		odbcCommitModify(fmstate);
+}
+
+/*
+ * Commit the rows sent since the last commit,
+ * when autocommit has been disabled by commit_interval
+ */
+static void
+odbcCommitModify(odbcFdwModifyState *fmstate)
+{
+	SQLRETURN ret;
+
+	if (fmstate->commit_interval <= 0 || fmstate->uncommitted_rows == 0)
+		return;
+
+	elog_debug("%s: %lu rows", __func__, (unsigned long) fmstate->uncommitted_rows);
+
+	ret = SQLEndTran(SQL_HANDLE_DBC, fmstate->dbc, SQL_COMMIT);
+	check_return(ret, "Committing ODBC transaction", fmstate->dbc, SQL_HANDLE_DBC);
+	fmstate->uncommitted_rows = 0;
+}
+
+/*
+ * Accumulate the number of rows affected by an execution of the statement
+ * (SQL_NO_DATA means no rows were affected by an UPDATE or DELETE)
+ */
+static void
+odbcCountAffectedRows(odbcFdwModifyState *fmstate, SQLRETURN ret, SQLULEN rows)
+{
+	SQLLEN count = 0;
+
+	if (ret == SQL_NO_DATA)
+		return;
+	if (!SQL_SUCCEEDED(SQLRowCount(fmstate->stmt, &count)) || count < 0)
+	{
+		/* Unknown count: assume all the rows sent have been affected */
+		count = rows;
+	}
+	fmstate->affected_rows += count;
+}
+
+static void
+odbcBindModifyParam(odbcFdwModifyState *fmstate, int p, char *buffer, SQLLEN width, SQLLEN *lengths)
+{
+	SQLRETURN ret;
+	SQLSMALLINT c_type = fmstate->conversions[p] == HEX_CONVERSION ? SQL_C_BINARY : SQL_C_CHAR;
+	SQLULEN column_size = fmstate->param_sizes[p];
+
+	if (column_size == 0)
+		column_size = width > 1 ? width - 1 : 1;
+
+	ret = SQLBindParameter(fmstate->stmt, p + 1, SQL_PARAM_INPUT,
+	                       c_type, fmstate->param_types[p],
+	                       column_size, fmstate->param_digits[p],
+	                       buffer, width, lengths);
+	check_return(ret, "Binding ODBC parameter", fmstate->stmt, SQL_HANDLE_STMT);
+}
+
+/*
+ * Connect and prepare the INSERT, UPDATE or DELETE statement for the
+ * columns target_attrs; subplan produces the key values of the rows
+ * to be updated or deleted
+ */
+static void
+odbcBeginModify(ResultRelInfo *rinfo, CmdType operation, List *target_attrs, bool returning, Plan *subplan)
+{
+	odbcFdwModifyState *fmstate;
+	Relation rel = rinfo->ri_RelationDesc;
+	TupleDesc tupdesc = RelationGetDescr(rel);
+	StringInfoData sql;
+	StringInfoData name_qualifier_char;
+	StringInfoData quote_char;
+	ListCell *lc;
+	SQLRETURN ret;
+	int p;
+
+	fmstate = (odbcFdwModifyState *) palloc0(sizeof(odbcFdwModifyState));
+	fmstate->rel = rel;
+	fmstate->operation = operation;
+	fmstate->target_attrs = target_attrs;
+
+	if (fmstate->operation != CMD_INSERT)
+	{
+		/* Find the junk attributes with the key values in the subplan output */
+		fmstate->key_attrs = odbcGetKeyAttrs(rel);
+		fmstate->num_keys = list_length(fmstate->key_attrs);
+		fmstate->key_junk_attnos = (AttrNumber *) palloc0(sizeof(AttrNumber) * Max(fmstate->num_keys, 1));
+		p = 0;
+		foreach(lc, fmstate->key_attrs)
+		{
+			char *name = psprintf(KEY_JUNK_ATTRIBUTE_NAME, lfirst_int(lc));
+			fmstate->key_junk_attnos[p] = ExecFindJunkAttributeInTlist(subplan->targetlist, name);
+			if (!AttributeNumberIsValid(fmstate->key_junk_attnos[p]))
+				elog(ERROR, "could not find junk %s column", name);
+			p++;
+		}
+	}
+	fmstate->num_params = list_length(fmstate->target_attrs) + fmstate->num_keys;
+
+	odbcGetTableOptions(RelationGetRelid(rel), &fmstate->options);
+	fmstate->encoding = get_encoding(&fmstate->options);
+
+	/*
+	 * Rows are returned (and AFTER triggers fired) before a batch is sent;
+	 * updated and deleted rows are sent one by one to know if they exist remotely
+	 */
+	fmstate->batch_size = fmstate->options.batch_size > 0 ? fmstate->options.batch_size : 1;
+	if (returning || fmstate->operation != CMD_INSERT ||
+	    (rinfo->ri_TrigDesc && rinfo->ri_TrigDesc->trig_insert_after_row))
+		fmstate->batch_size = 1;
+
+	odbc_connection(&fmstate->options, &fmstate->env, &fmstate->dbc);
+	getQuoteChar(fmstate->dbc, &quote_char);
+	getNameQualifierChar(fmstate->dbc, &name_qualifier_char);
+
+	/* Rows are committed every commit_interval rows instead of by each statement */
+	fmstate->commit_interval = fmstate->options.commit_interval;
+	/* Without autocommit in the session profile, rows are committed at the end */
+	if (fmstate->commit_interval <= 0 && !odbc_autocommit(&fmstate->options))
+		fmstate->commit_interval = INT_MAX;
+	if (fmstate->commit_interval > 0)
+	{
+		ret = SQLSetConnectAttr(fmstate->dbc, SQL_ATTR_AUTOCOMMIT, (SQLPOINTER) SQL_AUTOCOMMIT_OFF, 0);
+		check_return(ret, "Disabling ODBC autocommit", fmstate->dbc, SQL_HANDLE_DBC);
+	}
+
+	/* Construct the statement */
+	initStringInfo(&sql);
+	if (fmstate->operation == CMD_INSERT)
+	{
+		appendStringInfoString(&sql, "INSERT INTO ");
+		appendQualifiedTableName(&sql, &fmstate->options, quote_char.data, name_qualifier_char.data);
+		appendStringInfoString(&sql, " (");
+		p = 0;
+		foreach(lc, fmstate->target_attrs)
+		{
+			Form_pg_attribute attr = TupleDescAttr(tupdesc, lfirst_int(lc) - 1);
+			appendStringInfo(&sql, p++ == 0 ? "%s%s%s" : ",%s%s%s",
+			                 quote_char.data,
+			                 remote_column_name(&fmstate->options, NameStr(attr->attname)),
+			                 quote_char.data);
+		}
+		appendStringInfoString(&sql, ") VALUES (");
+		for (p = 0; p < fmstate->num_params; p++)
+			appendStringInfoString(&sql, p == 0 ? "?" : ",?");
+		appendStringInfoChar(&sql, ')');
+	}
+	else
+	{
+		if (fmstate->operation == CMD_UPDATE)
+		{
+			appendStringInfoString(&sql, "UPDATE ");
+			appendQualifiedTableName(&sql, &fmstate->options, quote_char.data, name_qualifier_char.data);
+			appendStringInfoString(&sql, " SET ");
+			p = 0;
+			foreach(lc, fmstate->target_attrs)
+			{
+				Form_pg_attribute attr = TupleDescAttr(tupdesc, lfirst_int(lc) - 1);
+				appendStringInfo(&sql, p++ == 0 ? "%s%s%s = ?" : ", %s%s%s = ?",
+				                 quote_char.data,
+				                 remote_column_name(&fmstate->options, NameStr(attr->attname)),
+				                 quote_char.data);
+			}
+		}
+		else
+		{
+			appendStringInfoString(&sql, "DELETE FROM ");
+			appendQualifiedTableName(&sql, &fmstate->options, quote_char.data, name_qualifier_char.data);
+		}
+		appendStringInfoString(&sql, " WHERE ");
+		p = 0;
+		foreach(lc, fmstate->key_attrs)
+		{
+			Form_pg_attribute attr = TupleDescAttr(tupdesc, lfirst_int(lc) - 1);
+			appendStringInfo(&sql, p++ == 0 ? "%s%s%s = ?" : " AND %s%s%s = ?",
+			                 quote_char.data,
+			                 remote_column_name(&fmstate->options, NameStr(attr->attname)),
+			                 quote_char.data);
+		}
+	}
+	fmstate->query = sql.data;
+
+	elog_debug("Preparing statement: %s", fmstate->query);
+
+	odbcAllocHandle(SQL_HANDLE_STMT, fmstate->dbc, &fmstate->stmt);
+	odbcSetQueryTimeout(fmstate->stmt, &fmstate->options);
+	odbcRegisterActiveStatement(fmstate->stmt, &fmstate->options);
+	ret = SQLPrepare(fmstate->stmt, (SQLCHAR *) fmstate->query, SQL_NTS);
+	check_return(ret, "Preparing ODBC statement", fmstate->stmt, SQL_HANDLE_STMT);
+
+	/* Check whether the driver accepts arrays of parameters */
+	SQLSetStmtAttr(fmstate->stmt, SQL_ATTR_PARAM_BIND_TYPE, (SQLPOINTER) SQL_PARAM_BIND_BY_COLUMN, 0);
+	fmstate->param_arrays = fmstate->batch_size > 1 &&
+	                        SQLSetStmtAttr(fmstate->stmt, SQL_ATTR_PARAMSET_SIZE, (SQLPOINTER) (SQLULEN) fmstate->batch_size, 0) == SQL_SUCCESS;
+	SQLSetStmtAttr(fmstate->stmt, SQL_ATTR_PARAMSET_SIZE, (SQLPOINTER) 1, 0);
+
+	/* Types of the parameters */
+	fmstate->out_functions = (FmgrInfo *) palloc0(sizeof(FmgrInfo) * Max(fmstate->num_params, 1));
+	fmstate->conversions = (ColumnConversion *) palloc0(sizeof(ColumnConversion) * Max(fmstate->num_params, 1));
+	fmstate->param_types = (SQLSMALLINT *) palloc0(sizeof(SQLSMALLINT) * Max(fmstate->num_params, 1));
+	fmstate->param_sizes = (SQLULEN *) palloc0(sizeof(SQLULEN) * Max(fmstate->num_params, 1));
+	fmstate->param_digits = (SQLSMALLINT *) palloc0(sizeof(SQLSMALLINT) * Max(fmstate->num_params, 1));
+	p = 0;
+	foreach(lc, list_concat(list_copy(fmstate->target_attrs), fmstate->key_attrs))
+	{
+		Form_pg_attribute attr = TupleDescAttr(tupdesc, lfirst_int(lc) - 1);
+		Oid   out_func;
+		bool  is_varlena;
+		SQLSMALLINT nullable;
+
+		getTypeOutputInfo(attr->atttypid, &out_func, &is_varlena);
+		fmgr_info(out_func, &fmstate->out_functions[p]);
+
+		if (attr->atttypid == BYTEAOID)
+			fmstate->conversions[p] = HEX_CONVERSION;
+		else if (attr->atttypid == BOOLOID)
+			fmstate->conversions[p] = BOOL_CONVERSION;
+		else
+			fmstate->conversions[p] = TEXT_CONVERSION;
+
+		/* Let the driver tell the remote types, if it can */
+		if (!SQL_SUCCEEDED(SQLDescribeParam(fmstate->stmt, p + 1,
+		                                    &fmstate->param_types[p], &fmstate->param_sizes[p],
+		                                    &fmstate->param_digits[p], &nullable)))
+		{
+			fmstate->param_types[p] = fmstate->conversions[p] == HEX_CONVERSION ? SQL_LONGVARBINARY : SQL_VARCHAR;
+			fmstate->param_sizes[p] = 0;
+			fmstate->param_digits[p] = 0;
+		}
+		p++;
+	}
+
+	fmstate->values = (char **) palloc0(sizeof(char *) * fmstate->batch_size * Max(fmstate->num_params, 1));
+	fmstate->lengths = (SQLLEN *) palloc0(sizeof(SQLLEN) * fmstate->batch_size * Max(fmstate->num_params, 1));
+	fmstate->batch_context = AllocSetContextCreate(CurrentMemoryContext,
+	                                               "odbc_fdw modify batch",
+	                                               ALLOCSET_DEFAULT_SIZES);
+
+	rinfo->ri_FdwState = fmstate;
+}
+
+/*
+ * odbcBeginForeignModify
+ *      Connect and prepare the INSERT, UPDATE or DELETE statement
+ */
+static void
+odbcBeginForeignModify(ModifyTableState *mtstate, ResultRelInfo *rinfo, List *fdw_private, int subplan_index, int eflags)
+{
+	Plan *subplan;
+
+	elog_debug("%s", __func__);
+
+	/* Nothing to do in EXPLAIN (no ANALYZE) */
+	if (eflags & EXEC_FLAG_EXPLAIN_ONLY)
+		return;
+
+	subplan = mtstate->mt_plans[subplan_index]->plan;
+
+	odbcBeginModify(rinfo, mtstate->operation,
+	                (List *) linitial(fdw_private),
+	                intVal(lsecond(fdw_private)) != 0,
+	                subplan);
+}
+
+#if PG_VERSION_NUM >= 110000
+/*
+ * odbcBeginForeignInsert
+ *      Prepare the INSERT of the rows copied into, or routed to, a foreign table
+ *      (by COPY FROM or an INSERT into a partitioned table)
+ */
+static void
+odbcBeginForeignInsert(ModifyTableState *mtstate, ResultRelInfo *rinfo)
+{
+	TupleDesc tupdesc = RelationGetDescr(rinfo->ri_RelationDesc);
+	List *target_attrs = NIL;
+	int attnum;
+
+	elog_debug("%s", __func__);
+
+	for (attnum = 1; attnum <= tupdesc->natts; attnum++)
+	{
+		if (!TupleDescAttr(tupdesc, attnum - 1)->attisdropped)
+			target_attrs = lappend_int(target_attrs, attnum);
 	}
 
-	ExecClearTuple(slot);
-	if (SQL_SUCCEEDED(ret))
+	odbcBeginModify(rinfo, CMD_INSERT, target_attrs, rinfo->ri_returningList != NIL, NULL);
+}
+
+/*
+ * odbcEndForeignInsert
+ *      Send the rows pending in the last batch and dispose the statement
+ */
+static void
+odbcEndForeignInsert(EState *estate, ResultRelInfo *rinfo)
+{
+	elog_debug("%s", __func__);
+
+	odbcEndForeignModify(estate, rinfo);
+}
+#endif
+
+/*
+ * odbcExecForeignInsert
+ *      Add a row to the current batch; the batch is sent when full
+ */
+static TupleTableSlot *
+odbcExecForeignInsert(EState *estate, ResultRelInfo *rinfo, TupleTableSlot *slot, TupleTableSlot *planSlot)
+{
+	odbcFdwModifyState *fmstate = (odbcFdwModifyState *) rinfo->ri_FdwState;
+
+	elog_debug("%s", __func__);
+
+	odbcStoreModifyRow(fmstate, slot, planSlot);
+	if (fmstate->num_rows >= fmstate->batch_size)
+		odbcFlushModifyBatch(fmstate);
+
+	return slot;
+}
+
+/*
+ * Send a single row to be updated or deleted;
+ * the row is reported as not modified if no remote row matched its key
+ */
+static TupleTableSlot *
+odbcExecForeignModifyRow(odbcFdwModifyState *fmstate, TupleTableSlot *slot, TupleTableSlot *planSlot)
+{
+	uint64 affected_rows = fmstate->affected_rows;
+
+	odbcStoreModifyRow(fmstate, slot, planSlot);
+	odbcFlushModifyBatch(fmstate);
+
+	return fmstate->affected_rows > affected_rows ? slot : NULL;
+}
+
+/*
+ * odbcExecForeignUpdate
+ *      Update a remote row identified by its key columns
+ */
+static TupleTableSlot *
+odbcExecForeignUpdate(EState *estate, ResultRelInfo *rinfo, TupleTableSlot *slot, TupleTableSlot *planSlot)
+{
+	elog_debug("%s", __func__);
+
+	return odbcExecForeignModifyRow((odbcFdwModifyState *) rinfo->ri_FdwState, slot, planSlot);
+}
+
+/*
+ * odbcExecForeignDelete
+ *      Delete a remote row identified by its key columns
+ */
+static TupleTableSlot *
+odbcExecForeignDelete(EState *estate, ResultRelInfo *rinfo, TupleTableSlot *slot, TupleTableSlot *planSlot)
+{
+	elog_debug("%s", __func__);
+
+	return odbcExecForeignModifyRow((odbcFdwModifyState *) rinfo->ri_FdwState, slot, planSlot);
+}
+
+/*
+ * odbcEndForeignModify
+ *      Send the rows pending in the last batch and dispose the statement
+ */
+static void
+odbcEndForeignModify(EState *estate, ResultRelInfo *rinfo)
+{
+	odbcFdwModifyState *fmstate = (odbcFdwModifyState *) rinfo->ri_FdwState;
+
+	elog_debug("%s", __func__);
+
+	/* if fmstate is NULL, we are in EXPLAIN; nothing to do */
+	if (fmstate == NULL)
+		return;
+
+	odbcFlushModifyBatch(fmstate);
+	odbcCommitModify(fmstate);
+
+	/* Free handles, and disconnect */
+	if (fmstate->stmt)
 	{
-		SQLSMALLINT i;
-		values = (char **) palloc(sizeof(char *) * columns);
+		odbcFreeHandle(SQL_HANDLE_STMT, fmstate->stmt);
+		fmstate->stmt = NULL;
+	}
+	if (fmstate->dbc)
+	{
+		odbcFreeHandle(SQL_HANDLE_DBC, fmstate->dbc);
+		fmstate->dbc = NULL;
+	}
+	if (fmstate->env)
+	{
+		odbcFreeHandle(SQL_HANDLE_ENV, fmstate->env);
+		fmstate->env = NULL;
+	}
+}
 
-		/* Loop through the columns */
-		for (i = 1; i <= columns; i++)
-		{
-			SQLLEN indicator;
-			char * buf;
 
-			int mask_index = i - 1;
-			int col_size = list_nth_int(col_size_array, mask_index);
-			int mapped_pos = list_nth_int(col_position_mask, mask_index);
-			ColumnConversion conversion = list_nth_int(col_conversion_array, mask_index);
+/*
+ * Context for deparsing expressions into remote SQL.
+ * With buf NULL, expressions are only checked to be shippable.
+ */
+typedef struct odbcDeparseContext
+{
+	StringInfo        buf;
+	Index             varno;       /* Range table index of the foreign table */
+	TupleDesc         tupdesc;
+	odbcFdwOptions    *options;
+	const char        *quote_char;
+} odbcDeparseContext;
+
+/* Class of the types of values that can be sent to remote data sources */
+typedef enum { UNSHIPPABLE_TYPE, NUMERIC_TYPE, STRING_TYPE, DATE_TYPE, TIMESTAMP_TYPE } odbcShippableType;
+
+static odbcShippableType
+odbcShippableTypeOf(Oid type)
+{
+	switch (type)
+	{
+		case INT2OID:
+		case INT4OID:
+		case INT8OID:
+		case FLOAT4OID:
+		case FLOAT8OID:
+		case NUMERICOID:
+			return NUMERIC_TYPE;
+		case TEXTOID:
+		case VARCHAROID:
+		case BPCHAROID:
+			return STRING_TYPE;
+		case DATEOID:
+			return DATE_TYPE;
+		case TIMESTAMPOID:
+			return TIMESTAMP_TYPE;
+		default:
+			return UNSHIPPABLE_TYPE;
+	}
+}
 
-			/* Ignore this column if position is marked as invalid */
-			if (mapped_pos == -1)
-				continue;
+/*
+ * Append a constant to the remote SQL; dates and timestamps use the
+ * ODBC escape sequences, which drivers translate into their own syntax
+ */
+static bool
+odbcDeparseConst(odbcDeparseContext *context, Const *c)
+{
+	odbcShippableType type = odbcShippableTypeOf(c->consttype);
+	Oid   out_func;
+	bool  is_varlena;
+	char  *value;
+	int   nestlevel;
 
-			buf = (char *) palloc(sizeof(char) * (col_size+1));
+	if (type == UNSHIPPABLE_TYPE)
+		return false;
+	if (c->constisnull)
+	{
+		if (context->buf)
+			appendStringInfoString(context->buf, "NULL");
+		return true;
+	}
 
-			/* retrieve column data as a zero-terminated string */
-			/* TODO:
-			   binary fields (SQL_C_BIT, SQL_C_BINARY) do not have
-			   a trailing zero; they should be copied as now but without
-			   adding 1 to col_size, or using SQL_C_BIT or SQL_C_BINARY
-			   and then encoded into a binary PG literal (e.g. X'...'
-			   or B'...')
-			   For floating point types we should use SQL_C_FLOAT/SQL_C_DOUBLE
-			   to avoid precision loss.
-			   For date/time/timestamp these structures can be used:
-			   SQL_C_TYPE_DATE/SQL_C_TYPE_TIME/SQL_C_TYPE_TIMESTAMP.
-			   And finally, SQL_C_NUMERIC and SQL_C_GUID could also be used.
-			*/
-			buf[0] = 0;
-			ret = SQLGetData(stmt, i, SQL_C_CHAR,
-			                 buf, sizeof(char) * (col_size+1), &indicator);
+	getTypeOutputInfo(c->consttype, &out_func, &is_varlena);
+	nestlevel = set_transmission_modes();
+	value = OidOutputFunctionCall(out_func, c->constvalue);
+	reset_transmission_modes(nestlevel);
 
-			if (ret == SQL_SUCCESS_WITH_INFO)
+	switch (type)
+	{
+		case NUMERIC_TYPE:
+			/* NaN and Infinity have no portable representation */
+			if (strspn(value, "0123456789+-.eE") != strlen(value))
+				return false;
+			if (context->buf)
+				appendStringInfoString(context->buf, value);
+			break;
+		case DATE_TYPE:
+		case TIMESTAMP_TYPE:
+			/* Neither do infinite or BC dates */
+			if (strspn(value, "0123456789-:. ") != strlen(value))
+				return false;
+			if (context->buf)
 			{
-				SQLCHAR sqlstate[5];
-				SQLGetDiagRec(SQL_HANDLE_STMT, stmt, 1, sqlstate, NULL, NULL, 0, NULL);
-				if (strcmp((char*)sqlstate, ODBC_SQLSTATE_FRACTIONAL_TRUNCATION) == 0)
-				{
-					/* Fractional truncation has occured;
-					 * at this point we cannot obtain the lost digits
-					 */
-					if (buf[col_size])
-					{
-						/* The driver has omitted the trailing */
-						char *buf2 = (char *) palloc(sizeof(char) * (col_size+2));
-						strncpy(buf2, buf, col_size+1);
-						buf2[col_size+1] = 0;
-						pfree(buf);
-						buf = buf2;
-					}
-					elog(NOTICE,"Truncating number: %s",buf);
-				}
-				else
-				{
-					/* The output is incomplete, we need to obtain the rest of the data */
-					char* accum_buffer;
-					size_t accum_buffer_size;
-					size_t accum_used = 0;
-					if (indicator == SQL_NO_TOTAL)
-					{
-						/* Unknown total size, must copy part by part */
-						accum_buffer_size = 0;
-						accum_buffer = NULL;
-						while (1)
-						{
-							size_t buf_len = buf[col_size] ? col_size + 1 : col_size;
-							// Allocate new accumulation buffer if necessary
-							if (accum_used + buf_len > accum_buffer_size)
-							{
-								char *new_buff;
-								accum_buffer_size = accum_buffer_size == 0 ? col_size*2 : accum_buffer_size*2;
-								new_buff = (char *) palloc(sizeof(char) * (accum_buffer_size+1));
-								if (accum_buffer)
-								{
-									memmove(new_buff, accum_buffer, accum_used);
-									pfree(accum_buffer);
-								}
-								accum_buffer = new_buff;
-								accum_buffer[accum_used] = 0;
-							}
-							// Copy part to the accumulation buffer
-							strncpy(accum_buffer+accum_used, buf, buf_len);
-							accum_used += buf_len;
-							accum_buffer[accum_used] = 0;
-							// Get new part
-							if (ret != SQL_SUCCESS_WITH_INFO)
-								break;
-							ret = SQLGetData(stmt, i, SQL_C_CHAR, buf, sizeof(char) * (col_size+1), &indicator);
-						};
-
-					}
-					else
-					{
-						/* We need to retrieve indicator more characters */
-						size_t buf_len = buf[col_size] ? col_size + 1 : col_size;
-						accum_buffer_size = buf_len + indicator;
-						accum_buffer = (char *) palloc(sizeof(char) * (accum_buffer_size+1));
-						strncpy(accum_buffer, buf, buf_len);
-						accum_buffer[buf_len] = 0;
-						ret = SQLGetData(stmt, i, SQL_C_CHAR, accum_buffer+buf_len, sizeof(char) * (indicator+1), &indicator);
-					}
-					pfree(buf);
-					buf = accum_buffer;
-				}
+				appendStringInfoString(context->buf, type == DATE_TYPE ? "{d " : "{ts ");
+				appendQuotedString(context->buf, value);
+				appendStringInfoChar(context->buf, '}');
 			}
+			break;
+		default:
+			if (context->buf)
+				appendQuotedString(context->buf, value);
+			break;
+	}
+	return true;
+}
 
-			if (SQL_SUCCEEDED(ret))
-			{
-				/* Handle null columns */
-				if (indicator == SQL_NULL_DATA)
-				{
-					// BuildTupleFromCStrings expects NULLs to be NULL pointers
-					values[mapped_pos] = NULL;
-				}
-				else
-				{
-					if (festate->encoding != -1)
-					{
-						/* Convert character encoding */
-						buf = pg_any_to_server(buf, strlen(buf), festate->encoding);
-					}
-					initStringInfo(&col_data);
-					switch (conversion)
-					{
-					case TEXT_CONVERSION :
-						appendStringInfoString (&col_data, buf);
-						break;
-					case HEX_CONVERSION :
-						appendStringInfoString (&col_data, "\\x");
-						appendStringInfoString (&col_data, buf);
-						break;
-					case BOOL_CONVERSION :
-						if (buf[0] == 0)
-							strcpy(buf, "F");
-						else if (buf[0] == 1)
-							strcpy(buf, "T");
-						appendStringInfoString (&col_data, buf);
-						break;
-					case BIN_CONVERSION :
-						ereport(ERROR,
-						        (errcode(ERRCODE_FDW_INVALID_DATA_TYPE),
-						         errmsg("Bit string columns are not supported")
-						        ));
-						break;
-					}
+/*
+ * Append an expression to the remote SQL, if it only involves
+ * columns of the foreign table, constants, and built-in operators
+ * whose semantics are the same in any SQL data source.
+ * Returns false if the expression cannot be sent.
+ */
+static bool
+odbcDeparseExpr(odbcDeparseContext *context, Node *node)
+{
+	StringInfo buf = context->buf;
+
+	if (node == NULL)
+		return false;
+
+	switch (nodeTag(node))
+	{
+		case T_Var:
+		{
+			Var *var = (Var *) node;
+			if (var->varno != context->varno || var->varlevelsup != 0 || var->varattno <= 0)
+				return false;
+			if (odbcShippableTypeOf(var->vartype) == UNSHIPPABLE_TYPE)
+				return false;
+			if (buf)
+				appendStringInfo(buf, "%s%s%s", context->quote_char,
+				                 remote_column_name(context->options, NameStr(TupleDescAttr(context->tupdesc, var->varattno - 1)->attname)),
+				                 context->quote_char);
+			return true;
+		}
+		case T_Const:
+			return odbcDeparseConst(context, (Const *) node);
+		case T_RelabelType:
+			return odbcDeparseExpr(context, (Node *) ((RelabelType *) node)->arg);
+		case T_OpExpr:
+		{
+			OpExpr *op = (OpExpr *) node;
+			char *opname;
+			odbcShippableType type;
+			bool comparison;
+
+			if (op->opno >= FirstNormalObjectId || list_length(op->args) != 2)
+				return false;
+			opname = get_opname(op->opno);
+			type = odbcShippableTypeOf(exprType(linitial(op->args)));
+			if (type == UNSHIPPABLE_TYPE || type != odbcShippableTypeOf(exprType(lsecond(op->args))))
+				return false;
 
-					values[mapped_pos] = col_data.data;
-				}
+			/*
+			 * String comparisons are never shipped: a direct modification has
+			 * no local recheck, and a case- or accent-insensitive remote
+			 * collation would modify rows the local qual does not match.
+			 */
+			if (type == STRING_TYPE)
+				return false;
+
+			comparison = strcmp(opname, "=") == 0 || strcmp(opname, "<>") == 0 ||
+			             strcmp(opname, "<") == 0 || strcmp(opname, "<=") == 0 ||
+			             strcmp(opname, ">") == 0 || strcmp(opname, ">=") == 0;
+			if (!comparison &&
+			    !(type == NUMERIC_TYPE && (strcmp(opname, "+") == 0 || strcmp(opname, "-") == 0 || strcmp(opname, "*") == 0)))
+				return false;
+
+			if (buf)
+				appendStringInfoChar(buf, '(');
+			if (!odbcDeparseExpr(context, linitial(op->args)))
+				return false;
+			if (buf)
+				appendStringInfo(buf, " %s ", opname);
+			if (!odbcDeparseExpr(context, lsecond(op->args)))
+				return false;
+			if (buf)
+				appendStringInfoChar(buf, ')');
+			return true;
+		}
+		case T_BoolExpr:
+		{
+			BoolExpr *b = (BoolExpr *) node;
+			ListCell *lc;
+			bool first = true;
+
+			if (b->boolop == NOT_EXPR)
+			{
+				if (buf)
+					appendStringInfoString(buf, "(NOT ");
+				if (!odbcDeparseExpr(context, linitial(b->args)))
+					return false;
+				if (buf)
+					appendStringInfoChar(buf, ')');
+				return true;
 			}
-			pfree(buf);
+			if (buf)
+				appendStringInfoChar(buf, '(');
+			foreach(lc, b->args)
+			{
+				if (buf && !first)
+					appendStringInfoString(buf, b->boolop == AND_EXPR ? " AND " : " OR ");
+				if (!odbcDeparseExpr(context, lfirst(lc)))
+					return false;
+				first = false;
+			}
+			if (buf)
+				appendStringInfoChar(buf, ')');
+			return true;
 		}
+		case T_NullTest:
+		{
+			NullTest *nt = (NullTest *) node;
+
+			if (nt->argisrow)
+				return false;
+			if (buf)
+				appendStringInfoChar(buf, '(');
+			if (!odbcDeparseExpr(context, (Node *) nt->arg))
+				return false;
+			if (buf)
+				appendStringInfoString(buf, nt->nulltesttype == IS_NULL ? " IS NULL)" : " IS NOT NULL)");
+			return true;
+		}
+		default:
+			return false;
+	}
+}
 
-		tuple = BuildTupleFromCStrings(festate->attinmeta, values);
-		ExecStoreTuple(tuple, slot, InvalidBuffer, false);
-		pfree(values);
+/*
+ * Append a list of conditions, implicitly ANDed, as a WHERE clause
+ */
+static bool
+odbcDeparseConditions(odbcDeparseContext *context, List *conditions)
+{
+	ListCell *lc;
+	bool first = true;
+
+	foreach(lc, conditions)
+	{
+		Node *cond = (Node *) lfirst(lc);
+
+		if (context->buf)
+			appendStringInfoString(context->buf, first ? " WHERE " : " AND ");
+		if (IsA(cond, RestrictInfo))
+			cond = (Node *) ((RestrictInfo *) cond)->clause;
+		if (!odbcDeparseExpr(context, cond))
+			return false;
+		first = false;
+	}
+	return true;
+}
+
+#if PG_VERSION_NUM >= 90600
+typedef struct odbcFdwDirectModifyState
+{
+	odbcFdwOptions    options;
+	SQLHENV           env;
+	SQLHDBC           dbc;
+	char              *query;          /* UPDATE or DELETE statement */
+	bool              executed;
+	uint64            affected_rows;
+} odbcFdwDirectModifyState;
+
+/*
+ * odbcPlanDirectModify
+ *      Replace the scan and the row by row modification with a single
+ *      remote UPDATE or DELETE when all the conditions and the new values
+ *      can be evaluated remotely
+ */
+static bool
+odbcPlanDirectModify(PlannerInfo *root, ModifyTable *plan, Index resultRelation, int subplan_index)
+{
+	CmdType operation = plan->operation;
+	RangeTblEntry *rte = planner_rt_fetch(resultRelation, root);
+	ForeignScan *fscan;
+	Relation rel;
+	odbcFdwOptions options;
+	odbcDeparseContext context;
+	List *target_attrs = NIL;
+	List *target_exprs = NIL;
+	bool shippable = true;
+
+	elog_debug("%s", __func__);
+
+	if (operation != CMD_UPDATE && operation != CMD_DELETE)
+		return false;
+	if (plan->returningLists != NIL)
+		return false;
+
+	fscan = (ForeignScan *) list_nth(plan->plans, subplan_index);
+	if (fscan == NULL || !IsA(fscan, ForeignScan) || fscan->scan.scanrelid != resultRelation)
+		return false;
+
+	rel = heap_open(rte->relid, NoLock);
+
+	/* Row triggers need the modified rows locally */
+	if (rel->trigdesc &&
+	    (operation == CMD_UPDATE ?
+	     (rel->trigdesc->trig_update_before_row || rel->trigdesc->trig_update_after_row) :
+	     (rel->trigdesc->trig_delete_before_row || rel->trigdesc->trig_delete_after_row)))
+	{
+		heap_close(rel, NoLock);
+		return false;
 	}
 
-	return slot;
+	extract_odbcFdwOptions(GetForeignTable(rte->relid)->options, &options);
+
+	context.buf = NULL;
+	context.varno = resultRelation;
+	context.tupdesc = RelationGetDescr(rel);
+	context.options = &options;
+	context.quote_char = "";
+
+	if (operation == CMD_UPDATE)
+	{
+		int col = -1;
+
+		while ((col = bms_next_member(rte->updatedCols, col)) >= 0)
+		{
+			AttrNumber attnum = col + FirstLowInvalidHeapAttributeNumber;
+			TargetEntry *tle;
+
+			if (attnum <= InvalidAttrNumber)
+				elog(ERROR, "system-column update is not supported");
+			tle = get_tle_by_resno(fscan->scan.plan.targetlist, attnum);
+			if (tle == NULL)
+				elog(ERROR, "attribute number %d not found in UPDATE targetlist", attnum);
+			target_attrs = lappend_int(target_attrs, attnum);
+			target_exprs = lappend(target_exprs, tle->expr);
+		}
+		{
+			ListCell *lc;
+			foreach(lc, target_exprs)
+				shippable = shippable && odbcDeparseExpr(&context, (Node *) lfirst(lc));
+		}
+	}
+	shippable = shippable && odbcDeparseConditions(&context, fscan->scan.plan.qual);
+	heap_close(rel, NoLock);
+
+	if (!shippable)
+		return false;
+
+	/* The scan node performs the modification; its quals are evaluated remotely */
+	fscan->operation = operation;
+	fscan->fdw_private = list_make4(target_attrs, target_exprs, fscan->scan.plan.qual, makeInteger(resultRelation));
+	fscan->scan.plan.qual = NIL;
+
+	return true;
 }
 
 /*
- * odbcExplainForeignScan
- *
+ * odbcBeginDirectModify
+ *      Connect and construct the remote UPDATE or DELETE statement
  */
 static void
-odbcExplainForeignScan(ForeignScanState *node, ExplainState *es)
+odbcBeginDirectModify(ForeignScanState *node, int eflags)
 {
-	odbcFdwExecutionState *festate;
-	unsigned int table_size = 0;
+	ForeignScan *fscan = (ForeignScan *) node->ss.ps.plan;
+	odbcFdwDirectModifyState *dmstate;
+	Relation rel;
+	List *target_attrs = (List *) linitial(fscan->fdw_private);
+	List *target_exprs = (List *) lsecond(fscan->fdw_private);
+	List *quals = (List *) lthird(fscan->fdw_private);
+	Index varno = intVal(lfourth(fscan->fdw_private));
+	StringInfoData sql;
+	StringInfoData name_qualifier_char;
+	StringInfoData quote_char;
+	odbcDeparseContext context;
+	ListCell *lc, *lc2;
+	bool first = true;
 
 	elog_debug("%s", __func__);
 
-	festate = (odbcFdwExecutionState *) node->fdw_state;
+	rel = node->ss.ss_currentRelation;
+
+	dmstate = (odbcFdwDirectModifyState *) palloc0(sizeof(odbcFdwDirectModifyState));
+	odbcGetTableOptions(RelationGetRelid(rel), &dmstate->options);
+	odbcGetServerQuoting(GetForeignTable(RelationGetRelid(rel))->serverid, &dmstate->options, NULL,
+	                     &quote_char, &name_qualifier_char);
+	/* EXPLAIN only needs the statement */
+	if (!(eflags & EXEC_FLAG_EXPLAIN_ONLY))
+	{
+		odbc_connection(&dmstate->options, &dmstate->env, &dmstate->dbc);
+		/* Committed by odbcIterateDirectModify */
+		if (!odbc_autocommit(&dmstate->options))
+			check_return(SQLSetConnectAttr(dmstate->dbc, SQL_ATTR_AUTOCOMMIT, (SQLPOINTER) SQL_AUTOCOMMIT_OFF, 0),
+			             "Disabling ODBC autocommit", dmstate->dbc, SQL_HANDLE_DBC);
+	}
 
-	odbcGetTableSize(&(festate->options), &table_size);
+	initStringInfo(&sql);
+	context.buf = &sql;
+	context.varno = varno;
+	context.tupdesc = RelationGetDescr(rel);
+	context.options = &dmstate->options;
+	context.quote_char = quote_char.data;
 
-	/* Suppress file size if we're not showing cost details */
-	if (es->costs)
+	if (fscan->operation == CMD_UPDATE)
 	{
-#if PG_VERSION_NUM >= 110000
-		ExplainPropertyInteger("Foreign Table Size", "b", table_size, es);
-#else
-		ExplainPropertyLong("Foreign Table Size", table_size, es);
-#endif
+		appendStringInfoString(&sql, "UPDATE ");
+		appendQualifiedTableName(&sql, &dmstate->options, quote_char.data, name_qualifier_char.data);
+		appendStringInfoString(&sql, " SET ");
+		forboth(lc, target_attrs, lc2, target_exprs)
+		{
+			Form_pg_attribute attr = TupleDescAttr(context.tupdesc, lfirst_int(lc) - 1);
+			appendStringInfo(&sql, first ? "%s%s%s = " : ", %s%s%s = ",
+			                 quote_char.data,
+			                 remote_column_name(&dmstate->options, NameStr(attr->attname)),
+			                 quote_char.data);
+			if (!odbcDeparseExpr(&context, (Node *) lfirst(lc2)))
+				elog(ERROR, "odbc_fdw: could not deparse SET expression for direct modification");
+			first = false;
+		}
+	}
+	else
+	{
+		appendStringInfoString(&sql, "DELETE FROM ");
+		appendQualifiedTableName(&sql, &dmstate->options, quote_char.data, name_qualifier_char.data);
 	}
+	if (!odbcDeparseConditions(&context, quals))
+		elog(ERROR, "odbc_fdw: could not deparse WHERE clause for direct modification");
+	dmstate->query = sql.data;
+
+	node->fdw_state = dmstate;
 }
 
 /*
- * odbcEndForeignScan
- *      Finish scanning foreign table and dispose objects used for this scan
+ * odbcIterateDirectModify
+ *      Execute the remote statement; no rows are returned
  */
-static void
-odbcEndForeignScan(ForeignScanState *node)
+static TupleTableSlot *
+odbcIterateDirectModify(ForeignScanState *node)
 {
-	odbcFdwExecutionState *festate;
+	odbcFdwDirectModifyState *dmstate = (odbcFdwDirectModifyState *) node->fdw_state;
+	EState *estate = node->ss.ps.state;
+	TupleTableSlot *slot = node->ss.ss_ScanTupleSlot;
+	Instrumentation *instr = node->ss.ps.instrument;
+	SQLHSTMT stmt;
+	SQLRETURN ret;
+	SQLLEN rows = 0;
+	instr_time start;
+	instr_time duration;
 
 	elog_debug("%s", __func__);
 
-	/* if festate is NULL, we are in EXPLAIN; nothing to do */
-	festate = (odbcFdwExecutionState *) node->fdw_state;
-	if (festate)
+	if (!dmstate->executed)
 	{
-		if (festate->stmt)
+		elog_debug("Executing: %s", dmstate->query);
+
+		odbcAllocHandle(SQL_HANDLE_STMT, dmstate->dbc, &stmt);
+		odbcSetQueryTimeout(stmt, &dmstate->options);
+		odbcRegisterActiveStatement(stmt, &dmstate->options);
+		INSTR_TIME_SET_CURRENT(start);
+		ret = odbcExecDirect(stmt, (SQLCHAR *) dmstate->query, SQL_NTS);
+		if (ret != SQL_NO_DATA)
 		{
-			SQLFreeHandle(SQL_HANDLE_STMT, festate->stmt);
-			festate->stmt = NULL;
+			check_return(ret, "Executing ODBC statement", stmt, SQL_HANDLE_STMT);
+			if (SQL_SUCCEEDED(SQLRowCount(stmt, &rows)) && rows > 0)
+				dmstate->affected_rows = rows;
 		}
+		INSTR_TIME_SET_CURRENT(duration);
+		INSTR_TIME_SUBTRACT(duration, start);
+		odbcFreeHandle(SQL_HANDLE_STMT, stmt);
+		odbcStatsReport(&dmstate->options, RelationGetRelid(node->ss.ss_currentRelation), dmstate->query,
+		                1, dmstate->affected_rows, 0, INSTR_TIME_GET_MILLISEC(duration));
+		if (!odbc_autocommit(&dmstate->options))
+			check_return(SQLEndTran(SQL_HANDLE_DBC, dmstate->dbc, SQL_COMMIT),
+			             "Committing remote transaction", dmstate->dbc, SQL_HANDLE_DBC);
+		dmstate->executed = true;
+
+		estate->es_processed += dmstate->affected_rows;
+		if (instr)
+			instr->tuplecount += dmstate->affected_rows;
 	}
+
+	return ExecClearTuple(slot);
 }
 
 /*
- * odbcReScanForeignScan
- *      Rescan table, possibly with new parameters
+ * odbcEndDirectModify
+ *      Disconnect
  */
 static void
-odbcReScanForeignScan(ForeignScanState *node)
+odbcEndDirectModify(ForeignScanState *node)
 {
+	odbcFdwDirectModifyState *dmstate = (odbcFdwDirectModifyState *) node->fdw_state;
+
 	elog_debug("%s", __func__);
+
+	if (dmstate == NULL)
+		return;
+
+	if (dmstate->dbc)
+	{
+		odbcFreeHandle(SQL_HANDLE_DBC, dmstate->dbc);
+		dmstate->dbc = NULL;
+	}
+	if (dmstate->env)
+	{
+		odbcFreeHandle(SQL_HANDLE_ENV, dmstate->env);
+		dmstate->env = NULL;
+	}
 }
 
+static void
+odbcExplainDirectModify(ForeignScanState *node, ExplainState *es)
+{
+	odbcFdwDirectModifyState *dmstate = (odbcFdwDirectModifyState *) node->fdw_state;
+
+	if (es->verbose && dmstate)
+		ExplainPropertyText("Remote SQL", dmstate->query, es);
+}
+#endif
 
 static void
 appendQuotedString(StringInfo buffer, const char* text)
@@ -1851,6 +7948,36 @@ appendQuotedString(StringInfo buffer, const char* text)
 	appendStringInfoChar(buffer, SINGLE_QUOTE);
 }
 
+/*
+ * Name of a SQL Server object, optionally qualified by its schema, with
+ * the delimited identifiers of T-SQL: in brackets, doubling any ']'
+ */
+static void
+appendSQLServerName(StringInfo buffer, const char *schema_name, const char *name)
+{
+	const char *identifiers[2];
+	const char *p;
+	int i;
+
+	identifiers[0] = is_blank_string(schema_name) ? NULL : schema_name;
+	identifiers[1] = name;
+	for (i = 0; i < 2; i++)
+	{
+		if (identifiers[i] == NULL)
+			continue;
+		if (i > 0 && identifiers[0] != NULL)
+			appendStringInfoChar(buffer, '.');
+		appendStringInfoChar(buffer, '[');
+		for (p = identifiers[i]; *p; p++)
+		{
+			if (*p == ']')
+				appendStringInfoChar(buffer, ']');
+			appendStringInfoChar(buffer, *p);
+		}
+		appendStringInfoChar(buffer, ']');
+	}
+}
+
 static void
 appendOption(StringInfo str, bool first, const char* option_name, const char* option_value)
 {
@@ -1862,6 +7989,280 @@ appendOption(StringInfo str, bool first, const char* option_name, const char* op
 	appendQuotedString(str, option_value);
 }
 
+/*
+ * Numbers of the columns returned by SQLColumns used to define foreign tables
+ */
+#define SQLCOLUMNS_SCHEMA_COLUMN 2
+#define SQLCOLUMNS_TABLE_COLUMN 3
+#define SQLCOLUMNS_NAME_COLUMN 4
+#define SQLCOLUMNS_DATA_TYPE_COLUMN 5
+#define SQLCOLUMNS_SIZE_COLUMN 7
+#define SQLCOLUMNS_DECIMAL_DIGITS_COLUMN 9
+#define SQLCOLUMNS_NULLABLE_COLUMN 11
+
+typedef struct odbcImportedTable
+{
+	char            table_name[MAXIMUM_TABLE_NAME_LEN]; /* Hash key */
+	StringInfoData  columns;      /* Column definitions */
+	int             num_columns;
+	List            *key_columns; /* Names of the primary key columns */
+} odbcImportedTable;
+
+/*
+ * Numbers of the columns returned by SQLPrimaryKeys
+ */
+#define SQLPRIMARYKEYS_TABLE_COLUMN 3
+#define SQLPRIMARYKEYS_NAME_COLUMN 4
+
+/*
+ * Primary key columns of all the tables of a schema, from the standard
+ * INFORMATION_SCHEMA views, which PostgreSQL, SQL Server and MySQL provide:
+ * SQLPrimaryKeys requires a table name
+ */
+#define PRIMARY_KEYS_QUERY \
+	"SELECT kcu.table_name, kcu.column_name" \
+	" FROM information_schema.table_constraints tc" \
+	" JOIN information_schema.key_column_usage kcu" \
+	" ON kcu.constraint_schema = tc.constraint_schema AND kcu.constraint_name = tc.constraint_name" \
+	" AND kcu.table_schema = tc.table_schema AND kcu.table_name = tc.table_name" \
+	" WHERE tc.constraint_type = 'PRIMARY KEY' AND tc.table_schema = "
+
+/*
+ * Add the names of the primary key columns of the remote table table_name,
+ * or of all the tables of the schema if table_name is NULL, to the key
+ * columns of the imported tables. Returns false if they could not be
+ * obtained, in which case nothing is added: for a whole schema, when the
+ * data source has no INFORMATION_SCHEMA views.
+ */
+static bool
+odbcGetPrimaryKeyColumns(SQLHDBC dbc, const char *schema_name, const char *table_name, HTAB *imported_tables)
+{
+	SQLHSTMT stmt;
+	SQLRETURN ret;
+	SQLCHAR TableName[MAXIMUM_TABLE_NAME_LEN];
+	SQLCHAR ColumnName[MAXIMUM_COLUMN_NAME_LEN];
+	SQLLEN table_ind, name_ind;
+	bool succeeded;
+
+	if (table_name == NULL)
+	{
+		StringInfoData sql;
+
+		switch (odbcGetDialect(dbc))
+		{
+			case ODBC_DIALECT_POSTGRESQL:
+			case ODBC_DIALECT_SQLSERVER:
+			case ODBC_DIALECT_MYSQL:
+				break;
+			default:
+				return false;
+		}
+
+		initStringInfo(&sql);
+		appendStringInfoString(&sql, PRIMARY_KEYS_QUERY);
+		appendQuotedString(&sql, schema_name);
+		appendStringInfoString(&sql, " ORDER BY kcu.table_name, kcu.ordinal_position");
+		elog_debug("Primary keys query: %s", sql.data);
+
+		odbcAllocHandle(SQL_HANDLE_STMT, dbc, &stmt);
+		ret = odbcExecDirect(stmt, (SQLCHAR *) sql.data, SQL_NTS);
+		succeeded = SQL_SUCCEEDED(ret);
+		if (succeeded)
+		{
+			SQLBindCol(stmt, 1, SQL_C_CHAR, TableName, sizeof(TableName), &table_ind);
+			SQLBindCol(stmt, 2, SQL_C_CHAR, ColumnName, sizeof(ColumnName), &name_ind);
+		}
+		pfree(sql.data);
+	}
+	else
+	{
+		odbcAllocHandle(SQL_HANDLE_STMT, dbc, &stmt);
+		odbcWaitStart(ODBC_WAIT_EXECUTE);
+		ret = SQLPrimaryKeys(stmt,
+		                     NULL, 0,
+		                     (SQLCHAR *) schema_name, schema_name ? SQL_NTS : 0,
+		                     (SQLCHAR *) table_name, SQL_NTS);
+		odbcWaitEnd();
+		succeeded = SQL_SUCCEEDED(ret);
+		if (succeeded)
+		{
+			SQLBindCol(stmt, SQLPRIMARYKEYS_TABLE_COLUMN, SQL_C_CHAR, TableName, sizeof(TableName), &table_ind);
+			SQLBindCol(stmt, SQLPRIMARYKEYS_NAME_COLUMN, SQL_C_CHAR, ColumnName, sizeof(ColumnName), &name_ind);
+		}
+	}
+	while (SQL_SUCCEEDED(ret))
+	{
+		odbcImportedTable *table;
+
+		ret = odbcFetch(stmt);
+		if (!SQL_SUCCEEDED(ret) || name_ind == SQL_NULL_DATA)
+			continue;
+
+		/* Rows are grouped by table; those of tables not imported are skipped */
+		if (table_name)
+			strlcpy((char *) TableName, table_name, sizeof(TableName));
+		else if (table_ind == SQL_NULL_DATA)
+			continue;
+		table = (odbcImportedTable *) hash_search(imported_tables, TableName, HASH_FIND, NULL);
+		if (table)
+			table->key_columns = lappend(table->key_columns, pstrdup((char *) ColumnName));
+	}
+	odbcFreeHandle(SQL_HANDLE_STMT, stmt);
+
+	return succeeded;
+}
+
+/*
+ * Column definitions of the tables to be imported, in the order of tables.
+ * A single SQLColumns call for the whole schema is used (unless a single
+ * table is imported), and its results, ordered by table, are distributed
+ * to the imported tables; this is much faster than querying each table
+ * when importing large schemas.
+ */
+static List *
+odbcGetTablesColumns(SQLHDBC dbc, const char *schema_name, List *tables)
+{
+	HASHCTL ctl;
+	HTAB *imported_tables;
+	odbcImportedTable *table;
+	ListCell *lc;
+	List *table_columns = NIL;
+	SQLHSTMT stmt;
+	SQLRETURN ret;
+	SQLCHAR ColumnSchema[MAXIMUM_SCHEMA_NAME_LEN];
+	SQLCHAR TableName[MAXIMUM_TABLE_NAME_LEN];
+	SQLCHAR ColumnName[MAXIMUM_COLUMN_NAME_LEN];
+	SQLSMALLINT DataType;
+	SQLINTEGER ColumnSize;
+	SQLSMALLINT DecimalDigits;
+	SQLSMALLINT Nullable;
+	SQLLEN schema_ind, table_ind, name_ind, type_ind, size_ind, digits_ind, nullable_ind;
+	StringInfoData sql_type;
+
+	if (tables == NIL)
+		return NIL;
+
+	memset(&ctl, 0, sizeof(ctl));
+	ctl.keysize = MAXIMUM_TABLE_NAME_LEN;
+	ctl.entrysize = sizeof(odbcImportedTable);
+	ctl.hcxt = CurrentMemoryContext;
+	imported_tables = hash_create("odbc_fdw imported tables", list_length(tables), &ctl,
+	                              HASH_ELEM | HASH_CONTEXT);
+
+	foreach(lc, tables)
+	{
+		char key[MAXIMUM_TABLE_NAME_LEN];
+		bool found;
+
+		strlcpy(key, (char *) lfirst(lc), MAXIMUM_TABLE_NAME_LEN);
+		table = (odbcImportedTable *) hash_search(imported_tables, key, HASH_ENTER, &found);
+		if (!found)
+		{
+			initStringInfo(&table->columns);
+			table->num_columns = 0;
+			table->key_columns = NIL;
+		}
+	}
+
+	/*
+	 * Primary key columns are imported as key columns; as for the columns,
+	 * a single query for the whole schema is used when the data source
+	 * allows it. Otherwise (Hive and generic drivers) SQLPrimaryKeys is
+	 * called for each table.
+	 */
+	if (list_length(tables) == 1 || schema_name == NULL ||
+	    !odbcGetPrimaryKeyColumns(dbc, schema_name, NULL, imported_tables))
+	{
+		foreach(lc, tables)
+		{
+			char key[MAXIMUM_TABLE_NAME_LEN];
+
+			strlcpy(key, (char *) lfirst(lc), MAXIMUM_TABLE_NAME_LEN);
+			table = (odbcImportedTable *) hash_search(imported_tables, key, HASH_FIND, NULL);
+			if (table && table->key_columns == NIL)
+				odbcGetPrimaryKeyColumns(dbc, schema_name, table->table_name, imported_tables);
+		}
+	}
+
+	odbcAllocHandle(SQL_HANDLE_STMT, dbc, &stmt);
+	odbcWaitStart(ODBC_WAIT_EXECUTE);
+	ret = SQLColumns(
+	          stmt,
+	          NULL, 0,
+	          (SQLCHAR *) schema_name, SQL_NTS,
+	          list_length(tables) == 1 ? (SQLCHAR *) linitial(tables) : NULL, list_length(tables) == 1 ? SQL_NTS : 0,
+	          NULL, 0
+	      );
+	odbcWaitEnd();
+	check_return(ret, "Obtaining ODBC columns", stmt, SQL_HANDLE_STMT);
+
+	SQLBindCol(stmt, SQLCOLUMNS_SCHEMA_COLUMN, SQL_C_CHAR, ColumnSchema, sizeof(ColumnSchema), &schema_ind);
+	SQLBindCol(stmt, SQLCOLUMNS_TABLE_COLUMN, SQL_C_CHAR, TableName, sizeof(TableName), &table_ind);
+	SQLBindCol(stmt, SQLCOLUMNS_NAME_COLUMN, SQL_C_CHAR, ColumnName, sizeof(ColumnName), &name_ind);
+	SQLBindCol(stmt, SQLCOLUMNS_DATA_TYPE_COLUMN, SQL_C_SSHORT, &DataType, 0, &type_ind);
+	SQLBindCol(stmt, SQLCOLUMNS_SIZE_COLUMN, SQL_C_SLONG, &ColumnSize, 0, &size_ind);
+	SQLBindCol(stmt, SQLCOLUMNS_DECIMAL_DIGITS_COLUMN, SQL_C_SSHORT, &DecimalDigits, 0, &digits_ind);
+	SQLBindCol(stmt, SQLCOLUMNS_NULLABLE_COLUMN, SQL_C_SSHORT, &Nullable, 0, &nullable_ind);
+
+	while (SQL_SUCCEEDED(ret = odbcFetch(stmt)))
+	{
+		ListCell *key_cell;
+
+		if (table_ind == SQL_NULL_DATA || name_ind == SQL_NULL_DATA)
+			continue;
+		table = (odbcImportedTable *) hash_search(imported_tables, TableName, HASH_FIND, NULL);
+		if (table == NULL)
+			continue;
+
+		/* Schema names are patterns for SQLColumns: exclude other matching schemas */
+		if (schema_name != NULL && schema_ind != SQL_NULL_DATA &&
+		    !is_blank_string((char *) ColumnSchema) && strcmp((char *) ColumnSchema, schema_name) != 0)
+			continue;
+
+		if (size_ind == SQL_NULL_DATA)
+			ColumnSize = 0;
+		if (digits_ind == SQL_NULL_DATA)
+			DecimalDigits = 0;
+		if (nullable_ind == SQL_NULL_DATA)
+			Nullable = SQL_NULLABLE_UNKNOWN;
+
+		sql_data_type(DataType, ColumnSize, DecimalDigits, Nullable, &sql_type);
+		if (is_blank_string(sql_type.data))
+		{
+			elog(NOTICE, "Data type not supported (%d) for column %s", DataType, ColumnName);
+			continue;
+		}
+		if (++table->num_columns > 1)
+		{
+			appendStringInfo(&table->columns, ", ");
+		}
+		appendStringInfo(&table->columns, "\"%s\" %s", ColumnName, (char *) sql_type.data);
+		foreach(key_cell, table->key_columns)
+		{
+			if (strcmp((char *) lfirst(key_cell), (char *) ColumnName) == 0)
+			{
+				appendStringInfoString(&table->columns, " OPTIONS (key 'true')");
+				break;
+			}
+		}
+	}
+	if (ret != SQL_NO_DATA)
+		check_return(ret, "Reading ODBC columns", stmt, SQL_HANDLE_STMT);
+	odbcFreeHandle(SQL_HANDLE_STMT, stmt);
+
+	foreach(lc, tables)
+	{
+		char key[MAXIMUM_TABLE_NAME_LEN];
+
+		strlcpy(key, (char *) lfirst(lc), MAXIMUM_TABLE_NAME_LEN);
+		table = (odbcImportedTable *) hash_search(imported_tables, key, HASH_FIND, NULL);
+		table_columns = lappend(table_columns, table->columns.data);
+	}
+	hash_destroy(imported_tables);
+
+	return table_columns;
+}
+
 List *
 odbcImportForeignSchema(ImportForeignSchemaStmt *stmt, Oid serverOid)
 {
@@ -1878,7 +8279,6 @@ odbcImportForeignSchema(ImportForeignSchemaStmt *stmt, Oid serverOid)
 	SQLHENV env;
 	SQLHDBC dbc;
 	SQLHSTMT query_stmt;
-	SQLHSTMT columns_stmt;
 	SQLHSTMT tables_stmt;
 	SQLRETURN ret;
 	SQLSMALLINT result_columns;
@@ -1913,6 +8313,9 @@ odbcImportForeignSchema(ImportForeignSchemaStmt *stmt, Oid serverOid)
 		schema_name = NULL;
 	}
 
+	/* A single connection is used for all the metadata queries */
+	odbc_connection(&options, &env, &dbc);
+
 	if (!is_blank_string(options.sql_query))
 	{
 		/* Generate foreign table for a query */
@@ -1921,13 +8324,11 @@ odbcImportForeignSchema(ImportForeignSchemaStmt *stmt, Oid serverOid)
 			elog(ERROR, "Must provide 'table' option to name the foreign table");
 		}
 
-		odbc_connection(&options, &env, &dbc);
-
 		/* Allocate a statement handle */
-		SQLAllocHandle(SQL_HANDLE_STMT, dbc, &query_stmt);
+		odbcAllocHandle(SQL_HANDLE_STMT, dbc, &query_stmt);
 
 		/* Retrieve a list of rows */
-		ret = SQLExecDirect(query_stmt, (SQLCHAR *) options.sql_query, SQL_NTS);
+		ret = odbcExecDirect(query_stmt, (SQLCHAR *) options.sql_query, SQL_NTS);
 		check_return(ret, "Executing ODBC query", query_stmt, SQL_HANDLE_STMT);
 
 		SQLNumResultCols(query_stmt, &result_columns);
@@ -1960,7 +8361,7 @@ odbcImportForeignSchema(ImportForeignSchemaStmt *stmt, Oid serverOid)
 			appendStringInfo(&col_str, "\"%s\" %s", ColumnName, (char *) sql_type.data);
 		}
 		SQLCloseCursor(query_stmt);
-		SQLFreeHandle(SQL_HANDLE_STMT, query_stmt);
+		odbcFreeHandle(SQL_HANDLE_STMT, query_stmt);
 
 		tables        = lappend(tables, (void*)options.table);
 		table_columns = lappend(table_columns, (void*)col_str.data);
@@ -1978,11 +8379,10 @@ odbcImportForeignSchema(ImportForeignSchemaStmt *stmt, Oid serverOid)
 
 			SQLCHAR *table_schema = (SQLCHAR *) palloc(sizeof(SQLCHAR) * MAXIMUM_SCHEMA_NAME_LEN);
 
-			odbc_connection(&options, &env, &dbc);
-
 			/* Allocate a statement handle */
-			SQLAllocHandle(SQL_HANDLE_STMT, dbc, &tables_stmt);
+			odbcAllocHandle(SQL_HANDLE_STMT, dbc, &tables_stmt);
 
+			odbcWaitStart(ODBC_WAIT_EXECUTE);
 			ret = SQLTables(
 			          tables_stmt,
 			          NULL, 0, /* Catalog: (SQLCHAR*)SQL_ALL_CATALOGS, SQL_NTS would include also tables from internal catalogs */
@@ -1990,17 +8390,18 @@ odbcImportForeignSchema(ImportForeignSchemaStmt *stmt, Oid serverOid)
 			          NULL, 0, /* Table */
 			          (SQLCHAR*)"TABLE", SQL_NTS /* Type of table (we're not interested in views, temporary tables, etc.) */
 			      );
+			odbcWaitEnd();
 			check_return(ret, "Obtaining ODBC tables", tables_stmt, SQL_HANDLE_STMT);
 
 			initStringInfo(&col_str);
 			while (SQL_SUCCESS == ret)
 			{
-				ret = SQLFetch(tables_stmt);
+				ret = odbcFetch(tables_stmt);
 				if (SQL_SUCCESS == ret)
 				{
 					int excluded = false;
 					TableName = (SQLCHAR *) palloc(sizeof(SQLCHAR) * MAXIMUM_TABLE_NAME_LEN);
-					ret = SQLGetData(tables_stmt, SQLTABLES_NAME_COLUMN, SQL_C_CHAR, TableName, MAXIMUM_TABLE_NAME_LEN, &indicator);
+					ret = odbcGetData(tables_stmt, SQLTABLES_NAME_COLUMN, SQL_C_CHAR, TableName, MAXIMUM_TABLE_NAME_LEN, &indicator);
 					check_return(ret, "Reading table name", tables_stmt, SQL_HANDLE_STMT);
 
 					/* Since we're not filtering the SQLTables call by schema
@@ -2010,7 +8411,7 @@ odbcImportForeignSchema(ImportForeignSchemaStmt *stmt, Oid serverOid)
 					   So we only reject tables for which the schema is not
 					   blank and different from the desired schema:
 					 */
-					ret = SQLGetData(tables_stmt, SQLTABLES_SCHEMA_COLUMN, SQL_C_CHAR, table_schema, MAXIMUM_SCHEMA_NAME_LEN, &indicator);
+					ret = odbcGetData(tables_stmt, SQLTABLES_SCHEMA_COLUMN, SQL_C_CHAR, table_schema, MAXIMUM_SCHEMA_NAME_LEN, &indicator);
 					if (SQL_SUCCESS == ret)
 					{
 						if (!is_blank_string((char*)table_schema) && strcmp((char*)table_schema, schema_name) )
@@ -2032,7 +8433,7 @@ odbcImportForeignSchema(ImportForeignSchemaStmt *stmt, Oid serverOid)
 					   (the catalog name is usually the name of the database or blank,
 					   but depends on the driver and may vary, and can be obtained with:
 					     SQLCHAR *table_catalog = (SQLCHAR *) palloc(sizeof(SQLCHAR) * MAXIMUM_CATALOG_NAME_LEN);
-					     SQLGetData(tables_stmt, 1, SQL_C_CHAR, table_catalog, MAXIMUM_CATALOG_NAME_LEN, &indicator);
+					     odbcGetData(tables_stmt, 1, SQL_C_CHAR, table_catalog, MAXIMUM_CATALOG_NAME_LEN, &indicator);
 					 */
 
 					/* And now we'll handle tables excluded by an EXCEPT clause */
@@ -2057,7 +8458,7 @@ odbcImportForeignSchema(ImportForeignSchemaStmt *stmt, Oid serverOid)
 
 			SQLCloseCursor(tables_stmt);
 
-			SQLFreeHandle(SQL_HANDLE_STMT, tables_stmt);
+			odbcFreeHandle(SQL_HANDLE_STMT, tables_stmt);
 		}
 		else if (stmt->list_type == FDW_IMPORT_SCHEMA_LIMIT_TO)
 		{
@@ -2071,61 +8472,13 @@ odbcImportForeignSchema(ImportForeignSchemaStmt *stmt, Oid serverOid)
 		{
 			elog(ERROR,"Unknown list type in IMPORT FOREIGN SCHEMA");
 		}
-		foreach(tables_cell, tables)
-		{
-			char *table_name = (char*)lfirst(tables_cell);
-
-			odbc_connection(&options, &env, &dbc);
-
-			/* Allocate a statement handle */
-			SQLAllocHandle(SQL_HANDLE_STMT, dbc, &columns_stmt);
-
-			ret = SQLColumns(
-			          columns_stmt,
-			          NULL, 0,
-			          (SQLCHAR*)schema_name, SQL_NTS,
-			          (SQLCHAR*)table_name,  SQL_NTS,
-			          NULL, 0
-			      );
-			check_return(ret, "Obtaining ODBC columns", columns_stmt, SQL_HANDLE_STMT);
-
-			i = 0;
-			initStringInfo(&col_str);
-			ColumnName = (SQLCHAR *) palloc(sizeof(SQLCHAR) * MAXIMUM_COLUMN_NAME_LEN);
-			while (SQL_SUCCESS == ret)
-			{
-				ret = SQLFetch(columns_stmt);
-				if (SQL_SUCCESS == ret)
-				{
-					ret = SQLGetData(columns_stmt, 4, SQL_C_CHAR, ColumnName, MAXIMUM_COLUMN_NAME_LEN, &indicator);
-					// check_return(ret, "Reading column name", columns_stmt, SQL_HANDLE_STMT);
-					ret = SQLGetData(columns_stmt, 5, SQL_C_SSHORT, &DataType, MAXIMUM_COLUMN_NAME_LEN, &indicator);
-					// check_return(ret, "Reading column type", columns_stmt, SQL_HANDLE_STMT);
-					ret = SQLGetData(columns_stmt, 7, SQL_C_SLONG, &ColumnSize, 0, &indicator);
-					// check_return(ret, "Reading column size", columns_stmt, SQL_HANDLE_STMT);
-					ret = SQLGetData(columns_stmt, 9, SQL_C_SSHORT, &DecimalDigits, 0, &indicator);
-					// check_return(ret, "Reading column decimals", columns_stmt, SQL_HANDLE_STMT);
-					ret = SQLGetData(columns_stmt, 11, SQL_C_SSHORT, &Nullable, 0, &indicator);
-					// check_return(ret, "Reading column nullable", columns_stmt, SQL_HANDLE_STMT);
-					sql_data_type(DataType, ColumnSize, DecimalDigits, Nullable, &sql_type);
-					if (is_blank_string(sql_type.data))
-					{
-						elog(NOTICE, "Data type not supported (%d) for column %s", DataType, ColumnName);
-						continue;
-					}
-					if (++i > 1)
-					{
-						appendStringInfo(&col_str, ", ");
-					}
-					appendStringInfo(&col_str, "\"%s\" %s", ColumnName, (char *) sql_type.data);
-				}
-			}
-			SQLCloseCursor(columns_stmt);
-			SQLFreeHandle(SQL_HANDLE_STMT, columns_stmt);
-			table_columns = lappend(table_columns, (void*)col_str.data);
-		}
+		/* Obtain the columns of all the tables at once */
+		table_columns = odbcGetTablesColumns(dbc, schema_name, tables);
 	}
 
+	odbcFreeHandle(SQL_HANDLE_DBC, dbc);
+	odbcFreeHandle(SQL_HANDLE_ENV, env);
+
 	/* Generate create statements */
 	table_columns_cell = list_head(table_columns);
 	foreach(tables_cell, tables)
@@ -0,0 +1,271 @@
+#!/bin/bash
+#
+# Offline end-to-end performance check of odbc_fdw
+#
+# Starts a throwaway PostgreSQL cluster (read through psqlODBC) and
+# creates a SQLite database (read through the SQLite ODBC driver), loads
+# both with TPC-H style tables, and times scan, filter, join, aggregate
+# and limit queries on foreign tables of the local server. The median
+# times are compared with a stored baseline, and the check fails if any
+# of them is slower than the baseline by more than the threshold.
+#
+# Usage: make benchcheck, or test/bench/benchcheck.sh (after make install)
+#
+# Settings, from the environment:
+#   BENCHCHECK_DB           local database, created if needed (default odbc_fdw_benchcheck)
+#   BENCHCHECK_SCALE        scale factor: 6000000 * scale lineitem rows (default 0.1)
+#   BENCHCHECK_RUNS         measured runs of each query (default 5)
+#   BENCHCHECK_THRESHOLD    allowed slowdown, in percent (default 20)
+#   BENCHCHECK_BASELINE     baseline file (default test/bench/benchcheck.baseline);
+#                           it is created by the first run
+#   BENCHCHECK_UPDATE       if 1, replace the baseline with the results
+#   BENCHCHECK_PORT         port of the throwaway cluster (default 54329)
+#   BENCHCHECK_PG_DRIVER    psqlODBC driver name in odbcinst.ini (default "PostgreSQL Unicode")
+#   BENCHCHECK_SQLITE_DRIVER  SQLite ODBC driver name in odbcinst.ini (default SQLite3)
+#
+# The local server is reached with the connection parameters of psql
+# (PGHOST, PGPORT, PGUSER...); it must run on this host, and its operating
+# system user must be able to read the SQLite database in a temporary
+# directory. Requires initdb and pg_ctl (from pg_config --bindir), sqlite3,
+# psqlODBC and the SQLite ODBC driver (sqliteodbc).
+
+set -e
+
+BASEDIR=$(readlink -f $0 | xargs dirname)
+
+DB=${BENCHCHECK_DB:-odbc_fdw_benchcheck}
+SCALE=${BENCHCHECK_SCALE:-0.1}
+RUNS=${BENCHCHECK_RUNS:-5}
+THRESHOLD=${BENCHCHECK_THRESHOLD:-20}
+BASELINE=${BENCHCHECK_BASELINE:-$BASEDIR/benchcheck.baseline}
+PORT=${BENCHCHECK_PORT:-54329}
+PG_DRIVER=${BENCHCHECK_PG_DRIVER:-"PostgreSQL Unicode"}
+SQLITE_DRIVER=${BENCHCHECK_SQLITE_DRIVER:-SQLite3}
+
+BINDIR=$(pg_config --bindir)
+WORKDIR=$(mktemp -d /tmp/odbc_fdw_benchcheck.XXXXXX)
+RESULTS=$WORKDIR/results
+PSQL="psql -X -v ON_ERROR_STOP=1 -d $DB"
+
+rows_for()
+{
+    awk -v base=$1 -v scale=$SCALE 'BEGIN { n = int(base * scale); print (n > 0 ? n : 1) }'
+}
+
+CUSTOMERS=$(rows_for 150000)
+ORDERS=$(rows_for 1500000)
+LINEITEMS=$((ORDERS * 4))
+
+cleanup()
+{
+    "$BINDIR/pg_ctl" -D "$WORKDIR/remote" -m immediate stop >/dev/null 2>&1 || true
+    rm -rf "$WORKDIR"
+}
+trap cleanup EXIT
+
+#
+# Fixtures: the same deterministic rows in both data sources
+#
+series()
+{
+    local dialect=$1 count=$2 select_list=$3
+    if [ "$dialect" = postgres ]
+    then
+        echo "SELECT $select_list FROM generate_series(1::bigint, $count) AS s(i);"
+    else
+        echo "WITH RECURSIVE s(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM s WHERE i < $count) SELECT $select_list FROM s;"
+    fi
+}
+
+date_from()
+{
+    local dialect=$1 days=$2
+    if [ "$dialect" = postgres ]
+    then
+        echo "date '1992-01-01' + ($days)"
+    else
+        echo "date('1992-01-01', '+' || ($days) || ' days')"
+    fi
+}
+
+fixtures_sql()
+{
+    local dialect=$1
+    cat <<SQL
+CREATE TABLE region (r_regionkey integer, r_name varchar(25));
+CREATE TABLE nation (n_nationkey integer, n_name varchar(25), n_regionkey integer);
+CREATE TABLE customer (c_custkey integer, c_name varchar(25), c_nationkey integer,
+                       c_acctbal numeric(12,2), c_mktsegment varchar(10));
+CREATE TABLE orders (o_orderkey integer, o_custkey integer, o_orderstatus varchar(1),
+                     o_totalprice numeric(12,2), o_orderdate date, o_orderpriority varchar(15));
+CREATE TABLE lineitem (l_orderkey integer, l_linenumber integer, l_quantity numeric(12,2),
+                       l_extendedprice numeric(12,2), l_discount numeric(12,2),
+                       l_returnflag varchar(1), l_linestatus varchar(1), l_shipdate date,
+                       l_shipmode varchar(10));
+INSERT INTO region $(series $dialect 5 "i - 1, CASE i WHEN 1 THEN 'AFRICA' WHEN 2 THEN 'AMERICA' WHEN 3 THEN 'ASIA' WHEN 4 THEN 'EUROPE' ELSE 'MIDDLE EAST' END")
+INSERT INTO nation $(series $dialect 25 "i - 1, 'NATION ' || i, (i - 1) % 5")
+INSERT INTO customer $(series $dialect $CUSTOMERS "i, 'Customer#' || i, i % 25, (i * 7919 % 1100000) / 100.0 - 1000, CASE i % 5 WHEN 0 THEN 'AUTOMOBILE' WHEN 1 THEN 'BUILDING' WHEN 2 THEN 'FURNITURE' WHEN 3 THEN 'HOUSEHOLD' ELSE 'MACHINERY' END")
+INSERT INTO orders $(series $dialect $ORDERS "i, 1 + i * 31 % $CUSTOMERS, CASE i % 3 WHEN 0 THEN 'F' WHEN 1 THEN 'O' ELSE 'P' END, (i * 104729 % 50000000) / 100.0, $(date_from $dialect "i % 2400"), (i % 5 + 1) || '-PRIORITY'")
+INSERT INTO lineitem $(series $dialect $LINEITEMS "1 + (i - 1) / 4, 1 + (i - 1) % 4, 1 + i % 50, (i * 15485863 % 10000000) / 100.0, (i % 11) / 100.0, CASE i % 3 WHEN 0 THEN 'A' WHEN 1 THEN 'N' ELSE 'R' END, CASE i % 2 WHEN 0 THEN 'F' ELSE 'O' END, $(date_from $dialect "i % 2500"), CASE i % 7 WHEN 0 THEN 'AIR' WHEN 1 THEN 'FOB' WHEN 2 THEN 'MAIL' WHEN 3 THEN 'RAIL' WHEN 4 THEN 'REG AIR' WHEN 5 THEN 'SHIP' ELSE 'TRUCK' END")
+SQL
+}
+
+setup_sources()
+{
+    echo "Loading $LINEITEMS lineitem rows (scale $SCALE) into PostgreSQL and SQLite..."
+    "$BINDIR/initdb" -D "$WORKDIR/remote" -U benchcheck --auth=trust >/dev/null
+    "$BINDIR/pg_ctl" -D "$WORKDIR/remote" -l "$WORKDIR/remote.log" -w \
+        -o "-p $PORT -k $WORKDIR -c listen_addresses=localhost" start >/dev/null
+    "$BINDIR/createdb" -h localhost -p $PORT -U benchcheck tpch
+    fixtures_sql postgres | psql -X -q -v ON_ERROR_STOP=1 -h localhost -p $PORT -U benchcheck -d tpch
+    psql -X -q -h localhost -p $PORT -U benchcheck -d tpch -c "VACUUM ANALYZE"
+
+    fixtures_sql sqlite | sqlite3 "$WORKDIR/tpch.db"
+    chmod a+rx "$WORKDIR"
+    chmod a+r "$WORKDIR/tpch.db"
+}
+
+foreign_tables_sql()
+{
+    local server=$1 prefix=$2
+    cat <<SQL
+CREATE FOREIGN TABLE ${prefix}region (r_regionkey integer, r_name varchar(25))
+  SERVER $server OPTIONS (table 'region');
+CREATE FOREIGN TABLE ${prefix}nation (n_nationkey integer, n_name varchar(25), n_regionkey integer)
+  SERVER $server OPTIONS (table 'nation');
+CREATE FOREIGN TABLE ${prefix}customer (c_custkey integer, c_name varchar(25), c_nationkey integer,
+                                        c_acctbal numeric(12,2), c_mktsegment varchar(10))
+  SERVER $server OPTIONS (table 'customer');
+CREATE FOREIGN TABLE ${prefix}orders (o_orderkey integer, o_custkey integer, o_orderstatus varchar(1),
+                                      o_totalprice numeric(12,2), o_orderdate date, o_orderpriority varchar(15))
+  SERVER $server OPTIONS (table 'orders');
+CREATE FOREIGN TABLE ${prefix}lineitem (l_orderkey integer, l_linenumber integer, l_quantity numeric(12,2),
+                                        l_extendedprice numeric(12,2), l_discount numeric(12,2),
+                                        l_returnflag varchar(1), l_linestatus varchar(1), l_shipdate date,
+                                        l_shipmode varchar(10))
+  SERVER $server OPTIONS (table 'lineitem');
+SQL
+}
+
+setup_local()
+{
+    if ! psql -X -d postgres -Atc "SELECT 1 FROM pg_database WHERE datname = '$DB'" | grep -q 1
+    then
+        createdb "$DB"
+    fi
+    $PSQL -q <<SQL
+CREATE EXTENSION IF NOT EXISTS odbc_fdw;
+DROP SERVER IF EXISTS benchcheck_postgres CASCADE;
+DROP SERVER IF EXISTS benchcheck_sqlite CASCADE;
+CREATE SERVER benchcheck_postgres FOREIGN DATA WRAPPER odbc_fdw
+  OPTIONS (odbc_DRIVER '$PG_DRIVER', odbc_SERVER 'localhost', odbc_PORT '$PORT', odbc_DATABASE 'tpch');
+CREATE USER MAPPING FOR CURRENT_USER SERVER benchcheck_postgres OPTIONS (odbc_UID 'benchcheck');
+CREATE SERVER benchcheck_sqlite FOREIGN DATA WRAPPER odbc_fdw
+  OPTIONS (odbc_DRIVER '$SQLITE_DRIVER', odbc_Database '$WORKDIR/tpch.db');
+CREATE USER MAPPING FOR CURRENT_USER SERVER benchcheck_sqlite;
+$(foreign_tables_sql benchcheck_postgres pg_)
+$(foreign_tables_sql benchcheck_sqlite sqlite_)
+SQL
+}
+
+#
+# Workloads: name and query, where @ is the prefix of the foreign tables
+#
+WORKLOADS=(
+    "scan|SELECT count(*) FROM @lineitem"
+    "filter|SELECT count(*) FROM @lineitem WHERE l_shipmode = 'MAIL'"
+    "join|SELECT count(*) FROM @orders o JOIN @customer c ON c.c_custkey = o.o_custkey WHERE c.c_mktsegment = 'BUILDING'"
+    "aggregate|SELECT l_returnflag, l_linestatus, sum(l_quantity), avg(l_extendedprice), count(*) FROM @lineitem GROUP BY 1, 2"
+    "limit|SELECT * FROM @lineitem LIMIT 100"
+)
+
+now_ns()
+{
+    date +%s%N
+}
+
+# Median time of a query, in milliseconds, over RUNS runs after a warm-up run
+median_ms()
+{
+    local query=$1 run start end
+    local -a times=()
+
+    for run in $(seq 0 $RUNS)
+    do
+        start=$(now_ns)
+        $PSQL -Atq -o /dev/null -c "$query"
+        end=$(now_ns)
+        [ $run -eq 0 ] && continue
+        times+=($(( (end - start) / 1000 )))
+    done
+    printf "%s\n" "${times[@]}" | sort -n |
+        awk '{ t[NR] = $1 } END { m = (NR % 2) ? t[(NR + 1) / 2] : (t[NR / 2] + t[NR / 2 + 1]) / 2; printf "%.1f\n", m / 1000 }'
+}
+
+run_workloads()
+{
+    local source prefix workload name query ms rows
+
+    : > "$RESULTS"
+    printf "%-22s %12s %12s\n" "workload" "median ms" "rows/s"
+    for source in postgres sqlite
+    do
+        [ $source = postgres ] && prefix=pg_ || prefix=sqlite_
+        for workload in "${WORKLOADS[@]}"
+        do
+            name="${workload%%|*}_$source"
+            query="${workload#*|}"
+            query="${query//@/$prefix}"
+            ms=$(median_ms "$query")
+            # Rows read from the data source
+            case $name in
+                join_*) rows=$((ORDERS + CUSTOMERS)) ;;
+                limit_*) rows=100 ;;
+                *) rows=$LINEITEMS ;;
+            esac
+            printf "%-22s %12s %12s\n" $name $ms \
+                $(awk -v r=$rows -v ms=$ms 'BEGIN { printf "%d", ms > 0 ? r * 1000 / ms : 0 }')
+            echo "$name $ms" >> "$RESULTS"
+        done
+    done
+}
+
+# Compare the results with the baseline; fails if a workload has become slower than the threshold
+compare_baseline()
+{
+    if [ ! -f "$BASELINE" ] || [ "${BENCHCHECK_UPDATE:-0}" = 1 ]
+    then
+        cp "$RESULTS" "$BASELINE"
+        echo "Baseline saved in $BASELINE"
+        return 0
+    fi
+
+    echo
+    printf "%-22s %12s %12s %9s\n" "workload" "baseline ms" "median ms" "change"
+    awk -v threshold=$THRESHOLD '
+        NR == FNR { baseline[$1] = $2; next }
+        {
+            if (!($1 in baseline) || baseline[$1] <= 0)
+            {
+                printf "%-22s %12s %12.1f %9s\n", $1, "-", $2, "new"
+                next
+            }
+            change = ($2 - baseline[$1]) * 100 / baseline[$1]
+            status = change > threshold ? "  REGRESSION" : ""
+            printf "%-22s %12.1f %12.1f %+8.1f%%%s\n", $1, baseline[$1], $2, change, status
+            if (change > threshold)
+                failed++
+        }
+        END {
+            if (failed)
+            {
+                printf "\n%d workload(s) slower than the baseline by more than %s%%\n", failed, threshold
+                exit 1
+            }
+        }' "$BASELINE" "$RESULTS"
+}
+
+setup_sources
+setup_local
+run_workloads
+compare_baseline
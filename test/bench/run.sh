@@ -0,0 +1,144 @@
+#!/bin/bash
+#
+# Microbenchmark of the foreign scan path of odbc_fdw with the mock
+# ODBC driver (test/mock), without any network or remote server.
+#
+# Usage: make bench, or test/bench/run.sh /path/to/odbc_mock.so
+#
+# Settings, from the environment:
+#   BENCH_DB         database, created if needed (default odbc_fdw_bench)
+#   BENCH_ROWS       rows returned by the driver (default 1000000)
+#   BENCH_COLUMNS    column types of the mock driver (default "int varchar(32) double timestamp")
+#   BENCH_NULLS      percentage of NULL values (default 0)
+#   BENCH_LATENCY    microseconds of latency of each SQLFetch (default 0)
+#   BENCH_RUNS       measured runs (default 5)
+#   BENCH_CLIENTS    pgbench clients (default 4)
+#   BENCH_DURATION   pgbench seconds, 0 to skip pgbench (default 10)
+#
+# The connection parameters are those of psql (PGHOST, PGPORT, PGUSER...).
+# The PostgreSQL server must run on this host, since the CPU time of the
+# backend is read from /proc.
+
+set -e
+
+BASEDIR=$(readlink -f $0 | xargs dirname)
+DRIVER=$(readlink -f "${1:?usage: $0 /path/to/odbc_mock.so}")
+
+DB=${BENCH_DB:-odbc_fdw_bench}
+ROWS=${BENCH_ROWS:-1000000}
+COLUMNS=${BENCH_COLUMNS:-"int varchar(32) double timestamp"}
+NULLS=${BENCH_NULLS:-0}
+LATENCY=${BENCH_LATENCY:-0}
+RUNS=${BENCH_RUNS:-5}
+CLIENTS=${BENCH_CLIENTS:-4}
+DURATION=${BENCH_DURATION:-10}
+
+PSQL="psql -X -v ON_ERROR_STOP=1 -d $DB"
+
+# Local type of each mock column type
+column_definitions()
+{
+    local i=1 type definitions=""
+    for type in $COLUMNS
+    do
+        case "$type" in
+            int|integer) type="integer" ;;
+            double|float) type="double precision" ;;
+            bool|boolean) type="boolean" ;;
+            text|text\(*\)) type="text" ;;
+            bigint|numeric|date|timestamp|varchar\(*\)) ;;
+            *) echo "Unknown column type: $type" >&2; exit 1 ;;
+        esac
+        definitions="${definitions:+$definitions, }c$i $type"
+        i=$((i + 1))
+    done
+    echo "$definitions"
+}
+
+setup()
+{
+    if ! psql -X -d postgres -Atc "SELECT 1 FROM pg_database WHERE datname = '$DB'" | grep -q 1
+    then
+        createdb "$DB"
+    fi
+    $PSQL -q <<SQL
+CREATE EXTENSION IF NOT EXISTS odbc_fdw;
+DROP SERVER IF EXISTS odbc_mock_bench CASCADE;
+CREATE SERVER odbc_mock_bench
+FOREIGN DATA WRAPPER odbc_fdw
+OPTIONS (
+  odbc_DRIVER '$DRIVER',
+  odbc_ROWS '$ROWS',
+  odbc_COLUMNS '$COLUMNS',
+  odbc_NULLS '$NULLS',
+  odbc_FETCH_LATENCY '$LATENCY',
+  size_estimate_mode 'exact'
+);
+CREATE USER MAPPING FOR CURRENT_USER SERVER odbc_mock_bench;
+CREATE FOREIGN TABLE bench_scan ($(column_definitions))
+SERVER odbc_mock_bench
+OPTIONS (table 'bench_scan');
+SQL
+}
+
+# CPU time (user + system) of a process, in clock ticks
+cpu_ticks()
+{
+    awk '{ print $14 + $15 }' /proc/$1/stat
+}
+
+now_ns()
+{
+    date +%s%N
+}
+
+measure()
+{
+    local pid ticks_per_second run start end cpu_start cpu_end count wall_ms cpu_ms
+
+    coproc BACKEND { $PSQL -Atq 2>&1; }
+    echo "SELECT pg_backend_pid();" >&${BACKEND[1]}
+    read -r pid <&${BACKEND[0]}
+    ticks_per_second=$(getconf CLK_TCK)
+
+    printf "%-5s %12s %12s %14s %14s\n" "run" "wall ms" "cpu ms" "rows/s" "cpu ns/row"
+    for run in $(seq 0 $RUNS)
+    do
+        cpu_start=$(cpu_ticks $pid)
+        start=$(now_ns)
+        # count(*) drains the scan without sending the rows to the client
+        echo "SELECT count(*) FROM bench_scan;" >&${BACKEND[1]}
+        read -r count <&${BACKEND[0]}
+        end=$(now_ns)
+        cpu_end=$(cpu_ticks $pid)
+        if [ "$count" != "$ROWS" ]
+        then
+            echo "Unexpected result: $count" >&2
+            exit 1
+        fi
+        # The first run warms up the connection and the caches
+        [ $run -eq 0 ] && continue
+        wall_ms=$(( (end - start) / 1000000 ))
+        cpu_ms=$(( (cpu_end - cpu_start) * 1000 / ticks_per_second ))
+        printf "%-5s %12d %12d %14d %14d\n" $run $wall_ms $cpu_ms \
+            $(( ROWS * 1000 / (wall_ms > 0 ? wall_ms : 1) )) \
+            $(( cpu_ms * 1000000 / (ROWS > 0 ? ROWS : 1) ))
+    done
+    echo "\\q" >&${BACKEND[1]}
+    wait $BACKEND_PID
+}
+
+echo "odbc_fdw scan benchmark: $ROWS rows of ($COLUMNS), $NULLS% NULLs, ${LATENCY}us per fetch"
+setup
+measure
+
+echo
+echo "Time by phase:"
+$PSQL -c "EXPLAIN (ANALYZE, COSTS OFF) SELECT count(*) FROM bench_scan"
+
+if [ "$DURATION" -gt 0 ]
+then
+    echo
+    echo "pgbench, $CLIENTS clients (each transaction scans $ROWS rows):"
+    pgbench -n -c $CLIENTS -j $CLIENTS -T $DURATION -f "$BASEDIR/scan.pgbench" "$DB"
+fi
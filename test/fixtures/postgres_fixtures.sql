@@ -1,6 +1,7 @@
 DROP TABLE IF EXISTS postgres_test_table;
 DROP TABLE IF EXISTS existent_table_in_schema_public;
 DROP TABLE IF EXISTS test_schema.test_table_in_schema;
+DROP TABLE IF EXISTS test_schema.batch_test;
 
 -- To test a normal import from public schema
 CREATE TABLE postgres_test_table (
@@ -13,6 +14,8 @@ CREATE TABLE postgres_test_table (
     boolean_example boolean
 );
 INSERT INTO postgres_test_table VALUES (1, 'example', 'example', 100, 10.12, '2016-01-01 00:00:00', true);
+-- Statistics imported by odbc_fdw_import_stats
+ANALYZE postgres_test_table;
 
 -- To tests the import of tables from non-existent schema
 CREATE TABLE existent_table_in_schema_public (
@@ -27,4 +30,10 @@ CREATE TABLE test_schema.test_table_in_schema (
     id integer PRIMARY KEY,
     data varchar(40)
 );
-INSERT INTO test_schema.test_table_in_schema VALUES (1, 'example');
\ No newline at end of file
+INSERT INTO test_schema.test_table_in_schema VALUES (1, 'example');
+
+-- To test batched inserts
+CREATE TABLE test_schema.batch_test (
+    id integer PRIMARY KEY,
+    data bytea
+);
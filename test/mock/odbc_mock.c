@@ -0,0 +1,955 @@
+/*----------------------------------------------------------
+ *
+ *        Mock ODBC driver for odbc_fdw benchmarks
+ *
+ * This software is released under the PostgreSQL Licence.
+ *
+ * A minimal ODBC 3 driver, loaded by the unixODBC driver manager,
+ * that synthesizes the result of any query instead of accessing
+ * a database, so that the fetch and conversion paths of odbc_fdw
+ * can be measured without network or server noise.
+ *
+ * The result set is defined by connection attributes (which odbc_fdw
+ * takes from the odbc_ options of servers and user mappings):
+ *
+ *   ROWS=n             number of rows (default 1000)
+ *   COLUMNS=types      column types, separated by spaces (default
+ *                      "int varchar(32) double timestamp"): int, bigint,
+ *                      double, numeric, bool, date, timestamp,
+ *                      varchar(n) and text (a long column of n characters,
+ *                      whose size isn't reported, read with SQLGetData)
+ *   NULLS=p            percentage of NULL values (default 0)
+ *   FETCH_LATENCY=us   delay of each SQLFetch, in microseconds (default 0)
+ *
+ * Queries starting with SELECT COUNT return a single row with the number
+ * of rows. Catalog functions (SQLTables, SQLColumns...) are not supported.
+ *
+ * IDENTIFICATION
+ *      odbc_fdw/test/mock/odbc_mock.c
+ *
+ *----------------------------------------------------------
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <sql.h>
+#include <sqlext.h>
+
+#define MOCK_MAX_COLUMNS 64
+#define MOCK_MAX_VALUE   8192
+
+typedef enum
+{
+	MOCK_INT,
+	MOCK_BIGINT,
+	MOCK_DOUBLE,
+	MOCK_NUMERIC,
+	MOCK_BOOL,
+	MOCK_DATE,
+	MOCK_TIMESTAMP,
+	MOCK_VARCHAR,
+	MOCK_TEXT
+} MockType;
+
+typedef struct MockColumn
+{
+	MockType    type;
+	SQLSMALLINT sql_type;
+	SQLULEN     size;       /* Reported column size */
+	SQLSMALLINT digits;
+	int         width;      /* Length of the strings */
+} MockColumn;
+
+typedef struct MockDiag
+{
+	char sqlstate[6];
+	char message[256];
+	int  set;
+} MockDiag;
+
+typedef struct MockEnv
+{
+	MockDiag diag;
+} MockEnv;
+
+typedef struct MockDbc
+{
+	MockDiag    diag;
+	MockEnv     *env;
+	int         connected;
+	long        rows;
+	int         num_columns;
+	MockColumn  columns[MOCK_MAX_COLUMNS];
+	int         null_percent;
+	long        fetch_latency;  /* Microseconds */
+} MockDbc;
+
+typedef struct MockBinding
+{
+	SQLSMALLINT target_type;
+	SQLPOINTER  target;
+	SQLLEN      length;
+	SQLLEN      *indicator;
+} MockBinding;
+
+typedef struct MockStmt
+{
+	MockDiag    diag;
+	MockDbc     *dbc;
+	int         executed;
+	int         count_query;    /* SELECT COUNT: a single bigint row */
+	long        next_row;       /* Next row to fetch */
+	long        current_row;    /* Row read by SQLGetData, or -1 */
+	SQLULEN     row_array_size;
+	SQLULEN     *rows_fetched;
+	SQLUSMALLINT *row_status;
+	MockBinding bindings[MOCK_MAX_COLUMNS];
+	int         getdata_column; /* Column being read in parts by SQLGetData */
+	size_t      getdata_offset;
+	char        value[MOCK_MAX_VALUE];
+	size_t      value_length;
+	/* Implicit descriptors: only their addresses are used, by the driver manager */
+	char        descriptors[4];
+} MockStmt;
+
+static void
+mock_set_diag(MockDiag *diag, const char *sqlstate, const char *message)
+{
+	snprintf(diag->sqlstate, sizeof(diag->sqlstate), "%s", sqlstate);
+	snprintf(diag->message, sizeof(diag->message), "[odbc_mock] %s", message);
+	diag->set = 1;
+}
+
+static MockDiag *
+mock_diag(SQLSMALLINT type, SQLHANDLE handle)
+{
+	switch (type)
+	{
+		case SQL_HANDLE_ENV:
+			return &((MockEnv *) handle)->diag;
+		case SQL_HANDLE_DBC:
+			return &((MockDbc *) handle)->diag;
+		case SQL_HANDLE_STMT:
+			return &((MockStmt *) handle)->diag;
+		default:
+			return NULL;
+	}
+}
+
+/*
+ * Connection attributes
+ */
+static int
+mock_parse_column(const char *spec, MockColumn *col)
+{
+	int n = 0;
+
+	memset(col, 0, sizeof(MockColumn));
+	if (strcasecmp(spec, "int") == 0 || strcasecmp(spec, "integer") == 0)
+	{
+		col->type = MOCK_INT;
+		col->sql_type = SQL_INTEGER;
+		col->size = 10;
+	}
+	else if (strcasecmp(spec, "bigint") == 0)
+	{
+		col->type = MOCK_BIGINT;
+		col->sql_type = SQL_BIGINT;
+		col->size = 19;
+	}
+	else if (strcasecmp(spec, "double") == 0 || strcasecmp(spec, "float") == 0)
+	{
+		col->type = MOCK_DOUBLE;
+		col->sql_type = SQL_DOUBLE;
+		col->size = 15;
+	}
+	else if (strcasecmp(spec, "numeric") == 0)
+	{
+		col->type = MOCK_NUMERIC;
+		col->sql_type = SQL_NUMERIC;
+		col->size = 18;
+		col->digits = 2;
+	}
+	else if (strcasecmp(spec, "bool") == 0 || strcasecmp(spec, "boolean") == 0)
+	{
+		col->type = MOCK_BOOL;
+		col->sql_type = SQL_BIT;
+		col->size = 1;
+	}
+	else if (strcasecmp(spec, "date") == 0)
+	{
+		col->type = MOCK_DATE;
+		col->sql_type = SQL_TYPE_DATE;
+		col->size = 10;
+	}
+	else if (strcasecmp(spec, "timestamp") == 0)
+	{
+		col->type = MOCK_TIMESTAMP;
+		col->sql_type = SQL_TYPE_TIMESTAMP;
+		col->size = 19;
+	}
+	else if (sscanf(spec, "varchar(%d)", &n) == 1 && n > 0 && n < MOCK_MAX_VALUE)
+	{
+		col->type = MOCK_VARCHAR;
+		col->sql_type = SQL_VARCHAR;
+		col->size = n;
+		col->width = n;
+	}
+	else if (strcasecmp(spec, "text") == 0 ||
+	         (sscanf(spec, "text(%d)", &n) == 1 && n > 0 && n < MOCK_MAX_VALUE))
+	{
+		col->type = MOCK_TEXT;
+		col->sql_type = SQL_LONGVARCHAR;
+		col->size = 0;      /* Unknown: read with SQLGetData */
+		col->width = n > 0 ? n : 1000;
+	}
+	else
+		return 0;
+	return 1;
+}
+
+static int
+mock_parse_columns(MockDbc *dbc, const char *specs)
+{
+	char spec[64];
+	const char *p = specs;
+
+	dbc->num_columns = 0;
+	while (*p)
+	{
+		size_t len = 0;
+
+		while (isspace((unsigned char) *p))
+			p++;
+		if (!*p)
+			break;
+		while (p[len] && !isspace((unsigned char) p[len]))
+			len++;
+		if (len >= sizeof(spec) || dbc->num_columns == MOCK_MAX_COLUMNS)
+			return 0;
+		memcpy(spec, p, len);
+		spec[len] = '\0';
+		if (!mock_parse_column(spec, &dbc->columns[dbc->num_columns]))
+			return 0;
+		dbc->num_columns++;
+		p += len;
+	}
+	return dbc->num_columns > 0;
+}
+
+/*
+ * Value of attribute name in a connection string, or NULL
+ */
+static char *
+mock_attribute(const char *conn_str, const char *name, char *value, size_t size)
+{
+	size_t name_len = strlen(name);
+	const char *p = conn_str;
+
+	while (p && *p)
+	{
+		const char *end = strchr(p, ';');
+		size_t len = end ? (size_t) (end - p) : strlen(p);
+
+		while (len > 0 && isspace((unsigned char) *p))
+		{
+			p++;
+			len--;
+		}
+		if (len > name_len && strncasecmp(p, name, name_len) == 0 && p[name_len] == '=')
+		{
+			size_t value_len = len - name_len - 1;
+
+			if (value_len >= size)
+				value_len = size - 1;
+			memcpy(value, p + name_len + 1, value_len);
+			value[value_len] = '\0';
+			return value;
+		}
+		p = end ? end + 1 : NULL;
+	}
+	return NULL;
+}
+
+/*
+ * Synthetic values: deterministic functions of the row and column
+ */
+static unsigned int
+mock_hash(long row, int column)
+{
+	unsigned int h = (unsigned int) row * 2654435761u ^ (unsigned int) column * 40503u;
+
+	h ^= h >> 15;
+	h *= 2246822519u;
+	h ^= h >> 13;
+	return h;
+}
+
+static int
+mock_is_null(MockDbc *dbc, long row, int column)
+{
+	return dbc->null_percent > 0 && (int) (mock_hash(row, column) % 100) < dbc->null_percent;
+}
+
+static size_t
+mock_value(MockDbc *dbc, long row, int column, char *buf)
+{
+	MockColumn *col = &dbc->columns[column];
+	static const char letters[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+	time_t t;
+	struct tm tm;
+	int i;
+
+	switch (col->type)
+	{
+		case MOCK_INT:
+			return snprintf(buf, MOCK_MAX_VALUE, "%ld", row % 2147483647L);
+		case MOCK_BIGINT:
+			return snprintf(buf, MOCK_MAX_VALUE, "%lld", (long long) row * 1000003LL);
+		case MOCK_DOUBLE:
+			return snprintf(buf, MOCK_MAX_VALUE, "%.15g", row * 1.5 + column);
+		case MOCK_NUMERIC:
+			return snprintf(buf, MOCK_MAX_VALUE, "%ld.%02u", row, mock_hash(row, column) % 100);
+		case MOCK_BOOL:
+			return snprintf(buf, MOCK_MAX_VALUE, "%d", (int) (mock_hash(row, column) & 1));
+		case MOCK_DATE:
+		case MOCK_TIMESTAMP:
+			/* From 2020-01-01, one second (or day) per row */
+			t = (time_t) 1577836800 + (col->type == MOCK_DATE ? (row % 36500) * 86400 : row);
+			gmtime_r(&t, &tm);
+			return strftime(buf, MOCK_MAX_VALUE,
+			                col->type == MOCK_DATE ? "%Y-%m-%d" : "%Y-%m-%d %H:%M:%S", &tm);
+		case MOCK_VARCHAR:
+		case MOCK_TEXT:
+			for (i = 0; i < col->width; i++)
+				buf[i] = letters[(row + i) % (sizeof(letters) - 1)];
+			buf[col->width] = '\0';
+			return col->width;
+	}
+	buf[0] = '\0';
+	return 0;
+}
+
+static size_t
+mock_stmt_value(MockStmt *stmt, long row, int column, char *buf, int *is_null)
+{
+	if (stmt->count_query)
+	{
+		*is_null = 0;
+		return snprintf(buf, MOCK_MAX_VALUE, "%ld", stmt->dbc->rows);
+	}
+	*is_null = mock_is_null(stmt->dbc, row, column);
+	if (*is_null)
+	{
+		buf[0] = '\0';
+		return 0;
+	}
+	return mock_value(stmt->dbc, row, column, buf);
+}
+
+static long
+mock_stmt_rows(MockStmt *stmt)
+{
+	return stmt->count_query ? 1 : stmt->dbc->rows;
+}
+
+static int
+mock_stmt_columns(MockStmt *stmt)
+{
+	return stmt->count_query ? 1 : stmt->dbc->num_columns;
+}
+
+/*
+ * Copy a string into an output buffer, returning SQL_SUCCESS_WITH_INFO if truncated
+ */
+static SQLRETURN
+mock_copy_string(MockDiag *diag, const char *value, SQLCHAR *out, SQLLEN size, SQLLEN *out_length)
+{
+	size_t len = strlen(value);
+
+	if (out_length)
+		*out_length = (SQLLEN) len;
+	if (out && size > 0)
+	{
+		size_t n = len < (size_t) size - 1 ? len : (size_t) size - 1;
+
+		memcpy(out, value, n);
+		out[n] = '\0';
+		if (n < len)
+		{
+			mock_set_diag(diag, "01004", "String data, right truncated");
+			return SQL_SUCCESS_WITH_INFO;
+		}
+	}
+	return SQL_SUCCESS;
+}
+
+/*
+ * Handles
+ */
+SQLRETURN SQL_API
+SQLAllocHandle(SQLSMALLINT type, SQLHANDLE input, SQLHANDLE *output)
+{
+	switch (type)
+	{
+		case SQL_HANDLE_ENV:
+			*output = calloc(1, sizeof(MockEnv));
+			break;
+		case SQL_HANDLE_DBC:
+			*output = calloc(1, sizeof(MockDbc));
+			if (*output)
+				((MockDbc *) *output)->env = (MockEnv *) input;
+			break;
+		case SQL_HANDLE_STMT:
+			*output = calloc(1, sizeof(MockStmt));
+			if (*output)
+			{
+				MockStmt *stmt = (MockStmt *) *output;
+
+				stmt->dbc = (MockDbc *) input;
+				stmt->row_array_size = 1;
+				stmt->current_row = -1;
+			}
+			break;
+		default:
+			*output = SQL_NULL_HANDLE;
+			return SQL_ERROR;
+	}
+	return *output ? SQL_SUCCESS : SQL_ERROR;
+}
+
+SQLRETURN SQL_API
+SQLFreeHandle(SQLSMALLINT type, SQLHANDLE handle)
+{
+	free(handle);
+	return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API
+SQLSetEnvAttr(SQLHENV env, SQLINTEGER attribute, SQLPOINTER value, SQLINTEGER length)
+{
+	return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API
+SQLGetDiagRec(SQLSMALLINT type, SQLHANDLE handle, SQLSMALLINT record, SQLCHAR *sqlstate,
+              SQLINTEGER *native_error, SQLCHAR *message, SQLSMALLINT size, SQLSMALLINT *length)
+{
+	MockDiag *diag = mock_diag(type, handle);
+	SQLLEN message_length;
+
+	if (diag == NULL || !diag->set || record != 1)
+		return SQL_NO_DATA;
+	if (sqlstate)
+		memcpy(sqlstate, diag->sqlstate, 6);
+	if (native_error)
+		*native_error = 0;
+	mock_copy_string(diag, diag->message, message, size, &message_length);
+	if (length)
+		*length = (SQLSMALLINT) message_length;
+	return SQL_SUCCESS;
+}
+
+/*
+ * Connections
+ */
+SQLRETURN SQL_API
+SQLSetConnectAttr(SQLHDBC hdbc, SQLINTEGER attribute, SQLPOINTER value, SQLINTEGER length)
+{
+	return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API
+SQLGetConnectAttr(SQLHDBC hdbc, SQLINTEGER attribute, SQLPOINTER value, SQLINTEGER size, SQLINTEGER *length)
+{
+	if (value)
+		*(SQLUINTEGER *) value = 0;
+	return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API
+SQLDriverConnect(SQLHDBC hdbc, SQLHWND window, SQLCHAR *in, SQLSMALLINT in_length,
+                 SQLCHAR *out, SQLSMALLINT out_size, SQLSMALLINT *out_length, SQLUSMALLINT completion)
+{
+	MockDbc *dbc = (MockDbc *) hdbc;
+	char conn_str[4096];
+	char value[1024];
+	size_t len = in_length == SQL_NTS ? strlen((char *) in) : (size_t) in_length;
+	SQLLEN copied;
+	SQLRETURN ret;
+
+	if (len >= sizeof(conn_str))
+		len = sizeof(conn_str) - 1;
+	memcpy(conn_str, in, len);
+	conn_str[len] = '\0';
+
+	dbc->rows = mock_attribute(conn_str, "ROWS", value, sizeof(value)) ? atol(value) : 1000;
+	dbc->null_percent = mock_attribute(conn_str, "NULLS", value, sizeof(value)) ? atoi(value) : 0;
+	dbc->fetch_latency = mock_attribute(conn_str, "FETCH_LATENCY", value, sizeof(value)) ? atol(value) : 0;
+	if (!mock_parse_columns(dbc, mock_attribute(conn_str, "COLUMNS", value, sizeof(value))
+	                             ? value : "int varchar(32) double timestamp"))
+	{
+		mock_set_diag(&dbc->diag, "HY000", "Invalid COLUMNS attribute");
+		return SQL_ERROR;
+	}
+	if (dbc->rows < 0)
+		dbc->rows = 0;
+
+	dbc->connected = 1;
+	ret = mock_copy_string(&dbc->diag, conn_str, out, out_size, &copied);
+	if (out_length)
+		*out_length = (SQLSMALLINT) copied;
+	return ret;
+}
+
+SQLRETURN SQL_API
+SQLDisconnect(SQLHDBC hdbc)
+{
+	((MockDbc *) hdbc)->connected = 0;
+	return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API
+SQLEndTran(SQLSMALLINT type, SQLHANDLE handle, SQLSMALLINT completion)
+{
+	return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API
+SQLGetInfo(SQLHDBC hdbc, SQLUSMALLINT info, SQLPOINTER value, SQLSMALLINT size, SQLSMALLINT *length)
+{
+	MockDbc *dbc = (MockDbc *) hdbc;
+	const char *string = NULL;
+	SQLLEN copied;
+	SQLRETURN ret;
+
+	switch (info)
+	{
+		case SQL_DRIVER_ODBC_VER:
+			string = "03.00";
+			break;
+		case SQL_DBMS_NAME:
+		case SQL_DRIVER_NAME:
+			string = "odbc_mock";
+			break;
+		case SQL_DBMS_VER:
+		case SQL_DRIVER_VER:
+			string = "01.00.0000";
+			break;
+		case SQL_IDENTIFIER_QUOTE_CHAR:
+			string = "\"";
+			break;
+		case SQL_CATALOG_NAME_SEPARATOR:
+			string = ".";
+			break;
+		case SQL_BATCH_SUPPORT:
+		case SQL_PARAM_ARRAY_ROW_COUNTS:
+		case SQL_GETDATA_EXTENSIONS:
+			if (value)
+				*(SQLUINTEGER *) value = 0;
+			if (length)
+				*length = sizeof(SQLUINTEGER);
+			return SQL_SUCCESS;
+		case SQL_CURSOR_COMMIT_BEHAVIOR:
+		case SQL_CURSOR_ROLLBACK_BEHAVIOR:
+			if (value)
+				*(SQLUSMALLINT *) value = SQL_CB_PRESERVE;
+			if (length)
+				*length = sizeof(SQLUSMALLINT);
+			return SQL_SUCCESS;
+		default:
+			mock_set_diag(&dbc->diag, "HY096", "Information type not supported");
+			return SQL_ERROR;
+	}
+	ret = mock_copy_string(&dbc->diag, string, (SQLCHAR *) value, size, &copied);
+	if (length)
+		*length = (SQLSMALLINT) copied;
+	return ret;
+}
+
+/*
+ * Statements
+ */
+SQLRETURN SQL_API
+SQLSetStmtAttr(SQLHSTMT hstmt, SQLINTEGER attribute, SQLPOINTER value, SQLINTEGER length)
+{
+	MockStmt *stmt = (MockStmt *) hstmt;
+
+	switch (attribute)
+	{
+		case SQL_ATTR_ROW_ARRAY_SIZE:
+			stmt->row_array_size = (SQLULEN) value > 0 ? (SQLULEN) value : 1;
+			break;
+		case SQL_ATTR_ROWS_FETCHED_PTR:
+			stmt->rows_fetched = (SQLULEN *) value;
+			break;
+		case SQL_ATTR_ROW_STATUS_PTR:
+			stmt->row_status = (SQLUSMALLINT *) value;
+			break;
+		case SQL_ATTR_ROW_BIND_TYPE:
+			if ((SQLULEN) value != SQL_BIND_BY_COLUMN)
+			{
+				mock_set_diag(&stmt->diag, "HYC00", "Only column-wise binding is supported");
+				return SQL_ERROR;
+			}
+			break;
+		default:
+			/* Timeouts, cursor types...: accepted and ignored */
+			break;
+	}
+	return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API
+SQLGetStmtAttr(SQLHSTMT hstmt, SQLINTEGER attribute, SQLPOINTER value, SQLINTEGER size, SQLINTEGER *length)
+{
+	MockStmt *stmt = (MockStmt *) hstmt;
+
+	switch (attribute)
+	{
+		case SQL_ATTR_ROW_ARRAY_SIZE:
+			*(SQLULEN *) value = stmt->row_array_size;
+			break;
+		case SQL_ATTR_APP_ROW_DESC:
+			*(SQLHANDLE *) value = &stmt->descriptors[0];
+			break;
+		case SQL_ATTR_APP_PARAM_DESC:
+			*(SQLHANDLE *) value = &stmt->descriptors[1];
+			break;
+		case SQL_ATTR_IMP_ROW_DESC:
+			*(SQLHANDLE *) value = &stmt->descriptors[2];
+			break;
+		case SQL_ATTR_IMP_PARAM_DESC:
+			*(SQLHANDLE *) value = &stmt->descriptors[3];
+			break;
+		default:
+			mock_set_diag(&stmt->diag, "HY092", "Attribute not supported");
+			return SQL_ERROR;
+	}
+	return SQL_SUCCESS;
+}
+
+static void
+mock_close_cursor(MockStmt *stmt)
+{
+	stmt->executed = 0;
+	stmt->next_row = 0;
+	stmt->current_row = -1;
+	stmt->getdata_column = -1;
+}
+
+SQLRETURN SQL_API
+SQLExecDirect(SQLHSTMT hstmt, SQLCHAR *text, SQLINTEGER length)
+{
+	MockStmt *stmt = (MockStmt *) hstmt;
+	const char *p = (const char *) text;
+
+	mock_close_cursor(stmt);
+	while (isspace((unsigned char) *p))
+		p++;
+	stmt->count_query = (strncasecmp(p, "SELECT", 6) == 0 &&
+	                     strncasecmp(p + 6 + strspn(p + 6, " \t\r\n"), "COUNT", 5) == 0);
+	stmt->executed = 1;
+	return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API
+SQLPrepare(SQLHSTMT hstmt, SQLCHAR *text, SQLINTEGER length)
+{
+	mock_set_diag(&((MockStmt *) hstmt)->diag, "IM001", "Prepared statements are not supported");
+	return SQL_ERROR;
+}
+
+SQLRETURN SQL_API
+SQLExecute(SQLHSTMT hstmt)
+{
+	mock_set_diag(&((MockStmt *) hstmt)->diag, "IM001", "Prepared statements are not supported");
+	return SQL_ERROR;
+}
+
+SQLRETURN SQL_API
+SQLRowCount(SQLHSTMT hstmt, SQLLEN *rows)
+{
+	*rows = -1;
+	return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API
+SQLMoreResults(SQLHSTMT hstmt)
+{
+	return SQL_NO_DATA;
+}
+
+SQLRETURN SQL_API
+SQLNumResultCols(SQLHSTMT hstmt, SQLSMALLINT *count)
+{
+	MockStmt *stmt = (MockStmt *) hstmt;
+
+	*count = stmt->executed ? (SQLSMALLINT) mock_stmt_columns(stmt) : 0;
+	return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API
+SQLDescribeCol(SQLHSTMT hstmt, SQLUSMALLINT column, SQLCHAR *name, SQLSMALLINT name_size,
+               SQLSMALLINT *name_length, SQLSMALLINT *data_type, SQLULEN *column_size,
+               SQLSMALLINT *decimal_digits, SQLSMALLINT *nullable)
+{
+	MockStmt *stmt = (MockStmt *) hstmt;
+	MockColumn count_column = { MOCK_BIGINT, SQL_BIGINT, 19, 0, 0 };
+	MockColumn *col;
+	char column_name[32];
+	SQLLEN copied;
+
+	if (!stmt->executed || column < 1 || column > mock_stmt_columns(stmt))
+	{
+		mock_set_diag(&stmt->diag, "07009", "Invalid descriptor index");
+		return SQL_ERROR;
+	}
+	col = stmt->count_query ? &count_column : &stmt->dbc->columns[column - 1];
+
+	snprintf(column_name, sizeof(column_name), stmt->count_query ? "count" : "c%d", column);
+	mock_copy_string(&stmt->diag, column_name, name, name_size, &copied);
+	if (name_length)
+		*name_length = (SQLSMALLINT) copied;
+	if (data_type)
+		*data_type = col->sql_type;
+	if (column_size)
+		*column_size = col->size;
+	if (decimal_digits)
+		*decimal_digits = col->digits;
+	if (nullable)
+		*nullable = stmt->dbc->null_percent > 0 ? SQL_NULLABLE : SQL_NO_NULLS;
+	return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API
+SQLBindCol(SQLHSTMT hstmt, SQLUSMALLINT column, SQLSMALLINT target_type,
+           SQLPOINTER target, SQLLEN length, SQLLEN *indicator)
+{
+	MockStmt *stmt = (MockStmt *) hstmt;
+	MockBinding *binding;
+
+	if (column < 1 || column > MOCK_MAX_COLUMNS)
+	{
+		mock_set_diag(&stmt->diag, "07009", "Invalid descriptor index");
+		return SQL_ERROR;
+	}
+	if (target != NULL && target_type != SQL_C_CHAR && target_type != SQL_C_SBIGINT)
+	{
+		mock_set_diag(&stmt->diag, "HY003", "Only SQL_C_CHAR and SQL_C_SBIGINT are supported");
+		return SQL_ERROR;
+	}
+	binding = &stmt->bindings[column - 1];
+	binding->target_type = target_type;
+	binding->target = target;
+	binding->length = length;
+	binding->indicator = indicator;
+	return SQL_SUCCESS;
+}
+
+static SQLRETURN
+mock_store(MockStmt *stmt, SQLSMALLINT target_type, const char *value, size_t value_length, int is_null,
+           SQLPOINTER target, SQLLEN size, SQLLEN *indicator)
+{
+	if (is_null)
+	{
+		if (indicator)
+			*indicator = SQL_NULL_DATA;
+		return SQL_SUCCESS;
+	}
+	if (target_type == SQL_C_SBIGINT)
+	{
+		*(SQLBIGINT *) target = strtoll(value, NULL, 10);
+		if (indicator)
+			*indicator = sizeof(SQLBIGINT);
+		return SQL_SUCCESS;
+	}
+	return mock_copy_string(&stmt->diag, value, (SQLCHAR *) target, size, indicator);
+}
+
+SQLRETURN SQL_API
+SQLFetch(SQLHSTMT hstmt)
+{
+	MockStmt *stmt = (MockStmt *) hstmt;
+	long rows = mock_stmt_rows(stmt);
+	int columns = mock_stmt_columns(stmt);
+	SQLRETURN result = SQL_SUCCESS;
+	SQLULEN n;
+	int c;
+
+	if (!stmt->executed)
+	{
+		mock_set_diag(&stmt->diag, "24000", "Invalid cursor state");
+		return SQL_ERROR;
+	}
+	if (stmt->dbc->fetch_latency > 0)
+	{
+		struct timespec delay;
+
+		delay.tv_sec = stmt->dbc->fetch_latency / 1000000;
+		delay.tv_nsec = (stmt->dbc->fetch_latency % 1000000) * 1000;
+		nanosleep(&delay, NULL);
+	}
+	if (stmt->rows_fetched)
+		*stmt->rows_fetched = 0;
+	if (stmt->next_row >= rows)
+	{
+		stmt->current_row = -1;
+		return SQL_NO_DATA;
+	}
+
+	for (n = 0; n < stmt->row_array_size && stmt->next_row < rows; n++, stmt->next_row++)
+	{
+		for (c = 0; c < columns; c++)
+		{
+			MockBinding *binding = &stmt->bindings[c];
+			char value[MOCK_MAX_VALUE];
+			size_t value_length;
+			int is_null;
+			SQLRETURN ret;
+
+			if (binding->target == NULL)
+				continue;
+			value_length = mock_stmt_value(stmt, stmt->next_row, c, value, &is_null);
+			ret = mock_store(stmt, binding->target_type, value, value_length, is_null,
+			                 (char *) binding->target + n * binding->length, binding->length,
+			                 binding->indicator ? &binding->indicator[n] : NULL);
+			if (ret != SQL_SUCCESS)
+				result = ret;
+		}
+		if (stmt->row_status)
+			stmt->row_status[n] = SQL_ROW_SUCCESS;
+	}
+	if (stmt->row_status)
+	{
+		SQLULEN i;
+
+		for (i = n; i < stmt->row_array_size; i++)
+			stmt->row_status[i] = SQL_ROW_NOROW;
+	}
+	if (stmt->rows_fetched)
+		*stmt->rows_fetched = n;
+
+	/* SQLGetData reads the last row of the batch */
+	stmt->current_row = stmt->next_row - 1;
+	stmt->getdata_column = -1;
+	return result;
+}
+
+SQLRETURN SQL_API
+SQLGetData(SQLHSTMT hstmt, SQLUSMALLINT column, SQLSMALLINT target_type,
+           SQLPOINTER target, SQLLEN size, SQLLEN *indicator)
+{
+	MockStmt *stmt = (MockStmt *) hstmt;
+	int is_null;
+	size_t remaining;
+	size_t n;
+
+	if (stmt->current_row < 0 || column < 1 || column > mock_stmt_columns(stmt))
+	{
+		mock_set_diag(&stmt->diag, "07009", "Invalid descriptor index");
+		return SQL_ERROR;
+	}
+
+	if (stmt->getdata_column != column)
+	{
+		/* First part of the value */
+		stmt->value_length = mock_stmt_value(stmt, stmt->current_row, column - 1, stmt->value, &is_null);
+		stmt->getdata_column = column;
+		stmt->getdata_offset = 0;
+		if (is_null || target_type != SQL_C_CHAR)
+		{
+			stmt->getdata_offset = stmt->value_length;
+			return mock_store(stmt, target_type, stmt->value, stmt->value_length, is_null,
+			                  target, size, indicator);
+		}
+	}
+	else if (stmt->getdata_offset >= stmt->value_length)
+		return SQL_NO_DATA;
+
+	/* Character data, possibly in several parts */
+	remaining = stmt->value_length - stmt->getdata_offset;
+	if (indicator)
+		*indicator = (SQLLEN) remaining;
+	if (target == NULL || size <= 0)
+		return SQL_SUCCESS_WITH_INFO;
+	n = remaining < (size_t) size - 1 ? remaining : (size_t) size - 1;
+	memcpy(target, stmt->value + stmt->getdata_offset, n);
+	((char *) target)[n] = '\0';
+	stmt->getdata_offset += n;
+	if (n < remaining)
+	{
+		mock_set_diag(&stmt->diag, "01004", "String data, right truncated");
+		return SQL_SUCCESS_WITH_INFO;
+	}
+	return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API
+SQLFreeStmt(SQLHSTMT hstmt, SQLUSMALLINT option)
+{
+	MockStmt *stmt = (MockStmt *) hstmt;
+
+	if (option == SQL_CLOSE)
+		mock_close_cursor(stmt);
+	else if (option == SQL_UNBIND)
+		memset(stmt->bindings, 0, sizeof(stmt->bindings));
+	return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API
+SQLCloseCursor(SQLHSTMT hstmt)
+{
+	mock_close_cursor((MockStmt *) hstmt);
+	return SQL_SUCCESS;
+}
+
+SQLRETURN SQL_API
+SQLCancel(SQLHSTMT hstmt)
+{
+	mock_close_cursor((MockStmt *) hstmt);
+	return SQL_SUCCESS;
+}
+
+/*
+ * Catalog functions: not supported, the foreign tables
+ * of the benchmarks are created explicitly
+ */
+SQLRETURN SQL_API
+SQLTables(SQLHSTMT hstmt, SQLCHAR *catalog, SQLSMALLINT catalog_length,
+          SQLCHAR *schema, SQLSMALLINT schema_length, SQLCHAR *table, SQLSMALLINT table_length,
+          SQLCHAR *types, SQLSMALLINT types_length)
+{
+	mock_set_diag(&((MockStmt *) hstmt)->diag, "IM001", "Catalog functions are not supported");
+	return SQL_ERROR;
+}
+
+SQLRETURN SQL_API
+SQLColumns(SQLHSTMT hstmt, SQLCHAR *catalog, SQLSMALLINT catalog_length,
+           SQLCHAR *schema, SQLSMALLINT schema_length, SQLCHAR *table, SQLSMALLINT table_length,
+           SQLCHAR *column, SQLSMALLINT column_length)
+{
+	mock_set_diag(&((MockStmt *) hstmt)->diag, "IM001", "Catalog functions are not supported");
+	return SQL_ERROR;
+}
+
+SQLRETURN SQL_API
+SQLStatistics(SQLHSTMT hstmt, SQLCHAR *catalog, SQLSMALLINT catalog_length,
+              SQLCHAR *schema, SQLSMALLINT schema_length, SQLCHAR *table, SQLSMALLINT table_length,
+              SQLUSMALLINT unique, SQLUSMALLINT reserved)
+{
+	mock_set_diag(&((MockStmt *) hstmt)->diag, "IM001", "Catalog functions are not supported");
+	return SQL_ERROR;
+}
+
+SQLRETURN SQL_API
+SQLPrimaryKeys(SQLHSTMT hstmt, SQLCHAR *catalog, SQLSMALLINT catalog_length,
+               SQLCHAR *schema, SQLSMALLINT schema_length, SQLCHAR *table, SQLSMALLINT table_length)
+{
+	mock_set_diag(&((MockStmt *) hstmt)->diag, "IM001", "Catalog functions are not supported");
+	return SQL_ERROR;
+}
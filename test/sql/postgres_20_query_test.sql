@@ -4,4 +4,111 @@ SELECT * FROM existent_table_in_schema_public;
 SELECT * FROM test_table_in_schema;
 SELECT * FROM ODBCTablesList('postgres_fdw', 1);
 SELECT * FROM ODBCTableSize('postgres_fdw', 'postgres_test_table');
-SELECT * FROM ODBCQuerySize('postgres_fdw', 'select * from postgres_test_table');
\ No newline at end of file
+SELECT * FROM ODBCQuerySize('postgres_fdw', 'select * from postgres_test_table');
+SELECT rows FROM odbc_fdw_export('postgres_fdw', 'select id, varchar_example from postgres_test_table', '/tmp/odbc_fdw_export_test.csv');
+SELECT pg_read_file('/tmp/odbc_fdw_export_test.csv') = E'1,example\n' AS csv_read_back;
+SELECT rows FROM odbc_fdw_export('postgres_fdw', 'select id, varchar_example, decode(''0102ff'', ''hex'') as bin from postgres_test_table', '/tmp/odbc_fdw_export_test.bin', 'binary');
+SELECT encode(substr(pg_read_binary_file('/tmp/odbc_fdw_export_test.bin'), 1, 11), 'hex') AS signature;
+CREATE TABLE odbc_fdw_export_test (id integer, data varchar(40), bin bytea);
+COPY odbc_fdw_export_test FROM '/tmp/odbc_fdw_export_test.bin' (FORMAT binary);
+SELECT * FROM odbc_fdw_export_test;
+DROP TABLE odbc_fdw_export_test;
+CREATE TABLE odbc_fdw_load_test (id integer PRIMARY KEY, data varchar(40), origin text DEFAULT 'odbc');
+SELECT odbc_fdw_load('odbc_fdw_load_test', 'postgres_fdw', 'select id, varchar_example from postgres_test_table');
+SELECT * FROM odbc_fdw_load_test;
+DROP TABLE odbc_fdw_load_test;
+INSERT INTO test_table_in_schema VALUES (2, 'inserted');
+SELECT * FROM test_table_in_schema ORDER BY id;
+UPDATE test_table_in_schema SET data = 'updated' WHERE id = 2;
+SELECT * FROM test_table_in_schema ORDER BY id;
+UPDATE test_table_in_schema SET data = 'rechecked' WHERE id = 2 AND random() >= 0;
+SELECT * FROM test_table_in_schema ORDER BY id;
+DELETE FROM test_table_in_schema WHERE id = 2;
+SELECT * FROM test_table_in_schema ORDER BY id;
+COPY test_table_in_schema FROM STDIN;
+3	copied
+\.
+SELECT * FROM test_table_in_schema ORDER BY id;
+DELETE FROM test_table_in_schema WHERE id = 3;
+ALTER FOREIGN TABLE test_table_in_schema OPTIONS (ADD commit_interval '2');
+COPY test_table_in_schema FROM STDIN;
+4	four
+5	five
+6	six
+1	duplicate
+\.
+SELECT * FROM test_table_in_schema ORDER BY id;
+INSERT INTO test_table_in_schema VALUES (6, 'six');
+SELECT * FROM test_table_in_schema ORDER BY id;
+ALTER FOREIGN TABLE test_table_in_schema OPTIONS (DROP commit_interval);
+DELETE FROM test_table_in_schema WHERE id > 1;
+CREATE FOREIGN TABLE batch_test (id integer, data bytea) SERVER postgres_fdw
+  OPTIONS (schema 'test_schema', table 'batch_test', batch_size '3', "odbc_ByteaAsLongVarBinary" '1');
+INSERT INTO batch_test SELECT g, decode(repeat(lpad(to_hex(g), 2, '0'), g), 'hex') FROM generate_series(1, 5) g;
+SELECT * FROM batch_test ORDER BY id;
+DELETE FROM batch_test WHERE id > 0;
+DROP FOREIGN TABLE batch_test;
+CREATE SCHEMA imported_schema;
+IMPORT FOREIGN SCHEMA test_schema FROM SERVER postgres_fdw INTO imported_schema;
+SELECT c.relname, a.attname, a.attfdwoptions FROM pg_attribute a JOIN pg_class c ON c.oid = a.attrelid
+  WHERE c.relnamespace = 'imported_schema'::regnamespace AND a.attnum > 0 ORDER BY c.relname, a.attnum;
+DROP SCHEMA imported_schema CASCADE;
+SELECT schema, name, type FROM ODBCTablesList('postgres_fdw', 0, 'test_schema');
+SELECT ODBCTableSize('postgres_fdw', 'postgres_test_table', 'exact');
+SELECT ODBCTableSize('postgres_fdw', 'postgres_test_table', 'catalog');
+SELECT ODBCTableSize('postgres_fdw', 'postgres_test_table', 'auto') =
+       coalesce(ODBCTableSize('postgres_fdw', 'postgres_test_table', 'quick'),
+                ODBCTableSize('postgres_fdw', 'postgres_test_table', 'catalog')) AS auto_consistent;
+SELECT ODBCTableSize('postgres_fdw', 'nonexistent_table', 'catalog') IS NULL AS missing;
+SELECT ODBCTableSize('postgres_fdw', 'postgres_test_table', 'estimate');
+SELECT odbc_fdw_import_stats('postgres_test_table');
+SELECT reltuples FROM pg_class WHERE oid = 'postgres_test_table'::regclass;
+SELECT attname, n_distinct FROM pg_stats WHERE tablename = 'postgres_test_table' ORDER BY attname;
+SELECT * FROM odbc_query('postgres_fdw', 'select id, varchar_example from postgres_test_table') AS t(id integer, varchar_example text);
+SELECT phase, rows FROM odbc_fdw_benchmark('postgres_fdw', 'select id, varchar_example from postgres_test_table', 100, 'datum');
+SELECT rows FROM odbc_fdw_calibrate('postgres_fdw', 'select id, varchar_example from postgres_test_table', false);
+ALTER SERVER postgres_fdw OPTIONS (ADD fdw_startup_cost '1000');
+SELECT rows FROM odbc_fdw_calibrate('postgres_fdw', 'select id, varchar_example from postgres_test_table');
+SELECT split_part(o, '=', 1) AS option, split_part(o, '=', 2) <> '1000' AND split_part(o, '=', 2)::float8 >= 0 AS calibrated
+  FROM pg_foreign_server, unnest(srvoptions) o WHERE srvname = 'postgres_fdw' AND o LIKE 'fdw\_%' ORDER BY 1;
+ALTER SERVER postgres_fdw OPTIONS (DROP fdw_startup_cost, DROP fdw_tuple_cost, DROP fdw_byte_cost);
+ALTER SERVER postgres_fdw OPTIONS (ADD fdw_tuple_cost '-1');
+CREATE FUNCTION explain_rows(query text) RETURNS text LANGUAGE plpgsql AS $$
+DECLARE
+  line text;
+BEGIN
+  FOR line IN EXECUTE 'EXPLAIN ' || query LOOP
+    RETURN substring(line from 'rows=([0-9]+)');
+  END LOOP;
+END
+$$;
+CREATE FOREIGN TABLE remote_estimate_test (id integer) SERVER postgres_fdw
+  OPTIONS (sql_query 'select id from (values (1), (2), (3)) v(id) where id > 1', sql_count 'select 2');
+SELECT explain_rows('SELECT * FROM remote_estimate_test');
+ALTER FOREIGN TABLE remote_estimate_test OPTIONS (ADD use_remote_estimate 'true');
+SELECT explain_rows('SELECT * FROM remote_estimate_test');
+ALTER FOREIGN TABLE remote_estimate_test OPTIONS (SET sql_query 'show max_connections', SET sql_count 'select 5');
+SELECT explain_rows('SELECT * FROM remote_estimate_test');
+SELECT id > 0 AS runs FROM remote_estimate_test;
+DROP FOREIGN TABLE remote_estimate_test;
+DROP FUNCTION explain_rows(text);
+SELECT odbc_execute('postgres_fdw', ARRAY['UPDATE test_schema.test_table_in_schema SET data = ''example'' WHERE id = 1']);
+ALTER SERVER postgres_fdw OPTIONS (ADD init_sql 'CREATE TEMP TABLE odbc_fdw_profile (id integer)');
+SELECT odbc_execute('postgres_fdw', ARRAY['INSERT INTO odbc_fdw_profile VALUES (1)']);
+ALTER SERVER postgres_fdw OPTIONS (DROP init_sql);
+SELECT handle_type, live FROM odbc_fdw_handles WHERE handle_type = 'statement';
+EXPLAIN (VERBOSE, COSTS OFF) SELECT id FROM postgres_test_table WHERE text_example = 'example';
+SELECT allocated AS connections_before FROM odbc_fdw_handles WHERE handle_type = 'connection' \gset
+EXPLAIN (COSTS OFF) SELECT * FROM test_table_in_schema;
+SELECT allocated - :connections_before AS planning_connections FROM odbc_fdw_handles WHERE handle_type = 'connection';
+SELECT allocated AS connections_before FROM odbc_fdw_handles WHERE handle_type = 'connection' \gset
+EXPLAIN (COSTS OFF) SELECT id FROM postgres_test_table;
+SELECT allocated - :connections_before AS planning_connections FROM odbc_fdw_handles WHERE handle_type = 'connection';
+SELECT odbc_fdw_stats_reset();
+SELECT id FROM postgres_test_table;
+SELECT odbc_execute('postgres_fdw', ARRAY['UPDATE test_schema.test_table_in_schema SET data = ''example'' WHERE id = 1']);
+SELECT statements >= 2 AND rows >= 2 AS counted FROM pg_stat_odbc_fdw WHERE server_name = 'postgres_fdw';
+SELECT statements > 0 AND rows > 0 AS counted FROM pg_stat_odbc_fdw_tables WHERE relname = 'postgres_test_table';
+SELECT calls, rows FROM pg_stat_odbc_fdw_statements WHERE query = 'UPDATE test_schema.test_table_in_schema SET data = ''example'' WHERE id = 1';
+SELECT odbc_fdw_stats_reset();
+SELECT connections, statements, rows FROM pg_stat_odbc_fdw WHERE server_name = 'postgres_fdw';
\ No newline at end of file